@@ -0,0 +1,726 @@
+// Headless driver for the chromatin model.  It reads the model parameters
+// from the command line, generates the model, and writes the histogram of
+// fragment lengths as text so that parameter sweeps can be scripted on
+// machines that have no display.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "chromatin_model.h"
+#include "replicate_runner.h"
+#include "expected_histogram.h"
+#include "sweep_runner.h"
+#include "result_cache.h"
+#include "profile_fit.h"
+#include "run_file.h"
+#include "random_stream.h"
+#include "profiler.h"
+#include "digestion_course.h"
+#include "distributed_sweep.h"
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "  --missing PERCENT      Percent of histones missing (default 0)\n");
+    fprintf(stderr, "  --variance VAR         Nucleosome spacing variance (default 0)\n");
+    fprintf(stderr, "  --cuts CUTS            Cuts per 3k base pairs (default 1)\n");
+    fprintf(stderr, "  --linker BP            Mean base pairs per linker (default 20)\n");
+    fprintf(stderr, "  --nucleosome BP        Base pairs per nucleosome (default 146)\n");
+    fprintf(stderr, "  --nucleosomes COUNT    Number of nucleosomes in the model (default 5000)\n");
+    fprintf(stderr, "  --regions FILE         BED-like file of regions with their own linker,\n");
+    fprintf(stderr, "                         occupancy, variance and accessibility; not for\n");
+    fprintf(stderr, "                         expected mode\n");
+    fprintf(stderr, "  --bias FILE            Sequence bias index that weights where cuts go;\n");
+    fprintf(stderr, "                         not for expected mode\n");
+    fprintf(stderr, "  --fasta FILE           In index-bias mode, the reference sequence and the\n");
+    fprintf(stderr, "  --kmers FILE           table of \"KMER weight\" lines to build the --bias\n");
+    fprintf(stderr, "                         index from\n");
+    fprintf(stderr, "  --binning KIND         auto, linear, log or hdr (default auto, which is\n");
+    fprintf(stderr, "                         linear between the shortest and longest fragment)\n");
+    fprintf(stderr, "  --bins COUNT           Number of linear or log bins (default 100)\n");
+    fprintf(stderr, "  --min-bp BP            Left edge of fixed bins (default 1)\n");
+    fprintf(stderr, "  --max-bp BP            Right edge of fixed bins (default 100000)\n");
+    fprintf(stderr, "  --sub-bucket-bits BITS Bins per power of two for hdr is 2^BITS (default 4)\n");
+    fprintf(stderr, "  --seed SEED            Random-number seed (default 1)\n");
+    fprintf(stderr, "  --replicates COUNT     Independent models to merge (default 1)\n");
+    fprintf(stderr, "  --threads COUNT        Threads to run replicates on (default all cores)\n");
+    fprintf(stderr, "  --mode MODE            simulate; expected for the fast semi-analytic\n");
+    fprintf(stderr, "                         histogram with confidence bands; or sweep to run\n");
+    fprintf(stderr, "                         a grid of parameters; or fit to search for the\n");
+    fprintf(stderr, "                         parameters closest to a profile; or index-bias to\n");
+    fprintf(stderr, "                         build a sequence bias index; or digest for a\n");
+    fprintf(stderr, "                         time course; or worker to run sweep units for a\n");
+    fprintf(stderr, "                         coordinator at --connect (default simulate)\n");
+    fprintf(stderr, "  --band-z Z             Half-width of the expected bands, in standard\n");
+    fprintf(stderr, "                         deviations (default 1.96)\n");
+    fprintf(stderr, "  --sweep-missing LIST   Comma-separated values to sweep in sweep mode,\n");
+    fprintf(stderr, "  --sweep-variance LIST  each replacing the single value given above;\n");
+    fprintf(stderr, "  --sweep-cuts LIST      every combination is run\n");
+    fprintf(stderr, "  --sweep-linker LIST\n");
+    fprintf(stderr, "  --cache DIR            Directory of stored sweep results to reuse\n");
+    fprintf(stderr, "  --workers COUNT        Spread a sweep across this many worker processes\n");
+    fprintf(stderr, "                         on this machine, each on --threads (default 0,\n");
+    fprintf(stderr, "                         which runs it in this process)\n");
+    fprintf(stderr, "  --listen PORT          Also take sweep workers from other processes on PORT\n");
+    fprintf(stderr, "  --bind ADDRESS         IPv4 address to take them on (default 127.0.0.1,\n");
+    fprintf(stderr, "                         this host only; any other needs --token)\n");
+    fprintf(stderr, "  --token TEXT           Secret a worker must give to join a sweep; give\n");
+    fprintf(stderr, "                         the coordinator and its workers the same one\n");
+    fprintf(stderr, "  --connect HOST:PORT    In worker mode, the coordinator to work for\n");
+    fprintf(stderr, "  --unit-replicates N    Replicates in each unit of a spread sweep\n");
+    fprintf(stderr, "                         (default 1)\n");
+    fprintf(stderr, "  --retries N            Times a failed unit is tried again (default 2)\n");
+    fprintf(stderr, "  --unit-timeout SEC     Seconds before a unit is handed to another worker\n");
+    fprintf(stderr, "                         (default 0, no limit)\n");
+    fprintf(stderr, "  --times LIST           Increasing comma-separated digestion times in digest\n");
+    fprintf(stderr, "                         mode; --cuts is then the cuts per 3k base pairs\n");
+    fprintf(stderr, "                         made per unit of time\n");
+    fprintf(stderr, "  --profile FILE         Measured profile to fit: lines of \"bin_min_bp\n");
+    fprintf(stderr, "                         bin_max_bp value\" or \"length_bp value\"\n");
+    fprintf(stderr, "  --fit LIST             Parameters to fit, from missing, variance and cuts,\n");
+    fprintf(stderr, "                         starting from the values given above (default all)\n");
+    fprintf(stderr, "  --fit-evaluations N    Most parameter sets to evaluate (default 400)\n");
+    fprintf(stderr, "  --fit-tolerance TOL    Stop when the simplex distances are this close\n");
+    fprintf(stderr, "                         (default 1e-9)\n");
+    fprintf(stderr, "  --save-run FILE        In simulate mode, also save a model made from the\n");
+    fprintf(stderr, "                         seed, with its histogram, as a binary run file\n");
+    fprintf(stderr, "  --compress-run 0|1     Compress the run file; it is then smaller but is\n");
+    fprintf(stderr, "                         decoded rather than mapped when opened (default 0)\n");
+    fprintf(stderr, "  --output FILE          Where to write the histogram (default stdout)\n");
+    fprintf(stderr, "  --trace FILE           Time each phase of the run and write the spans,\n");
+    fprintf(stderr, "                         with the work counted, as Chrome trace JSON\n");
+}
+
+// Writes the trace, when one was asked for, however main() returns.
+class trace_writer {
+public:
+    trace_writer() : filename(NULL) {}
+    ~trace_writer() {
+        if ( (filename != NULL) && !profiler::writeTrace(filename) ) {
+            fprintf(stderr, "Cannot write the trace to %s\n", filename);
+        }
+    }
+
+    const char *filename;
+};
+
+// Parses a comma-separated list of numbers into values.  Returns false if
+// any of them is not a number.
+template <class T>
+static bool parse_list(const char *text, std::vector<T> &values)
+{
+    values.clear();
+    while (*text) {
+        char *end;
+        double value = strtod(text, &end);
+        if ( (end == text) || ((*end != ',') && (*end != '\0')) ) {
+            return false;
+        }
+        values.push_back(static_cast<T>(value));
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return !values.empty();
+}
+
+// Streams the reference sequence through the k-mer table into the index
+// that --bias reads, which is done once per genome.  Returns the exit
+// status.
+static int build_bias_index(const char *fasta_name, const char *kmers_name, const char *bias_name)
+{
+    if ( (fasta_name == NULL) || (kmers_name == NULL) || (bias_name == NULL) ) {
+        fprintf(stderr, "Index-bias mode needs --fasta, --kmers and --bias\n");
+        return 1;
+    }
+    kmer_table table;
+    if (!table.read(kmers_name)) {
+        fprintf(stderr, "Cannot read a k-mer table from %s\n", kmers_name);
+        return 1;
+    }
+    if (!sequence_bias::build(fasta_name, table, bias_name)) {
+        fprintf(stderr, "Cannot index %s into %s\n", fasta_name, bias_name);
+        return 1;
+    }
+    sequence_bias bias;
+    if (!bias.open(bias_name)) {
+        fprintf(stderr, "Cannot read back %s\n", bias_name);
+        return 1;
+    }
+    fprintf(stderr, "Indexed %lld base pairs of %s with %d-mers\n",
+            static_cast<long long>(bias.length()), fasta_name, table.k());
+    return 0;
+}
+
+// Writes the parameters of a run as header lines.
+static void write_header(FILE *f, const chromatin_parameters &params,
+                         unsigned long long seed, int num_replicates)
+{
+    fprintf(f, "# bpPerNucleosome %d\n", params.bpPerNucleosome);
+    fprintf(f, "# bpPerLinker %d\n", params.bpPerLinker);
+    fprintf(f, "# totalNucleosomes %d\n", params.totalNucleosomes);
+    fprintf(f, "# missingHistonePercent %g\n", params.missingHistonePercent);
+    fprintf(f, "# nucleosomeSpacingVariance %g\n", params.nucleosomeSpacingVariance);
+    fprintf(f, "# cutsPer3kBasePairs %g\n", params.cutsPer3kBasePairs);
+    if (params.regions) {
+        fprintf(f, "# regions %s\n", params.regions->filename().c_str());
+    }
+    if (params.bias) {
+        fprintf(f, "# bias %016llx\n", static_cast<unsigned long long>(params.bias->fingerprint()));
+    }
+    fprintf(f, "# seed %llu\n", seed);
+    fprintf(f, "# replicates %d\n", num_replicates);
+}
+
+// Writes the expected histogram as the header followed by one line per
+// bin holding its edges, its expected count and the confidence band.
+static bool write_expected(FILE *f, const chromatin_parameters &params,
+                           int num_replicates, const expected_histogram &histogram)
+{
+    fprintf(f, "# mode expected\n");
+    write_header(f, params, 0, num_replicates);
+    fprintf(f, "# fragments %g\n", histogram.fragments);
+    fprintf(f, "# bin_min_bp bin_max_bp expected lower upper\n");
+    const std::vector<double> &edges = histogram.layout.edges();
+    int i;
+    for (i = 0; i < histogram.layout.binCount(); i++) {
+        fprintf(f, "%g %g %g %g %g\n", edges[i], edges[i+1], histogram.expected[i],
+                histogram.lower[i], histogram.upper[i]);
+    }
+    return ferror(f) == 0;
+}
+
+// Writes the histogram as a header describing the run followed by one
+// line per bin holding the left edge, right edge and count of that bin.
+// The exact lengths, when they were kept, add the moments to the header;
+// otherwise the fragments outside the fixed bins are reported.
+static bool write_histogram(FILE *f, const chromatin_parameters &params,
+                            unsigned long long seed, int num_replicates,
+                            const fragment_length_counts *lengths,
+                            const fragment_histogram &histogram)
+{
+    write_header(f, params, seed, num_replicates);
+    if (lengths) {
+        double mean = 0, variance = 0;
+        lengths->moments(mean, variance);
+        fprintf(f, "# fragments %llu\n", static_cast<unsigned long long>(lengths->totalFragments()));
+        fprintf(f, "# mean_bp %g\n", mean);
+        fprintf(f, "# stddev_bp %g\n", sqrt(variance));
+    } else {
+        fprintf(f, "# underflow %llu\n", static_cast<unsigned long long>(histogram.underflow()));
+        fprintf(f, "# overflow %llu\n", static_cast<unsigned long long>(histogram.overflow()));
+    }
+    fprintf(f, "# bin_min_bp bin_max_bp count\n");
+
+    const std::vector<double> &edges = histogram.layout().edges();
+    int i;
+    for (i = 0; i < histogram.binCount(); i++) {
+        fprintf(f, "%g %g %llu\n", edges[i], edges[i+1],
+                static_cast<unsigned long long>(histogram.counts()[i]));
+    }
+    return ferror(f) == 0;
+}
+
+// Writes the histogram at each time point of a digestion, as for a sweep.
+static bool write_digestion(FILE *f, const chromatin_parameters &params, unsigned long long seed,
+                            int num_replicates, const std::vector<double> &times,
+                            const std::vector<fragment_histogram> &histograms)
+{
+    size_t i;
+    for (i = 0; i < times.size(); i++) {
+        if (i > 0) {
+            fprintf(f, "\n");
+        }
+        fprintf(f, "# point %d of %d\n", static_cast<int>(i + 1), static_cast<int>(times.size()));
+        fprintf(f, "# time %g\n", times[i]);
+        chromatin_parameters point = params;
+        point.cutsPer3kBasePairs = params.cutsPer3kBasePairs * times[i];
+        write_histogram(f, point, seed, num_replicates, NULL, histograms[i]);
+    }
+    return ferror(f) == 0;
+}
+
+// Parses a comma-separated list of parameter names into fit_parameter
+// bits.  Returns false if any name is unknown.
+static bool parse_fit_parameters(const char *text, int &which)
+{
+    which = 0;
+    while (*text) {
+        const char *end = strchr(text, ',');
+        size_t length = end ? static_cast<size_t>(end - text) : strlen(text);
+        if ( (length == 7) && (strncmp(text, "missing", length) == 0) ) {
+            which |= FIT_MISSING;
+        } else if ( (length == 8) && (strncmp(text, "variance", length) == 0) ) {
+            which |= FIT_VARIANCE;
+        } else if ( (length == 4) && (strncmp(text, "cuts", length) == 0) ) {
+            which |= FIT_CUTS;
+        } else {
+            return false;
+        }
+        text = end ? end + 1 : text + length;
+    }
+    return which != 0;
+}
+
+// Writes the result of a fit as the header for the best parameters
+// followed by one line per bin holding its edges, the measured density
+// and the density of the fitted histogram.
+static bool write_fit(FILE *f, unsigned long long seed, int num_replicates,
+                      const measured_profile &profile, const fit_result &result)
+{
+    fprintf(f, "# mode fit\n");
+    write_header(f, result.params, seed, num_replicates);
+    fprintf(f, "# distance %g\n", result.distance);
+    fprintf(f, "# evaluations %d\n", result.evaluations);
+    fprintf(f, "# bin_min_bp bin_max_bp measured fitted\n");
+    const std::vector<double> &edges = profile.layout.edges();
+    const std::vector<uint64_t> &counts = result.histogram.counts();
+    double total = 0;
+    size_t i;
+    for (i = 0; i < counts.size(); i++) {
+        total += counts[i];
+    }
+    for (i = 0; i < counts.size(); i++) {
+        fprintf(f, "%g %g %g %g\n", edges[i], edges[i+1], profile.density[i],
+                (total > 0) ? counts[i] / total : 0.0);
+    }
+    return ferror(f) == 0;
+}
+
+// Writes the result of each point of a sweep as a histogram block, with
+// a blank line between blocks.
+static bool write_sweep(FILE *f, unsigned long long seed, int num_replicates,
+                        const std::vector<sweep_result> &results)
+{
+    size_t i;
+    for (i = 0; i < results.size(); i++) {
+        if (i > 0) {
+            fprintf(f, "\n");
+        }
+        fprintf(f, "# point %d of %d\n", static_cast<int>(i + 1), static_cast<int>(results.size()));
+        fprintf(f, "# cached %d\n", results[i].cached ? 1 : 0);
+        if (!results[i].cuttable) {
+            fprintf(f, "# uncuttable 1\n");
+        }
+        write_histogram(f, results[i].params, seed, num_replicates, NULL, results[i].histogram);
+    }
+    return ferror(f) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    chromatin_parameters params;
+    unsigned long long seed = 1;
+    int num_bins = 100;
+    const char *binning = "auto";
+    double min_bp = 1, max_bp = 100000;
+    int sub_bucket_bits = 4;
+    int num_replicates = 1;
+    int num_threads = 0;
+    const char *output_name = NULL;
+    const char *mode = "simulate";
+    double band_z = 1.96;
+    sweep_grid grid;
+    std::vector<double> times;
+    const char *cache_name = NULL;
+    distributed_options distributed;
+    const char *connect_to = NULL;
+    const char *regions_name = NULL;
+    const char *bias_name = NULL;
+    const char *fasta_name = NULL;
+    const char *kmers_name = NULL;
+    const char *profile_name = NULL;
+    const char *run_name = NULL;
+    bool compress_run = false;
+    fit_options fit;
+    trace_writer trace;
+
+    // Parse the command line.  Every option takes a value.
+    int i;
+    for (i = 1; i < argc; i++) {
+        if ( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0) ) {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        const char *option = argv[i];
+        const char *value = argv[++i];
+        if (strcmp(option, "--missing") == 0) {
+            params.missingHistonePercent = atof(value);
+        } else if (strcmp(option, "--variance") == 0) {
+            params.nucleosomeSpacingVariance = atof(value);
+        } else if (strcmp(option, "--cuts") == 0) {
+            params.cutsPer3kBasePairs = atof(value);
+        } else if (strcmp(option, "--linker") == 0) {
+            params.bpPerLinker = atoi(value);
+        } else if (strcmp(option, "--nucleosome") == 0) {
+            params.bpPerNucleosome = atoi(value);
+        } else if (strcmp(option, "--nucleosomes") == 0) {
+            params.totalNucleosomes = atoi(value);
+        } else if (strcmp(option, "--bins") == 0) {
+            num_bins = atoi(value);
+        } else if (strcmp(option, "--binning") == 0) {
+            binning = value;
+        } else if (strcmp(option, "--min-bp") == 0) {
+            min_bp = atof(value);
+        } else if (strcmp(option, "--max-bp") == 0) {
+            max_bp = atof(value);
+        } else if (strcmp(option, "--sub-bucket-bits") == 0) {
+            sub_bucket_bits = atoi(value);
+        } else if (strcmp(option, "--seed") == 0) {
+            seed = strtoull(value, NULL, 10);
+        } else if (strcmp(option, "--replicates") == 0) {
+            num_replicates = atoi(value);
+        } else if (strcmp(option, "--threads") == 0) {
+            num_threads = atoi(value);
+        } else if (strcmp(option, "--mode") == 0) {
+            mode = value;
+        } else if (strcmp(option, "--band-z") == 0) {
+            band_z = atof(value);
+        } else if ( (strcmp(option, "--sweep-missing") == 0)
+                    || (strcmp(option, "--sweep-variance") == 0)
+                    || (strcmp(option, "--sweep-cuts") == 0)
+                    || (strcmp(option, "--sweep-linker") == 0) ) {
+            bool ok;
+            if (strcmp(option, "--sweep-missing") == 0) {
+                ok = parse_list(value, grid.missingHistonePercent);
+            } else if (strcmp(option, "--sweep-variance") == 0) {
+                ok = parse_list(value, grid.nucleosomeSpacingVariance);
+            } else if (strcmp(option, "--sweep-cuts") == 0) {
+                ok = parse_list(value, grid.cutsPer3kBasePairs);
+            } else {
+                ok = parse_list(value, grid.bpPerLinker);
+            }
+            if (!ok) {
+                fprintf(stderr, "Bad list of values for %s: %s\n", option, value);
+                return 1;
+            }
+        } else if (strcmp(option, "--times") == 0) {
+            if (!parse_list(value, times)) {
+                fprintf(stderr, "Bad list of values for %s: %s\n", option, value);
+                return 1;
+            }
+        } else if (strcmp(option, "--cache") == 0) {
+            cache_name = value;
+        } else if (strcmp(option, "--workers") == 0) {
+            distributed.local_workers = atoi(value);
+        } else if (strcmp(option, "--listen") == 0) {
+            distributed.port = atoi(value);
+        } else if (strcmp(option, "--bind") == 0) {
+            distributed.bind_address = value;
+        } else if (strcmp(option, "--token") == 0) {
+            distributed.token = value;
+        } else if (strcmp(option, "--connect") == 0) {
+            connect_to = value;
+        } else if (strcmp(option, "--unit-replicates") == 0) {
+            distributed.unit_replicates = atoi(value);
+        } else if (strcmp(option, "--retries") == 0) {
+            distributed.max_attempts = atoi(value) + 1;
+        } else if (strcmp(option, "--unit-timeout") == 0) {
+            distributed.unit_timeout = atof(value);
+        } else if (strcmp(option, "--regions") == 0) {
+            regions_name = value;
+        } else if (strcmp(option, "--bias") == 0) {
+            bias_name = value;
+        } else if (strcmp(option, "--fasta") == 0) {
+            fasta_name = value;
+        } else if (strcmp(option, "--kmers") == 0) {
+            kmers_name = value;
+        } else if (strcmp(option, "--profile") == 0) {
+            profile_name = value;
+        } else if (strcmp(option, "--fit") == 0) {
+            if (!parse_fit_parameters(value, fit.parameters)) {
+                fprintf(stderr, "Bad list of parameters to fit: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(option, "--fit-evaluations") == 0) {
+            fit.max_evaluations = atoi(value);
+        } else if (strcmp(option, "--fit-tolerance") == 0) {
+            fit.tolerance = atof(value);
+        } else if (strcmp(option, "--save-run") == 0) {
+            run_name = value;
+        } else if (strcmp(option, "--compress-run") == 0) {
+            compress_run = atoi(value) != 0;
+        } else if (strcmp(option, "--output") == 0) {
+            output_name = value;
+        } else if (strcmp(option, "--trace") == 0) {
+            trace.filename = value;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", option);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (trace.filename != NULL) {
+        profiler::setTracing(true);     // Keep every timed span
+    }
+    if ( (params.bpPerLinker <= 0) || (params.bpPerNucleosome <= 0)
+         || (params.totalNucleosomes <= 0) || (num_bins <= 0) || (num_replicates <= 0) ) {
+        fprintf(stderr, "Linker, nucleosome, nucleosome-count, bin and replicate values must be positive\n");
+        return 1;
+    }
+    if (params.bpPerLinker > nucleosome_array::MAX_LINKER / 2) {
+        fprintf(stderr, "Linker length must be at most %d\n", nucleosome_array::MAX_LINKER / 2);
+        return 1;
+    }
+
+    bool expected = (strcmp(mode, "expected") == 0);
+    bool sweep = (strcmp(mode, "sweep") == 0);
+    bool fitting = (strcmp(mode, "fit") == 0);
+    bool digesting = (strcmp(mode, "digest") == 0);
+    if (strcmp(mode, "index-bias") == 0) {
+        return build_bias_index(fasta_name, kmers_name, bias_name);
+    }
+    if (strcmp(mode, "worker") == 0) {
+        const char *colon = connect_to ? strrchr(connect_to, ':') : NULL;
+        if (colon == NULL) {
+            fprintf(stderr, "Worker mode needs --connect HOST:PORT\n");
+            return 1;
+        }
+        return run_sweep_worker(std::string(connect_to, colon).c_str(), atoi(colon + 1),
+                                distributed.token, num_threads);
+    }
+    if (!expected && !sweep && !fitting && !digesting && (strcmp(mode, "simulate") != 0)) {
+        fprintf(stderr, "Unknown mode: %s\n", mode);
+        return 1;
+    }
+
+    // The regions are read as the models need them; opening only checks
+    // them and indexes where they are.
+    if (regions_name) {
+        if (expected) {
+            fprintf(stderr, "Expected mode assumes a uniform strand and cannot use regions\n");
+            return 1;
+        }
+        std::shared_ptr<region_track> regions(new region_track);
+        size_t bad_line;
+        region_track::problem why;
+        if (!regions->open(regions_name, &bad_line, &why)) {
+            if (bad_line == 0) {
+                fprintf(stderr, "Cannot read %s\n", regions_name);
+            } else {
+                fprintf(stderr, "Line %d of %s %s\n", static_cast<int>(bad_line), regions_name,
+                        region_track::describe(why));
+            }
+            return 1;
+        }
+        params.regions = regions;
+    }
+    if (bias_name) {
+        if (expected) {
+            fprintf(stderr, "Expected mode assumes uniform cutting and cannot use a bias\n");
+            return 1;
+        }
+        std::shared_ptr<sequence_bias> bias(new sequence_bias);
+        if (!bias->open(bias_name)) {
+            fprintf(stderr, "Cannot read a sequence bias index from %s\n", bias_name);
+            return 1;
+        }
+        params.bias = bias;
+    }
+
+    // A fit takes its bins from the profile.
+    measured_profile profile;
+    if (fitting) {
+        if (profile_name == NULL) {
+            fprintf(stderr, "Fit mode needs a --profile\n");
+            return 1;
+        }
+        if (!read_measured_profile(profile_name, profile)) {
+            fprintf(stderr, "Cannot read a profile from %s\n", profile_name);
+            return 1;
+        }
+        binning = "profile";
+    }
+    size_t l;
+    for (l = 0; l < grid.bpPerLinker.size(); l++) {
+        if ( (grid.bpPerLinker[l] <= 0) || (grid.bpPerLinker[l] > nucleosome_array::MAX_LINKER / 2) ) {
+            fprintf(stderr, "Linker lengths must be positive and at most %d\n", nucleosome_array::MAX_LINKER / 2);
+            return 1;
+        }
+    }
+    if (digesting) {
+        bool increasing = !times.empty() && (times[0] >= 0);
+        for (l = 1; l < times.size(); l++) {
+            increasing = increasing && (times[l] >= times[l - 1]);
+        }
+        if (!increasing) {
+            fprintf(stderr, "Digest mode needs --times that are not negative and do not decrease\n");
+            return 1;
+        }
+    }
+
+    // Choose the bins.  Fixed bins are filled directly as fragments are
+    // generated; automatic ones need the exact lengths to find the range.
+    // The expected histogram has no observed range, and the points of a
+    // sweep should share their bins, so these use log bins when asked for
+    // automatic ones.
+    if ( (expected || sweep || digesting) && (strcmp(binning, "auto") == 0) ) {
+        binning = "log";
+    }
+    bool automatic = (strcmp(binning, "auto") == 0);
+    fragment_histogram histogram;
+    if (fitting) {
+        histogram.reset(profile.layout);
+    } else if (!automatic) {
+        if ( (min_bp <= 0) || (max_bp <= min_bp) || (sub_bucket_bits < 0) || (sub_bucket_bits > 20) ) {
+            fprintf(stderr, "Fixed bins need 0 < min-bp < max-bp and 0 <= sub-bucket-bits <= 20\n");
+            return 1;
+        }
+        if (strcmp(binning, "linear") == 0) {
+            histogram.reset(histogram_layout::linear(min_bp, max_bp, num_bins));
+        } else if (strcmp(binning, "log") == 0) {
+            histogram.reset(histogram_layout::logarithmic(min_bp, max_bp, num_bins));
+        } else if (strcmp(binning, "hdr") == 0) {
+            histogram.reset(histogram_layout::hdr(min_bp, max_bp, sub_bucket_bits));
+        } else {
+            fprintf(stderr, "Unknown binning: %s\n", binning);
+            return 1;
+        }
+    }
+
+    FILE *f = stdout;
+    if (output_name) {
+        f = fopen(output_name, "w");
+        if (f == NULL) {
+            fprintf(stderr, "Cannot open %s for writing\n", output_name);
+            return 1;
+        }
+    }
+
+    // The expected histogram is computed directly rather than simulated.
+    if (expected) {
+        expected_histogram expected_counts;
+        if (!compute_expected_histogram(params, histogram.layout(), num_replicates,
+                                        band_z, expected_counts)) {
+            fprintf(stderr, "No cuts, or no cuttable DNA remains\n");
+            return 2;
+        }
+        bool ok = write_expected(f, params, num_replicates, expected_counts);
+        if (f != stdout) {
+            ok = (fclose(f) == 0) && ok;
+        }
+        if (!ok) {
+            fprintf(stderr, "Error writing the histogram\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    // Search for the parameters closest to the profile.
+    if (fitting) {
+        fit.seed = seed;
+        fit.num_replicates = num_replicates;
+        fit.num_threads = num_threads;
+        fit_result result;
+        fit_profile(profile, params, fit, result);
+        bool ok = write_fit(f, seed, num_replicates, profile, result);
+        if (f != stdout) {
+            ok = (fclose(f) == 0) && ok;
+        }
+        if (!ok) {
+            fprintf(stderr, "Error writing the fit\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    // Run every point of a sweep, reusing any stored results.
+    if (sweep) {
+        std::vector<chromatin_parameters> points;
+        grid.expand(params, points);
+        result_cache *cache = cache_name ? new result_cache(cache_name) : NULL;
+        std::vector<sweep_result> results;
+        if ( (distributed.local_workers > 0) || (distributed.port > 0) ) {
+            distributed.worker_threads = num_threads;
+            distributed.worker_program = argv[0];
+            if ( (distributed.unit_replicates <= 0) || (distributed.max_attempts <= 0)
+                 || !run_distributed_sweep(points, seed, num_replicates, histogram.layout(),
+                                           cache, distributed, results) ) {
+                fprintf(stderr, "The sweep could not be finished\n");
+                delete cache;
+                return 1;
+            }
+        } else {
+            run_sweep(points, seed, num_replicates, histogram.layout(), num_threads, cache, results);
+        }
+        delete cache;
+        bool ok = write_sweep(f, seed, num_replicates, results);
+        if (f != stdout) {
+            ok = (fclose(f) == 0) && ok;
+        }
+        if (!ok) {
+            fprintf(stderr, "Error writing the histograms\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    // Digest over time, taking every time point from one pass.
+    if (digesting) {
+        std::vector<double> densities;
+        for (l = 0; l < times.size(); l++) {
+            densities.push_back(params.cutsPer3kBasePairs * times[l]);
+        }
+        std::vector<fragment_histogram> histograms;
+        if (!run_digestion(params, seed, densities, num_replicates, num_threads,
+                           histogram.layout(), histograms)) {
+            fprintf(stderr, "No cuttable DNA remains: every base pair is wrapped by an attached histone\n");
+            return 2;
+        }
+        bool ok = write_digestion(f, params, seed, num_replicates, times, histograms);
+        if (f != stdout) {
+            ok = (fclose(f) == 0) && ok;
+        }
+        if (!ok) {
+            fprintf(stderr, "Error writing the histograms\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    // Generate the models and their merged statistics.
+    fragment_length_counts lengths;
+    fragment_accumulator &accumulator = automatic
+        ? static_cast<fragment_accumulator &>(lengths) : histogram;
+    if (!run_replicates(params, seed, num_replicates, num_threads, accumulator)) {
+        fprintf(stderr, "No cuttable DNA remains: every base pair is wrapped by an attached histone\n");
+        return 2;
+    }
+    if (automatic && !lengths.histogram(histogram, num_bins)) {
+        fprintf(stderr, "Too few fragments to form a histogram\n");
+        return 2;
+    }
+
+    // Write the results.
+    bool ok = write_histogram(f, params, seed, num_replicates,
+                              automatic ? &lengths : NULL, histogram);
+    if (f != stdout) {
+        ok = (fclose(f) == 0) && ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error writing the histogram\n");
+        return 1;
+    }
+
+    // Save a whole model, binned the same way, for browsing later.  The
+    // replicates above stream their cuts rather than keep them, so this
+    // one is made separately.
+    if (run_name) {
+        chromatin_model model;
+        model.setParameters(params);
+        random_stream rng(seed, 0);
+        model.updateModel(rng);
+        fragment_histogram model_histogram(histogram.layout());
+        model.addFragmentLengths(model_histogram);
+        if (!run_file::write(run_name, model, seed, NULL, &model_histogram, compress_run)) {
+            fprintf(stderr, "Cannot write the run to %s\n", run_name);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,384 @@
+// Benchmarks for the chromatin model engine.  It times each stage of
+// making and analysing a model at a range of sizes and parameter corners
+// and writes the results as text, one line per measurement, so that runs
+// from different versions can be compared.  Given the results of an
+// earlier run as a baseline, it reports every stage that has slowed down
+// by more than a tolerance and exits with status 3 if any has.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "chromatin_model.h"
+#include "density_pyramid.h"
+#include "random_stream.h"
+
+// A named set of parameters to run at every size.
+class corner {
+public:
+    const char  *name;
+    double      missingHistonePercent;
+    double      nucleosomeSpacingVariance;
+    double      cutsPer3kBasePairs;
+};
+
+// The default histone and spacing settings, the densest cutting the
+// sliders allow, and the sparse and irregular chromatin that makes the
+// cuttable index largest.
+static const corner CORNERS[] = {
+    { "baseline",       0,      0,      1 },
+    { "dense_cuts",     0,      0,      30 },
+    { "irregular",      0,      100,    1 },
+    { "half_missing",   50,     100,    10 },
+};
+static const int NUM_CORNERS = sizeof(CORNERS) / sizeof(CORNERS[0]);
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "  --sizes LIST           Comma-separated nucleosome counts to run\n");
+    fprintf(stderr, "                         (default 5000,50000,500000,5000000,20000000)\n");
+    fprintf(stderr, "  --corners LIST         Comma-separated parameter corners to run, from\n");
+    fprintf(stderr, "                         baseline, dense_cuts, irregular and half_missing\n");
+    fprintf(stderr, "                         (default all)\n");
+    fprintf(stderr, "  --repeats COUNT        Times to run each stage; the fastest and the\n");
+    fprintf(stderr, "                         median are reported (default 3)\n");
+    fprintf(stderr, "  --seed SEED            Random-number seed (default 1)\n");
+    fprintf(stderr, "  --baseline FILE        Earlier results to compare against\n");
+    fprintf(stderr, "  --tolerance PERCENT    Slowdown of the fastest time that counts as a\n");
+    fprintf(stderr, "                         regression (default 10)\n");
+    fprintf(stderr, "  --min-ms MS            Stages faster than this in the baseline are too\n");
+    fprintf(stderr, "                         noisy to compare (default 1)\n");
+    fprintf(stderr, "  --output FILE          Where to write the results (default stdout)\n");
+}
+
+// Parses a comma-separated list of numbers into values.  Returns false if
+// any of them is not a positive number.
+static bool parse_sizes(const char *text, std::vector<int> &values)
+{
+    values.clear();
+    while (*text) {
+        char *end;
+        long value = strtol(text, &end, 10);
+        if ( (end == text) || (value <= 0) || ((*end != ',') && (*end != '\0')) ) {
+            return false;
+        }
+        values.push_back(static_cast<int>(value));
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return !values.empty();
+}
+
+// Parses a comma-separated list of corner names into their indices.
+static bool parse_corners(const char *text, std::vector<int> &indices)
+{
+    indices.clear();
+    while (*text) {
+        const char *end = strchr(text, ',');
+        size_t length = end ? static_cast<size_t>(end - text) : strlen(text);
+        int i;
+        for (i = 0; i < NUM_CORNERS; i++) {
+            if ( (strlen(CORNERS[i].name) == length) && (strncmp(CORNERS[i].name, text, length) == 0) ) {
+                break;
+            }
+        }
+        if (i == NUM_CORNERS) {
+            return false;
+        }
+        indices.push_back(i);
+        text = end ? end + 1 : text + length;
+    }
+    return !indices.empty();
+}
+
+// The times of one stage at one size and corner.
+class measurement {
+public:
+    std::string         stage;
+    int                 nucleosomes;
+    int                 corner;
+    std::vector<double> msec;       // One per repeat
+    double              items;      // Nucleosomes or cuts the stage handles
+    size_t              bytes;      // Memory the model takes afterwards
+
+    double best(void) const { return *std::min_element(msec.begin(), msec.end()); }
+    double median(void) const {
+        std::vector<double> sorted = msec;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+
+    // What identifies the measurement across runs.
+    std::string key(void) const {
+        char text[256];
+        sprintf(text, "%s %d %s", stage.c_str(), nucleosomes, CORNERS[corner].name);
+        return text;
+    }
+};
+
+// Measures the time since it was made, in milliseconds.
+class stopwatch {
+public:
+    stopwatch() : d_start(std::chrono::steady_clock::now()) {}
+    double msec(void) const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - d_start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point d_start;
+};
+
+// Runs every stage once at the specified parameters, appending the time
+// each took to its measurement.
+static void run_stages(const chromatin_parameters &params, uint64_t seed,
+                       std::vector<measurement> &results)
+{
+    size_t stage = 0;
+    double nucleosomes = params.totalNucleosomes;
+
+    // Generating a whole model, as the GUI and batch driver used to.
+    chromatin_model model;
+    model.setParameters(params);
+    random_stream rng(seed, 0);
+    stopwatch update_model;
+    model.updateModel(rng);
+    results[stage].msec.push_back(update_model.msec());
+    results[stage].items = nucleosomes;
+    results[stage++].bytes = model.memoryUsage();
+    const double cuts = static_cast<double>(model.cutLocations().size());
+
+    // The same split into its incremental stages: the nucleosomes, their
+    // histones and the cuttable index, then the cuts.
+    chromatin_model incremental;
+    chromatin_parameters uncut = params;
+    uncut.cutsPer3kBasePairs = 0;
+    stopwatch layout;
+    incremental.updateIncremental(uncut, seed);
+    results[stage].msec.push_back(layout.msec());
+    results[stage].items = nucleosomes;
+    results[stage++].bytes = incremental.memoryUsage();
+
+    stopwatch place_cuts;
+    incremental.updateIncremental(params, seed);
+    results[stage].msec.push_back(place_cuts.msec());
+    results[stage].items = cuts;
+    results[stage++].bytes = incremental.memoryUsage();
+
+    // Fragment statistics: binning into the GUI's fixed bins, exact
+    // lengths for automatic bins, and streaming cuts as replicates do.
+    fragment_histogram histogram(histogram_layout::logarithmic(1, 1e5, 100));
+    stopwatch bin;
+    model.addFragmentLengths(histogram);
+    results[stage].msec.push_back(bin.msec());
+    results[stage].items = cuts;
+    results[stage++].bytes = model.memoryUsage();
+
+    fragment_histogram automatic;
+    stopwatch statistics;
+    model.computeStatistics(automatic, 100);
+    results[stage].msec.push_back(statistics.msec());
+    results[stage].items = cuts;
+    results[stage++].bytes = model.memoryUsage();
+
+    chromatin_model streamed;
+    streamed.setParameters(params);
+    fragment_histogram streamed_histogram(histogram_layout::logarithmic(1, 1e5, 100));
+    rng.reset(seed, 0);
+    stopwatch stream;
+    streamed.streamFragmentLengths(rng, streamed_histogram);
+    results[stage].msec.push_back(stream.msec());
+    results[stage].items = cuts;
+    results[stage++].bytes = streamed.memoryUsage();
+
+    // Preparing to draw: the density summary every new model needs
+    // before it can be shown zoomed out.
+    density_pyramid summary;
+    stopwatch prepare;
+    summary.build(model);
+    results[stage].msec.push_back(prepare.msec());
+    results[stage].items = nucleosomes;
+    results[stage++].bytes = model.memoryUsage() + summary.memoryUsage();
+}
+
+static const char *STAGES[] = {
+    "update_model", "layout", "place_cuts", "bin_histogram", "statistics", "stream", "summary"
+};
+static const int NUM_STAGES = sizeof(STAGES) / sizeof(STAGES[0]);
+
+// Reads the fastest times from an earlier run's results, keyed by stage,
+// size and corner.  Returns false if the file cannot be read.
+static bool read_baseline(const char *filename, std::map<std::string, double> &best)
+{
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        char stage[64], name[64];
+        int nucleosomes;
+        double msec;
+        if ( (line[0] != '#')
+             && (sscanf(line, "%63s %d %63s %*s %lf", stage, &nucleosomes, name, &msec) == 4) ) {
+            char key[256];
+            sprintf(key, "%s %d %s", stage, nucleosomes, name);
+            best[key] = msec;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> sizes;
+    sizes.push_back(5000);
+    sizes.push_back(50000);
+    sizes.push_back(500000);
+    sizes.push_back(5000000);
+    sizes.push_back(20000000);
+    std::vector<int> corners;
+    int i;
+    for (i = 0; i < NUM_CORNERS; i++) {
+        corners.push_back(i);
+    }
+    int repeats = 3;
+    unsigned long long seed = 1;
+    const char *baseline_name = NULL;
+    double tolerance = 10;
+    double min_msec = 1;
+    const char *output_name = NULL;
+
+    // Parse the command line.  Every option takes a value.
+    for (i = 1; i < argc; i++) {
+        if ( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0) ) {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        const char *option = argv[i];
+        const char *value = argv[++i];
+        if (strcmp(option, "--sizes") == 0) {
+            if (!parse_sizes(value, sizes)) {
+                fprintf(stderr, "Bad list of sizes: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(option, "--corners") == 0) {
+            if (!parse_corners(value, corners)) {
+                fprintf(stderr, "Bad list of corners: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(option, "--repeats") == 0) {
+            repeats = atoi(value);
+        } else if (strcmp(option, "--seed") == 0) {
+            seed = strtoull(value, NULL, 10);
+        } else if (strcmp(option, "--baseline") == 0) {
+            baseline_name = value;
+        } else if (strcmp(option, "--tolerance") == 0) {
+            tolerance = atof(value);
+        } else if (strcmp(option, "--min-ms") == 0) {
+            min_msec = atof(value);
+        } else if (strcmp(option, "--output") == 0) {
+            output_name = value;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", option);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (repeats <= 0) {
+        fprintf(stderr, "Repeats must be positive\n");
+        return 1;
+    }
+    std::map<std::string, double> baseline;
+    if (baseline_name && !read_baseline(baseline_name, baseline)) {
+        fprintf(stderr, "Cannot read the baseline %s\n", baseline_name);
+        return 1;
+    }
+
+    FILE *f = stdout;
+    if (output_name) {
+        f = fopen(output_name, "w");
+        if (f == NULL) {
+            fprintf(stderr, "Cannot open %s for writing\n", output_name);
+            return 1;
+        }
+    }
+
+    // Describe the run, then write each measurement as soon as its size
+    // and corner are done, so a long run shows progress.
+    fprintf(f, "# benchmark chromatinCutterBench\n");
+    fprintf(f, "# engine_version %d\n", CHROMATIN_ENGINE_VERSION);
+#if defined(__AVX512F__)
+    fprintf(f, "# simd avx512\n");
+#elif defined(__AVX2__)
+    fprintf(f, "# simd avx2\n");
+#else
+    fprintf(f, "# simd none\n");
+#endif
+    fprintf(f, "# seed %llu\n", seed);
+    fprintf(f, "# repeats %d\n", repeats);
+    fprintf(f, "# stage nucleosomes corner bytes best_ms median_ms items_per_s\n");
+    fflush(f);
+
+    int regressions = 0;
+    size_t s, c;
+    for (s = 0; s < sizes.size(); s++) {
+        for (c = 0; c < corners.size(); c++) {
+            const corner &k = CORNERS[corners[c]];
+            chromatin_parameters params;
+            params.totalNucleosomes = sizes[s];
+            params.missingHistonePercent = k.missingHistonePercent;
+            params.nucleosomeSpacingVariance = k.nucleosomeSpacingVariance;
+            params.cutsPer3kBasePairs = k.cutsPer3kBasePairs;
+
+            std::vector<measurement> results(NUM_STAGES);
+            int stage, r;
+            for (stage = 0; stage < NUM_STAGES; stage++) {
+                results[stage].stage = STAGES[stage];
+                results[stage].nucleosomes = sizes[s];
+                results[stage].corner = corners[c];
+            }
+            for (r = 0; r < repeats; r++) {
+                run_stages(params, seed, results);
+            }
+
+            for (stage = 0; stage < NUM_STAGES; stage++) {
+                const measurement &m = results[stage];
+                double best = m.best();
+                fprintf(f, "%s %d %s %llu %.4f %.4f %.0f\n", m.stage.c_str(), m.nucleosomes,
+                        k.name, static_cast<unsigned long long>(m.bytes), best, m.median(),
+                        (best > 0) ? m.items / (best / 1000) : 0.0);
+
+                std::map<std::string, double>::const_iterator old = baseline.find(m.key());
+                if ( (old != baseline.end()) && (old->second >= min_msec)
+                     && (best > old->second * (1 + tolerance / 100)) ) {
+                    fprintf(stderr, "Regression: %s took %.4f ms, up from %.4f ms (%+.1f%%)\n",
+                            m.key().c_str(), best, old->second,
+                            100 * (best - old->second) / old->second);
+                    regressions++;
+                }
+            }
+            fflush(f);
+        }
+    }
+
+    bool ok = ferror(f) == 0;
+    if (f != stdout) {
+        ok = (fclose(f) == 0) && ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error writing the results\n");
+        return 1;
+    }
+    return (regressions > 0) ? 3 : 0;
+}
@@ -14,15 +14,21 @@ INCLUDEPATH += "C:/Qwt-6.0.0/include"
 
 LIBS += -L"C:/Qwt-6.0.0/lib" -lqwt -lqwtmathml
 
+include(chromatin_engine.pri)
+
 
 SOURCES += main.cpp\
         mainwindow.cpp \
     glwidget.cpp \
-    qwt_histogram.cpp
+    model_worker.cpp \
+    qwt_histogram.cpp \
+    strand_renderer.cpp
 
 HEADERS  += mainwindow.h \
     glwidget.h \
+    model_worker.h \
     qwt_histogram.h \
-    histogram_values_passer.h
+    histogram_values_passer.h \
+    strand_renderer.h
 
 FORMS    += mainwindow.ui
@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Headless batch driver for the chromatin model.
+# Builds without Qt GUI, OpenGL or a display.
+#
+#-------------------------------------------------
+
+QT -= core gui
+CONFIG += console
+CONFIG -= qt app_bundle
+
+TARGET = chromatinCutterBatch
+TEMPLATE = app
+
+include(chromatin_engine.pri)
+
+SOURCES += batch_main.cpp \
+           distributed_sweep.cpp
+
+HEADERS += distributed_sweep.h
+
+win32: LIBS += -lws2_32
@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# Benchmarks for the chromatin model engine.
+# Builds without Qt GUI, OpenGL or a display.
+#
+#-------------------------------------------------
+
+QT -= core gui
+CONFIG += console
+CONFIG -= qt app_bundle
+
+TARGET = chromatinCutterBench
+TEMPLATE = app
+
+include(chromatin_engine.pri)
+
+SOURCES += bench_main.cpp
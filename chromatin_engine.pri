@@ -0,0 +1,72 @@
+# The simulation engine, which has no Qt GUI or OpenGL dependency.  It is
+# shared by the GUI application and the headless batch driver.
+
+CONFIG += c++11 thread
+
+# The random-number streams compute many blocks at once when the compiler
+# may use wider vector instructions; run qmake with CONFIG+=avx2 or
+# CONFIG+=avx512 to allow them on machines that have them.
+!msvc {
+    avx2: QMAKE_CXXFLAGS += -mavx2
+    avx512: QMAKE_CXXFLAGS += -mavx512f
+}
+msvc {
+    avx2: QMAKE_CXXFLAGS += /arch:AVX2
+    avx512: QMAKE_CXXFLAGS += /arch:AVX512
+}
+
+# Phase timers and work counts (see profiler.h) cost almost nothing until
+# they are turned on; CONFIG+=noprofiling compiles them out altogether.
+noprofiling: DEFINES += CHROMATIN_NO_PROFILING
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/chromatin_model.cpp \
+    $$PWD/cut_array.cpp \
+    $$PWD/cuttable_index.cpp \
+    $$PWD/density_pyramid.cpp \
+    $$PWD/digestion_course.cpp \
+    $$PWD/expected_histogram.cpp \
+    $$PWD/fragment_histogram.cpp \
+    $$PWD/index_sampler.cpp \
+    $$PWD/linker_distribution.cpp \
+    $$PWD/mapped_file.cpp \
+    $$PWD/model_workspace.cpp \
+    $$PWD/nucleosome_array.cpp \
+    $$PWD/profile_fit.cpp \
+    $$PWD/profiler.cpp \
+    $$PWD/radix_sort.cpp \
+    $$PWD/region_track.cpp \
+    $$PWD/random_stream.cpp \
+    $$PWD/replicate_runner.cpp \
+    $$PWD/result_cache.cpp \
+    $$PWD/run_file.cpp \
+    $$PWD/sequence_bias.cpp \
+    $$PWD/sweep_runner.cpp \
+    $$PWD/thread_pool.cpp
+
+HEADERS += $$PWD/chromatin_model.h \
+    $$PWD/column.h \
+    $$PWD/cut_array.h \
+    $$PWD/cuttable_index.h \
+    $$PWD/density_pyramid.h \
+    $$PWD/digestion_course.h \
+    $$PWD/expected_histogram.h \
+    $$PWD/fragment_histogram.h \
+    $$PWD/index_sampler.h \
+    $$PWD/linker_distribution.h \
+    $$PWD/mapped_file.h \
+    $$PWD/model_workspace.h \
+    $$PWD/nucleosome_array.h \
+    $$PWD/profile_fit.h \
+    $$PWD/profiler.h \
+    $$PWD/radix_sort.h \
+    $$PWD/region_track.h \
+    $$PWD/random_stream.h \
+    $$PWD/replicate_runner.h \
+    $$PWD/result_cache.h \
+    $$PWD/run_file.h \
+    $$PWD/sequence_bias.h \
+    $$PWD/sweep_runner.h \
+    $$PWD/thread_pool.h
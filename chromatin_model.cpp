@@ -0,0 +1,594 @@
+#include <math.h>
+#include <algorithm>
+#include <map>
+
+#include "chromatin_model.h"
+#include "random_stream.h"
+#include "index_sampler.h"
+#include "linker_distribution.h"
+#include "profiler.h"
+#include "radix_sort.h"
+#include "digestion_course.h"
+
+// How many nucleosomes or cuts to generate between checks of the cancel
+// flag, so that checking costs nothing noticeable.
+static const int64_t CANCEL_CHECK_INTERVAL = 4096;
+
+static bool cancelled(const std::atomic<bool> *cancel)
+{
+    return (cancel != NULL) && cancel->load(std::memory_order_relaxed);
+}
+
+// Streams of the seed given to updateIncremental that each stage draws from.
+static const uint64_t POSITION_STREAM = 0;
+static const uint64_t DETACH_STREAM = 1;
+static const uint64_t CUT_STREAM = 2;
+
+//----------------------------------------------------------------------
+
+chromatin_parameters::chromatin_parameters()
+    : bpPerNucleosome(146)
+    , bpPerLinker(20)
+    , totalNucleosomes(5000)
+    , missingHistonePercent(0)
+    , nucleosomeSpacingVariance(0)
+    , cutsPer3kBasePairs(1)
+{
+}
+
+chromatin_model::chromatin_model()
+    : d_built(NOTHING_BUILT)
+    , d_seed(0)
+    , d_detached(0)
+    , d_cutsPlaced(0)
+{
+}
+
+bool chromatin_model::updateModel(random_stream &rng, const std::atomic<bool> *cancel)
+{
+    scoped_timer timer(PHASE_MODEL);
+
+    // Make a new set of nucleosomes and clear the list of cut locations.
+    d_built = NOTHING_BUILT;
+    if (!generateLayout(rng, cancel)) {
+        return false;
+    }
+    d_cutLocations.reset(totalBasePairs());
+
+    // Select locations for the cuts.  First figure out how many there are total and then
+    // put them all in.  Cuts are drawn uniformly from the base pairs that are not
+    // within a wrapped nucleosome, using the index of cuttable intervals.
+    int64_t num_cuts = cutCount();
+    if ( (num_cuts > 0) && (d_cuttable.totalCuttable() == 0) ) {
+        return false;
+    }
+    {
+        scoped_timer cut_timer(PHASE_CUTS);
+        d_cutLocations.reserve(num_cuts);
+        double *uniforms = d_workspace.uniforms(static_cast<size_t>(std::min(num_cuts, CANCEL_CHECK_INTERVAL)));
+        int64_t i, j;
+        for (i = 0; i < num_cuts; i += CANCEL_CHECK_INTERVAL) {
+            if (cancelled(cancel)) {
+                return false;
+            }
+            int64_t n = std::min(num_cuts - i, CANCEL_CHECK_INTERVAL);
+            rng.fillUniform(uniforms, n);
+            for (j = 0; j < n; j++) {
+                d_cutLocations.push_back(d_cuttable.sample(uniforms[j]));
+            }
+        }
+        profiler::count(COUNT_CUTS, num_cuts);
+    }
+
+    // Sort the cut locations, to make it faster to process them during graphics and
+    // histogram formation.
+    if (cancelled(cancel)) {
+        return false;
+    }
+    scoped_timer sort_timer(PHASE_SORT);
+    d_cutLocations.sort();
+    return true;
+}
+
+bool chromatin_model::updateIncremental(const chromatin_parameters &params, uint64_t seed,
+                                        const std::atomic<bool> *cancel)
+{
+    scoped_timer timer(PHASE_MODEL);
+
+    // Make new nucleosomes if anything they depend on has changed.
+    if ( (d_built == NOTHING_BUILT) || (seed != d_seed)
+         || (params.bpPerNucleosome != d_params.bpPerNucleosome)
+         || (params.bpPerLinker != d_params.bpPerLinker)
+         || (params.totalNucleosomes != d_params.totalNucleosomes)
+         || (params.nucleosomeSpacingVariance != d_params.nucleosomeSpacingVariance)
+         || (params.regions != d_params.regions) ) {
+        d_built = NOTHING_BUILT;
+        d_params = params;
+        d_seed = seed;
+        random_stream rng(seed, POSITION_STREAM);
+        if (!generatePositions(rng, cancel)) {
+            return false;
+        }
+        d_detachOrder.reset(d_nucleosomes.size());
+        d_detachRng.reset(seed, DETACH_STREAM);
+        d_detached = 0;
+        d_built = POSITIONS_BUILT;
+    }
+    if (params.bias != d_params.bias) {
+        d_built = POSITIONS_BUILT;      // The cuttable DNA is weighted anew
+    }
+    d_params = params;
+
+    // Detach or reattach histones to reach the new count.  The order they
+    // are detached in is drawn as far as it is needed and then kept, so
+    // a histone's place in it acts as a fixed rank and the detached ones
+    // are always those ranked below the count.
+    int64_t num_to_remove = detachCount();
+    if ( (d_built != CUTTABLE_BUILT) || (num_to_remove != d_detached) ) {
+        d_built = POSITIONS_BUILT;
+        scoped_timer detach_timer(PHASE_DETACH);
+        int64_t was_detached = d_detached;
+
+        // With regions the histones are detached region by region, and the
+        // missing percent only matters outside them, so they are all drawn
+        // again from the start of the stream.
+        if (d_params.regions) {
+            d_nucleosomes.setAllAttached(true);
+            random_stream rng(seed, DETACH_STREAM);
+            if (!detachByRegion(rng, cancel)) {
+                return false;
+            }
+            d_detached = num_to_remove;
+            was_detached = num_to_remove;
+        }
+        while (d_detached < num_to_remove) {
+            if ( ((d_detached % CANCEL_CHECK_INTERVAL) == 0) && cancelled(cancel) ) {
+                return false;
+            }
+            if (static_cast<uint64_t>(d_detached) == d_detachOrder.drawn()) {
+                d_detachOrder.next(d_detachRng);
+            }
+            d_nucleosomes.setAttached(d_detachOrder.drawnAt(d_detached), false);
+            d_detached++;
+        }
+        while (d_detached > num_to_remove) {
+            if ( ((d_detached % CANCEL_CHECK_INTERVAL) == 0) && cancelled(cancel) ) {
+                return false;
+            }
+            d_detached--;
+            d_nucleosomes.setAttached(d_detachOrder.drawnAt(d_detached), true);
+        }
+        if (d_detached > was_detached) {
+            profiler::count(COUNT_DETACHED, d_detached - was_detached);
+        } else {
+            profiler::count(COUNT_REATTACHED, was_detached - d_detached);
+        }
+
+        // The cuts were placed in the old cuttable DNA, so they all go.
+        d_cuttable.build(d_nucleosomes, totalBasePairs(), d_params.regions.get(), d_params.bias.get());
+        d_cutLocations.reset(totalBasePairs());
+        d_cutsPlaced = 0;
+        d_built = CUTTABLE_BUILT;
+    }
+
+    return placeCuts(cutCount(), cancel);
+}
+
+bool chromatin_model::placeCuts(int64_t count, const std::atomic<bool> *cancel)
+{
+    if ( (count > 0) && (d_cuttable.totalCuttable() == 0) ) {
+        return false;
+    }
+    if (count == d_cutsPlaced) {
+        return true;
+    }
+
+    // Find the locations of the cuts being added or removed.
+    const int64_t first = std::min(count, d_cutsPlaced), last = std::max(count, d_cutsPlaced);
+    std::vector<int64_t> &changed = d_workspace.cuts(static_cast<size_t>(last - first));
+    if (!drawCuts(first, last, changed, cancel)) {
+        return false;
+    }
+
+    // Merge them into, or take them out of, the sorted cuts.
+    scoped_timer sort_timer(PHASE_SORT);
+    if (!changed.empty()) {
+        radix_sort(&changed[0], changed.size());
+    }
+    if (count > d_cutsPlaced) {
+        d_cutLocations.insertSorted(changed);
+    } else {
+        d_cutLocations.eraseSorted(changed);
+    }
+    d_cutsPlaced = count;
+    return true;
+}
+
+bool chromatin_model::drawCuts(int64_t first, int64_t last, std::vector<int64_t> &cuts,
+                               const std::atomic<bool> *cancel)
+{
+    // Cut i comes from uniform i of the cut stream, and each uniform takes
+    // two outputs, so we can go straight to the first one wanted.
+    scoped_timer cut_timer(PHASE_CUTS);
+    random_stream rng(d_seed, CUT_STREAM);
+    rng.seek(2 * static_cast<uint64_t>(first));
+    cuts.reserve(cuts.size() + (last - first));
+    double *uniforms = d_workspace.uniforms(static_cast<size_t>(std::min(last - first, CANCEL_CHECK_INTERVAL)));
+    int64_t i, j;
+    for (i = first; i < last; i += CANCEL_CHECK_INTERVAL) {
+        if (cancelled(cancel)) {
+            return false;
+        }
+        int64_t n = std::min(last - i, CANCEL_CHECK_INTERVAL);
+        rng.fillUniform(uniforms, n);
+        for (j = 0; j < n; j++) {
+            cuts.push_back(d_cuttable.sample(uniforms[j]));
+        }
+    }
+    profiler::count(COUNT_CUTS, last - first);
+    return true;
+}
+
+bool chromatin_model::digest(const chromatin_parameters &params, uint64_t seed,
+                             const std::vector<double> &cutsPer3kBasePairs,
+                             std::vector<fragment_histogram> &histograms,
+                             const std::atomic<bool> *cancel)
+{
+    // Lay out the model with no cuts, then draw every cut the last time
+    // point has.
+    chromatin_parameters uncut = params;
+    uncut.cutsPer3kBasePairs = 0;
+    if (!updateIncremental(uncut, seed, cancel)) {
+        return false;
+    }
+    if (cutsPer3kBasePairs.empty()) {
+        return true;
+    }
+    int64_t num_cuts = cutCount(cutsPer3kBasePairs.back());
+    if ( (num_cuts > 0) && (d_cuttable.totalCuttable() == 0) ) {
+        return false;
+    }
+    digestion_course &course = d_workspace.course();
+    {
+        std::vector<int64_t> &cuts = d_workspace.cuts(static_cast<size_t>(num_cuts));
+        if (!drawCuts(0, num_cuts, cuts, cancel)) {
+            return false;
+        }
+        course.reset(cuts);
+    }
+
+    // Then take them out again, newest first, keeping the histogram of the
+    // cuts still in up to date and adding it in at each time point.
+    fragment_histogram &current = d_workspace.histogram();
+    current.reset(histograms.back().layout());
+    course.addFragmentLengths(current);
+    size_t p = cutsPer3kBasePairs.size();
+    while (p-- > 0) {
+        course.removeNewest(static_cast<size_t>(cutCount(cutsPer3kBasePairs[p])), current);
+        histograms[p].merge(current);
+    }
+    return true;
+}
+
+void chromatin_model::assign(const chromatin_parameters &params, const nucleosome_array &nucleosomes,
+                             const cut_array &cuts)
+{
+    d_built = NOTHING_BUILT;
+    d_params = params;
+    d_nucleosomes = nucleosomes;
+    d_cutLocations = cuts;
+    d_cuttable = cuttable_index();
+}
+
+bool chromatin_model::streamFragmentLengths(random_stream &rng, fragment_accumulator &lengths)
+{
+    scoped_timer timer(PHASE_MODEL);
+    d_built = NOTHING_BUILT;
+    generateLayout(rng);
+    d_cutLocations.reset(totalBasePairs());
+    int64_t num_cuts = cutCount();
+    if ( (num_cuts > 0) && (d_cuttable.totalCuttable() == 0) ) {
+        return false;
+    }
+
+    // Draw the offsets of the cuts into the cuttable base pairs in
+    // increasing order, so each one can be turned into a location by
+    // walking forward through the index and its fragment counted at once.
+    scoped_timer stream_timer(PHASE_STREAM);
+    const int64_t total_cuttable = d_cuttable.totalCuttable();
+    sorted_uniforms offsets(num_cuts);
+    size_t interval = 0;
+    int64_t last_cut = 0;
+    int64_t fragments = 0;
+    while (!offsets.done()) {
+        int64_t offset = static_cast<int64_t>(offsets.next(rng) * total_cuttable);
+        if (offset >= total_cuttable) { offset = total_cuttable - 1; }
+        int64_t cut = d_cuttable.location(offset, interval);
+
+        // If two cut at the same location, we don't count it as a zero cut.
+        if (cut > last_cut) {
+            lengths.addFragment(cut - last_cut);
+            last_cut = cut;
+            fragments++;
+        }
+    }
+    profiler::count(COUNT_CUTS, num_cuts);
+    profiler::count(COUNT_FRAGMENTS, fragments);
+    profiler::count(COUNT_DUPLICATE_CUTS, num_cuts - fragments);
+    return true;
+}
+
+int64_t chromatin_model::cutCount(double cutsPer3kBasePairs) const
+{
+    // We compute the number of base pairs by multiplying the expected amount of DNA
+    // per nucleosome (including linker) by the number of nucleosomes.
+    return static_cast<int64_t>((totalBasePairs()/3.0e3) * cutsPer3kBasePairs);
+}
+
+int64_t chromatin_model::detachCount(void) const
+{
+    int64_t num_to_remove = static_cast<int64_t>(d_params.totalNucleosomes*(d_params.missingHistonePercent/100.0));
+    return std::min(num_to_remove, static_cast<int64_t>(d_nucleosomes.size()));
+}
+
+bool chromatin_model::generateLayout(random_stream &rng, const std::atomic<bool> *cancel)
+{
+    if (!generatePositions(rng, cancel)) {
+        return false;
+    }
+
+    // Figure out which nucleosomes are detached.  We do this by drawing
+    // the specified percent of them without replacement, each subset being
+    // equally likely; the cost is proportional to the number removed.
+    // if they are all to be detached, we just do that without randomness.
+    int64_t num_to_remove = detachCount();
+    int64_t num_nucleosomes = static_cast<int64_t>(d_nucleosomes.size());
+    if (d_params.regions) {
+        if (!detachByRegion(rng, cancel)) {
+            return false;
+        }
+    } else {
+        scoped_timer detach_timer(PHASE_DETACH);
+        if (num_to_remove >= num_nucleosomes) {
+            d_nucleosomes.setAllAttached(false);
+        } else {
+            index_sampler &sampler = d_workspace.sampler(num_nucleosomes, num_to_remove);
+            int64_t i;
+            for (i = 0; i < num_to_remove; i++) {
+                if ( ((i % CANCEL_CHECK_INTERVAL) == 0) && cancelled(cancel) ) {
+                    return false;
+                }
+                d_nucleosomes.setAttached(sampler.next(rng), false);
+            }
+        }
+        profiler::count(COUNT_DETACHED, std::min(num_to_remove, num_nucleosomes));
+    }
+
+    // Index the base pairs that are left uncovered, where cuts can go.
+    d_cuttable.build(d_nucleosomes, totalBasePairs(), d_params.regions.get(), d_params.bias.get());
+    return true;
+}
+
+bool chromatin_model::detachByRegion(random_stream &rng, const std::atomic<bool> *cancel)
+{
+    scoped_timer timer(PHASE_DETACH);
+    region_track::cursor regions(d_params.regions.get());
+    index_sampler &sampler = d_workspace.sampler(0, 0);
+    const double outside = d_params.missingHistonePercent / 100.0;
+    const size_t count = d_nucleosomes.size();
+    size_t first, last = 0;
+    int64_t linker_start = 0;   // Where the linker before nucleosome last starts
+    int64_t detached = 0;
+    nucleosome_array::cursor n(d_nucleosomes);
+    while (last < count) {
+        if (cancelled(cancel)) {
+            return false;
+        }
+
+        // Find the nucleosomes whose linkers start before the values change.
+        const region *r = regions.find(linker_start);
+        double missing = ( (r != NULL) && (r->occupancy >= 0) ) ? 1 - r->occupancy : outside;
+        int64_t change = regions.changeAfter(linker_start);
+        first = last;
+        while ( (last < count) && (linker_start < change) ) {
+            linker_start = n.location() + 1;
+            n.next();
+            last++;
+        }
+
+        int64_t num_to_remove = static_cast<int64_t>((last - first) * missing);
+        sampler.reset(last - first);
+        int64_t i;
+        for (i = 0; i < num_to_remove; i++) {
+            d_nucleosomes.setAttached(first + sampler.next(rng), false);
+        }
+        detached += num_to_remove;
+    }
+    profiler::count(COUNT_DETACHED, detached);
+    return true;
+}
+
+bool chromatin_model::generatePositions(random_stream &rng, const std::atomic<bool> *cancel)
+{
+    if (d_params.regions) {
+        return generateRegionPositions(rng, cancel);
+    }
+    scoped_timer timer(PHASE_POSITIONS);
+    const int bpPerNucleosome = d_params.bpPerNucleosome;
+    const int bpPerLinker = d_params.bpPerLinker;
+    const int totalNucleosomes = d_params.totalNucleosomes;
+
+    // Clear the list of nucleosome locations in preparation to making a
+    // new model.
+    d_nucleosomes.reset(bpPerNucleosome);
+    d_nucleosomes.reserve(totalNucleosomes);
+
+    // Add nucleosomes into the model.  Each histone causes a chain of
+    // DNA bpPerNucleosome base-pairs long to wrap around it to form a nucleosome.
+    // The length of DNA between each wrapped nucleosome is on average
+    // bpPerLinker base-pairs long.  When we add a new nucleosome, we do so by
+    // figuring out how long the linker is from the last one (must be
+    // at least 1 base-pair long) and add it to the last nucleosome
+    // index, then we add a whole nucleosome length and locate the
+    // new nucleosome there.
+    //
+    // Linker lengths are Gaussian distributed based on the variance, with
+    // a mean at the specified linker length, truncated to an integer.  A
+    // length less than 1 is not allowed, and neither is one of twice the
+    // linker length or more; this will avoid increasing the mean separation.
+    // Rather than drawing normal samples until one fits, each length comes
+    // straight from one uniform through the inverse of the cumulative
+    // distribution of the lengths that fit, so a whole chunk of them can be
+    // drawn at once.
+    const bool varied = d_params.nucleosomeSpacingVariance > 0;
+    linker_distribution linkers(bpPerLinker, d_params.nucleosomeSpacingVariance);
+    double *uniforms = NULL;
+    if (varied) {
+        uniforms = d_workspace.uniforms(static_cast<size_t>(std::min(static_cast<int64_t>(totalNucleosomes),
+                                                                     CANCEL_CHECK_INTERVAL)));
+    }
+    int64_t i, j;
+    for (i = 0; i < totalNucleosomes; i += CANCEL_CHECK_INTERVAL) {
+        if (cancelled(cancel)) {
+            return false;
+        }
+        int64_t n = std::min(totalNucleosomes - i, CANCEL_CHECK_INTERVAL);
+
+        // Add each length onto the existing DNA strand and put a nucleosome
+        // there.  The nucleosome array keeps them in order of location.
+        if (varied) {
+            rng.fillUniform(uniforms, n);
+            for (j = 0; j < n; j++) {
+                d_nucleosomes.push_back(linkers.sample(uniforms[j]));
+            }
+        } else {
+            for (j = 0; j < n; j++) {
+                d_nucleosomes.push_back(bpPerLinker);
+            }
+        }
+    }
+    profiler::count(COUNT_NUCLEOSOMES, totalNucleosomes);
+    return true;
+}
+
+bool chromatin_model::generateRegionPositions(random_stream &rng, const std::atomic<bool> *cancel)
+{
+    scoped_timer timer(PHASE_POSITIONS);
+    const int bpPerNucleosome = d_params.bpPerNucleosome;
+    const int totalNucleosomes = d_params.totalNucleosomes;
+    d_nucleosomes.reset(bpPerNucleosome);
+    d_nucleosomes.reserve(totalNucleosomes);
+
+    // Every linker takes a uniform, whatever its variance, and is drawn
+    // from the distribution for the region it starts in.  The regions are
+    // walked along with the strand, and each distinct mean and variance
+    // is tabulated once.
+    region_track::cursor regions(d_params.regions.get());
+    typedef std::pair<int, double> linker_key;
+    std::map<linker_key, linker_distribution> distributions;
+    const linker_distribution *linkers = NULL;
+    int64_t location = 0;       // Of the last nucleosome added
+    int64_t linker_start = 0;   // Where the next linker starts
+    int64_t change = 0;         // Where the values next change
+    double *uniforms = d_workspace.uniforms(static_cast<size_t>(std::min(static_cast<int64_t>(totalNucleosomes),
+                                                                         CANCEL_CHECK_INTERVAL)));
+    int64_t i, j;
+    for (i = 0; i < totalNucleosomes; i += CANCEL_CHECK_INTERVAL) {
+        if (cancelled(cancel)) {
+            return false;
+        }
+        int64_t n = std::min(totalNucleosomes - i, CANCEL_CHECK_INTERVAL);
+        rng.fillUniform(uniforms, n);
+        for (j = 0; j < n; j++) {
+            if (linker_start >= change) {
+                const region *r = regions.find(linker_start);
+                linker_key key(d_params.bpPerLinker, d_params.nucleosomeSpacingVariance);
+                if (r != NULL) {
+                    if (r->bpPerLinker > 0) { key.first = r->bpPerLinker; }
+                    if (r->variance >= 0) { key.second = r->variance; }
+                }
+                std::map<linker_key, linker_distribution>::iterator found = distributions.find(key);
+                if (found == distributions.end()) {
+                    found = distributions.insert(std::make_pair(key,
+                                linker_distribution(key.first, key.second))).first;
+                }
+                linkers = &found->second;
+                change = regions.changeAfter(linker_start);
+            }
+            int length = linkers->sample(uniforms[j]);
+            d_nucleosomes.push_back(length);
+            location += length + bpPerNucleosome;
+            linker_start = location + 1;
+        }
+    }
+    profiler::count(COUNT_NUCLEOSOMES, totalNucleosomes);
+    return true;
+}
+
+// Returns true if the specified location is a valid cut location
+// (a base pair that is not inside a wrapped nucleosome) and false if
+// it is inside a wrapped nucleosome.
+bool chromatin_model::validCutLocation(int64_t loc) const
+{
+    // Find the first nucleosome that is at a location that is equal to
+    // or larger than the location.
+    size_t i = d_nucleosomes.lowerBound(loc);
+
+    // If there is one, then see if we're within the wrapped base-pair region.
+    // Then see if this histone is wrapped.
+    // If so, return false.
+    if ( (i < d_nucleosomes.size()) && d_nucleosomes.attached(i) ) {
+        int64_t nuc_loc = d_nucleosomes.location(i);
+        if (nuc_loc - d_params.bpPerNucleosome <= loc) {
+            return false;
+        }
+    }
+
+    // We're in the clear.
+    return true;
+}
+
+int64_t chromatin_model::totalBasePairs(void) const
+{
+    if (d_params.regions) {
+        return d_nucleosomes.size() > 0 ? d_nucleosomes.location(d_nucleosomes.size() - 1) : 0;
+    }
+    return static_cast<int64_t>(d_params.bpPerNucleosome + d_params.bpPerLinker)
+           * d_params.totalNucleosomes;
+}
+
+size_t chromatin_model::memoryUsage(void) const
+{
+    return d_nucleosomes.memoryUsage() + d_cutLocations.memoryUsage()
+         + d_cuttable.memoryUsage();
+}
+
+void chromatin_model::addFragmentLengths(fragment_accumulator &lengths) const
+{
+    scoped_timer timer(PHASE_FRAGMENTS);
+
+    // Compute the number of base pairs between each pair of cuts.
+    size_t i;
+    int64_t last_cut = 0;
+    uint64_t fragments = 0;
+    for (i = 0; i < d_cutLocations.size(); i++) {
+        int64_t bp = d_cutLocations[i] - last_cut;
+
+        // If two cut at the same location, we don't count it as a zero cut.
+        if (bp > 0) {
+            lengths.addFragment(bp);
+            last_cut = d_cutLocations[i];
+            fragments++;
+        }
+    }
+    profiler::count(COUNT_FRAGMENTS, fragments);
+    profiler::count(COUNT_DUPLICATE_CUTS, d_cutLocations.size() - fragments);
+}
+
+bool chromatin_model::computeStatistics(fragment_histogram &histogram, int num_bins) const
+{
+    fragment_length_counts lengths;
+    addFragmentLengths(lengths);
+    scoped_timer timer(PHASE_BINNING);
+    return lengths.histogram(histogram, num_bins);
+}
@@ -0,0 +1,204 @@
+// The nucleosome/cut model that the chromatinCutter GUI displays.  This
+// file (and chromatin_model.cpp) deliberately depends on nothing but the
+// C++ standard library so that the model can be built into the headless
+// batch driver and run on machines without a display or an OpenGL context.
+
+#ifndef _CHROMATIN_MODEL_H_
+#define _CHROMATIN_MODEL_H_
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include "cuttable_index.h"
+#include "nucleosome_array.h"
+#include "cut_array.h"
+#include "fragment_histogram.h"
+#include "index_sampler.h"
+#include "random_stream.h"
+#include "region_track.h"
+#include "sequence_bias.h"
+#include "model_workspace.h"
+
+// Changes whenever the engine would give different results for the same
+// parameters and seed, so that results stored by an older version are not
+// mistaken for ones this version would produce.
+#define CHROMATIN_ENGINE_VERSION 2
+
+// The parameters that control the generation of a model.  The rate-like
+// parameters are stored as doubles so that non-interactive clients can
+// ask for values between the integer steps the sliders provide.
+class chromatin_parameters {
+public:
+    chromatin_parameters();
+
+    int     bpPerNucleosome;            // Base pairs wrapped around each histone
+    int     bpPerLinker;                // Mean base pairs between nucleosomes (at most 32767)
+    int     totalNucleosomes;           // How many nucleosomes in the model
+    double  missingHistonePercent;      // Percent of histones that are detached
+    double  nucleosomeSpacingVariance;  // Variance of the linker length
+    double  cutsPer3kBasePairs;         // Cut density
+
+    // Values that differ along the strand, overriding the ones above
+    // within their regions, or NULL for a uniform strand.
+    std::shared_ptr<const region_track> regions;
+
+    // Sequence preferences of the enzyme, which weight where the cuts go
+    // within the cuttable DNA, or NULL to cut it uniformly.
+    std::shared_ptr<const sequence_bias> bias;
+};
+
+class chromatin_model {
+public:
+    chromatin_model();
+
+    const chromatin_parameters &parameters(void) const { return d_params; }
+    void setParameters(const chromatin_parameters &params) { d_params = params; }
+
+    // Updates the model of histone and cut locations based on
+    // the now-current values for the parameters.  All randomness comes
+    // from the specified stream.  Returns false if cuts were requested but
+    // there is no cuttable DNA left to put them in; the model then has no
+    // cuts.  If a cancel flag is given, it is checked as the model is built
+    // and once it is set the update stops early and returns false, leaving
+    // the model incomplete; this lets another thread abandon a run that a
+    // newer one has made pointless.
+    bool updateModel(random_stream &rng, const std::atomic<bool> *cancel = NULL);
+
+    // Brings the model up to date with the specified parameters, redoing
+    // only the stages that depend on what changed since the last call.
+    // The nucleosome positions depend on everything but the histone and
+    // cut rates.  Histones are detached in a fixed random order, so a new
+    // missing percent detaches or reattaches just the difference and then
+    // re-indexes the cuttable DNA.  Cut i is always drawn from uniform i of
+    // a fixed stream, so a new cut density adds or removes just the
+    // difference while the cuttable DNA is unchanged.  Each stage draws
+    // from its own stream of the specified seed, so the same parameters
+    // and seed always give the same model and small changes give small
+    // changes in the model.  Returns false (and can be cancelled) just as
+    // updateModel does; a cancelled call leaves things so that the next
+    // one picks up where it stopped.
+    bool updateIncremental(const chromatin_parameters &params, uint64_t seed,
+                           const std::atomic<bool> *cancel = NULL);
+
+    // Generates the nucleosomes the same way as updateModel, but rather
+    // than storing the cuts it draws them in sorted order and adds each
+    // fragment length straight into the specified accumulator, so memory
+    // does not grow with the number of cuts.  The model is left with no
+    // cuts.  Returns false under the same conditions as updateModel.
+    bool streamFragmentLengths(random_stream &rng, fragment_accumulator &lengths);
+
+    // Digests the model over time (see digestion_course.h).  The model is
+    // brought up to date with the specified parameters and seed, as by
+    // updateIncremental, and then for each of the cut densities, which
+    // must not decrease, the fragments it would have at that density are
+    // added into the matching histogram.  The whole series takes about as
+    // long as the last density alone.  The model is left with no cuts.
+    // Returns false (and can be cancelled) just as updateModel does.
+    bool digest(const chromatin_parameters &params, uint64_t seed,
+                const std::vector<double> &cutsPer3kBasePairs,
+                std::vector<fragment_histogram> &histograms,
+                const std::atomic<bool> *cancel = NULL);
+
+    // Replaces the model with the specified nucleosomes and cuts, such as
+    // ones read from a run file, which may be viewing it in place.  The
+    // cuttable index is left empty and the next updateIncremental starts
+    // from scratch.
+    void assign(const chromatin_parameters &params, const nucleosome_array &nucleosomes,
+                const cut_array &cuts);
+
+    // Adds the lengths of the fragments between cuts in the model into
+    // the specified accumulator.
+    void addFragmentLengths(fragment_accumulator &lengths) const;
+
+    // Computes the histogram of fragment lengths based on the model, with
+    // linear bins spanning the shortest to the longest fragment.
+    // Returns false if there were not enough fragments to form one.
+    bool computeStatistics(fragment_histogram &histogram, int num_bins = 100) const;
+
+    // Returns true if the specified location is a valid cut location
+    // (a base pair that is not inside a wrapped nucleosome).
+    bool validCutLocation(int64_t loc) const;
+
+    // The nucleosomes, in order of increasing location.  They are stored
+    // compactly; see nucleosome_array.
+    const nucleosome_array &nucleosomes(void) const { return d_nucleosomes; }
+
+    // The cut locations, in base pairs, sorted by location.
+    const cut_array &cutLocations(void) const { return d_cutLocations; }
+
+    // Total number of base pairs in the model.  With regions the mean
+    // linker length varies along the strand, so this is only known once
+    // the nucleosomes are laid out.
+    int64_t totalBasePairs(void) const;
+
+    // Position of nucleosome i along the strand as the display lays it
+    // out, which leaves out the DNA wrapped by it and by every nucleosome
+    // before it, so that only the linkers take up room.
+    int64_t strandLocation(size_t i) const {
+        return d_nucleosomes.location(i) - static_cast<int64_t>(i + 1) * d_params.bpPerNucleosome;
+    }
+
+    // Bytes used to store the nucleosomes, cuts and cuttable index.
+    size_t memoryUsage(void) const;
+
+    // The base pairs that could be cut in the current model.
+    const cuttable_index &cuttable(void) const { return d_cuttable; }
+
+private:
+    // Makes a new set of nucleosomes, detaches the requested fraction of
+    // their histones and indexes the cuttable base pairs.  Returns false
+    // if it was cancelled part way through.
+    bool generateLayout(random_stream &rng, const std::atomic<bool> *cancel = NULL);
+
+    // Makes a new set of nucleosomes, all with their histones attached.
+    // Returns false if it was cancelled part way through.
+    bool generatePositions(random_stream &rng, const std::atomic<bool> *cancel);
+
+    // The same, for a strand with regions: each linker is drawn with the
+    // mean and variance of the region it starts in.
+    bool generateRegionPositions(random_stream &rng, const std::atomic<bool> *cancel);
+
+    // Detaches histones from the attached nucleosomes of a strand with
+    // regions.  Within each run of nucleosomes whose linkers start in the
+    // same region, or the same gap between regions, the share the region's
+    // occupancy leaves missing (or the missing percent, outside regions) is
+    // drawn without replacement.  Returns false if it was cancelled.
+    bool detachByRegion(random_stream &rng, const std::atomic<bool> *cancel);
+
+    // Adds or removes cuts, drawn from the incremental cut stream, until
+    // the first count of them are placed.
+    bool placeCuts(int64_t count, const std::atomic<bool> *cancel);
+
+    // Draws cuts [first, last) of the incremental cut stream into cuts, in
+    // the order they are drawn.  Returns false if it was cancelled.
+    bool drawCuts(int64_t first, int64_t last, std::vector<int64_t> &cuts,
+                  const std::atomic<bool> *cancel);
+
+    // Number of cuts to place, given the cut density.
+    int64_t cutCount(void) const { return cutCount(d_params.cutsPer3kBasePairs); }
+    int64_t cutCount(double cutsPer3kBasePairs) const;
+
+    // Number of histones to detach, given the missing percent.
+    int64_t detachCount(void) const;
+
+    // How far the state kept by updateIncremental is up to date.
+    enum stage { NOTHING_BUILT, POSITIONS_BUILT, CUTTABLE_BUILT };
+
+    chromatin_parameters    d_params;
+    nucleosome_array        d_nucleosomes;
+    cuttable_index          d_cuttable;
+    cut_array               d_cutLocations;
+
+    // State kept by updateIncremental.
+    stage                   d_built;        // Which stages match d_params
+    uint64_t                d_seed;         // Seed for the stage streams
+    index_sampler           d_detachOrder;  // Order histones are detached in
+    random_stream           d_detachRng;    // Stream d_detachOrder draws from
+    int64_t                 d_detached;     // How many of them are detached
+    int64_t                 d_cutsPlaced;   // How many of the cut stream are placed
+
+    model_workspace         d_workspace;    // Scratch every build reuses
+};
+
+#endif
@@ -0,0 +1,115 @@
+// A sequence of plain values that either owns its storage, like a
+// std::vector, or views read-only memory that something else owns, such
+// as a mapped run file (see run_file.h).  Reading works the same either
+// way.  The first change to a viewed column copies it into storage of its
+// own, so a model opened from a file can still be modified.  A viewing
+// column keeps a shared reference to the owner of the memory, so copies
+// of it can outlive whatever made them.
+
+#ifndef _COLUMN_H_
+#define _COLUMN_H_
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <stddef.h>
+
+template <class T>
+class column {
+public:
+    column() : d_data(NULL), d_size(0) {}
+    column(const column &other) : d_data(NULL), d_size(0) { *this = other; }
+    column(column &&other) : d_data(NULL), d_size(0) { *this = std::move(other); }
+
+    column &operator=(const column &other) {
+        if (this != &other) {
+            d_owned = other.d_owned;
+            d_owner = other.d_owner;
+            if (d_owner) {
+                d_data = other.d_data;
+                d_size = other.d_size;
+            } else {
+                sync();
+            }
+        }
+        return *this;
+    }
+
+    column &operator=(column &&other) {
+        if (this != &other) {
+            d_owned.swap(other.d_owned);
+            d_owner.swap(other.d_owner);
+            if (d_owner) {
+                d_data = other.d_data;
+                d_size = other.d_size;
+            } else {
+                sync();
+            }
+            other.release();
+        }
+        return *this;
+    }
+
+    // Views count values at data, which must stay valid as long as owner
+    // does.  Any storage of the column's own is freed.
+    void view(const T *data, size_t count, const std::shared_ptr<const void> &owner) {
+        std::vector<T>().swap(d_owned);
+        d_owner = owner;
+        d_data = data;
+        d_size = count;
+    }
+
+    // Takes over the contents of values, leaving it empty.
+    void adopt(std::vector<T> &values) {
+        d_owner.reset();
+        d_owned.swap(values);
+        std::vector<T>().swap(values);
+        sync();
+    }
+
+    // Is this viewing memory it does not own?
+    bool viewing(void) const { return d_owner != NULL; }
+
+    size_t size(void) const { return d_size; }
+    bool empty(void) const { return d_size == 0; }
+    const T &operator[](size_t i) const { return d_data[i]; }
+    const T &back(void) const { return d_data[d_size - 1]; }
+    const T *begin(void) const { return d_data; }
+    const T *end(void) const { return d_data + d_size; }
+
+    // Returns the values for changing in place.
+    T *edit(void) { own(); return d_owned.empty() ? NULL : &d_owned[0]; }
+
+    void push_back(const T &value) { own(); d_owned.push_back(value); sync(); }
+    void reserve(size_t count) { own(); d_owned.reserve(count); sync(); }
+    void resize(size_t count) { own(); d_owned.resize(count); sync(); }
+    void clear(void) { d_owner.reset(); d_owned.clear(); sync(); }
+
+    // Empties the column and frees its storage.
+    void release(void) { d_owner.reset(); std::vector<T>().swap(d_owned); sync(); }
+
+    // Values the column's own storage has room for; none while viewing.
+    size_t capacity(void) const { return d_owned.capacity(); }
+
+private:
+    // Copies viewed values into storage of our own.
+    void own(void) {
+        if (d_owner) {
+            d_owned.assign(d_data, d_data + d_size);
+            d_owner.reset();
+            sync();
+        }
+    }
+
+    void sync(void) {
+        d_data = d_owned.empty() ? NULL : &d_owned[0];
+        d_size = d_owned.size();
+    }
+
+    std::vector<T>              d_owned;    // Values, when not viewing
+    std::shared_ptr<const void> d_owner;    // Keeps viewed memory valid
+    const T                     *d_data;    // Values being read
+    size_t                      d_size;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include <algorithm>
+
+#include "cut_array.h"
+#include "radix_sort.h"
+
+void cut_array::reset(int64_t num_bps)
+{
+    d_wide = num_bps > static_cast<int64_t>(0xFFFFFFFFu);
+    d_narrowCuts.clear();
+    d_wideCuts.clear();
+    if (d_wide) {
+        d_narrowCuts.release();
+    } else {
+        d_wideCuts.release();
+    }
+}
+
+void cut_array::assign(const column<uint32_t> &locations)
+{
+    d_wide = false;
+    d_narrowCuts = locations;
+    d_wideCuts.release();
+}
+
+void cut_array::assign(const column<uint64_t> &locations)
+{
+    d_wide = true;
+    d_wideCuts = locations;
+    d_narrowCuts.release();
+}
+
+void cut_array::reserve(size_t count)
+{
+    if (d_wide) { d_wideCuts.reserve(count); }
+    else { d_narrowCuts.reserve(count); }
+}
+
+void cut_array::sort(void)
+{
+    if (d_wide) { radix_sort(d_wideCuts.edit(), d_wideCuts.size()); }
+    else { radix_sort(d_narrowCuts.edit(), d_narrowCuts.size()); }
+}
+
+template <class T>
+static void insert_sorted(column<T> &cuts, const std::vector<int64_t> &locations)
+{
+    size_t old_size = cuts.size();
+    size_t i;
+    for (i = 0; i < locations.size(); i++) {
+        cuts.push_back(static_cast<T>(locations[i]));
+    }
+    T *values = cuts.edit();
+    std::inplace_merge(values, values + old_size, values + cuts.size());
+}
+
+template <class T>
+static void erase_sorted(column<T> &cuts, const std::vector<int64_t> &locations)
+{
+    // Walk both lists together, copying down each cut that is not matched
+    // by the next location to remove.
+    T *values = cuts.edit();
+    size_t from, to = 0, next = 0;
+    for (from = 0; from < cuts.size(); from++) {
+        if ( (next < locations.size()) && (static_cast<int64_t>(values[from]) == locations[next]) ) {
+            next++;
+        } else {
+            values[to++] = values[from];
+        }
+    }
+    cuts.resize(to);
+}
+
+void cut_array::insertSorted(const std::vector<int64_t> &locations)
+{
+    if (d_wide) { insert_sorted(d_wideCuts, locations); }
+    else { insert_sorted(d_narrowCuts, locations); }
+}
+
+void cut_array::eraseSorted(const std::vector<int64_t> &locations)
+{
+    if (d_wide) { erase_sorted(d_wideCuts, locations); }
+    else { erase_sorted(d_narrowCuts, locations); }
+}
+
+size_t cut_array::memoryUsage(void) const
+{
+    return d_narrowCuts.capacity() * sizeof(uint32_t)
+         + d_wideCuts.capacity() * sizeof(uint64_t);
+}
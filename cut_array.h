@@ -0,0 +1,68 @@
+// Compact storage for the cut locations of a chromatin model.  Cuts are
+// kept as 32-bit offsets when every location fits and as 64-bit ones only
+// when the model is longer than that, halving the memory for all but the
+// largest models.  The locations are a column, so they can also be read
+// in place from a mapped run file.
+
+#ifndef _CUT_ARRAY_H_
+#define _CUT_ARRAY_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "column.h"
+
+class cut_array {
+public:
+    cut_array() : d_wide(false) {}
+
+    // Removes all cuts and chooses the storage width for locations in
+    // [0, num_bps).
+    void reset(int64_t num_bps);
+    void reserve(size_t count);
+
+    void push_back(int64_t location) {
+        if (d_wide) { d_wideCuts.push_back(static_cast<uint64_t>(location)); }
+        else { d_narrowCuts.push_back(static_cast<uint32_t>(location)); }
+    }
+
+    size_t size(void) const { return d_wide ? d_wideCuts.size() : d_narrowCuts.size(); }
+    int64_t operator[](size_t i) const {
+        return d_wide ? static_cast<int64_t>(d_wideCuts[i]) : static_cast<int64_t>(d_narrowCuts[i]);
+    }
+
+    // Sorts the cuts into increasing order, in time linear in their number
+    // and across all cores when there are many of them (see radix_sort.h).
+    void sort(void);
+
+    // Adds cuts at the specified locations, which must be sorted, into
+    // already-sorted cuts, keeping them sorted.  Takes time linear in the
+    // total number of cuts.
+    void insertSorted(const std::vector<int64_t> &locations);
+
+    // Removes one cut at each of the specified locations, which must be
+    // sorted, from already-sorted cuts.  Each one must be present.  Takes
+    // time linear in the total number of cuts.
+    void eraseSorted(const std::vector<int64_t> &locations);
+
+    // Bytes used to store the cuts.
+    size_t memoryUsage(void) const;
+
+    // The stored column of locations: the 64-bit one when wide() and the
+    // 32-bit one otherwise.
+    bool wide(void) const { return d_wide; }
+    const column<uint32_t> &narrowColumn(void) const { return d_narrowCuts; }
+    const column<uint64_t> &wideColumn(void) const { return d_wideCuts; }
+
+    // Replaces the cuts with the sorted locations in the column, such as
+    // one viewing a run file.
+    void assign(const column<uint32_t> &locations);
+    void assign(const column<uint64_t> &locations);
+
+private:
+    bool                    d_wide;         // Are we using 64-bit storage?
+    column<uint32_t>        d_narrowCuts;
+    column<uint64_t>        d_wideCuts;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <math.h>
+
+#include "cuttable_index.h"
+#include "nucleosome_array.h"
+#include "sequence_bias.h"
+#include "profiler.h"
+
+cuttable_index::cuttable_index()
+    : d_bias(NULL)
+{
+    d_cumulative.push_back(0);
+}
+
+void cuttable_index::addPiece(int64_t start, int64_t end, const uint32_t *weight)
+{
+    // With a bias the interval weighs the sequence weight it holds, and
+    // one that holds none cannot be cut at all.
+    int64_t length = end - start;
+    if (d_bias != NULL) {
+        uint64_t before = d_bias->cumulative(start);
+        length = static_cast<int64_t>(d_bias->cumulative(end) - before);
+        if (length == 0) {
+            return;
+        }
+        d_biasStarts.push_back(before);
+    }
+    d_starts.push_back(start);
+    if (weight == NULL) {
+        d_cumulative.push_back(d_cumulative.back() + length);
+    } else {
+        d_cumulative.push_back(d_cumulative.back() + length * *weight);
+        d_weights.push_back(*weight);
+    }
+}
+
+void cuttable_index::addInterval(int64_t start, int64_t end, span_weight *span)
+{
+    if (span == NULL) {
+        addPiece(start, end, NULL);
+        return;
+    }
+    while (start < end) {
+        if (start >= span->change) {
+            const region *r = span->regions.find(start);
+            span->weight = (r == NULL) ? static_cast<uint32_t>(ACCESSIBILITY_SCALE)
+                : static_cast<uint32_t>(floor(r->accessibility * ACCESSIBILITY_SCALE + 0.5));
+            span->change = span->regions.changeAfter(start);
+        }
+        int64_t piece_end = std::min(end, span->change);
+        if (span->weight > 0) {
+            addPiece(start, piece_end, &span->weight);
+        }
+        start = piece_end;
+    }
+}
+
+void cuttable_index::build(const nucleosome_array &nucleosomes, int64_t num_bps,
+                           const region_track *regions, const sequence_bias *bias)
+{
+    scoped_timer timer(PHASE_CUTTABLE);
+    d_starts.clear();
+    d_cumulative.clear();
+    d_cumulative.push_back(0);
+    d_weights.clear();
+    d_bias = bias;
+    d_biasStarts.clear();
+    span_weight weights(regions);
+    span_weight *split = (regions != NULL) ? &weights : NULL;
+
+    // Walk the attached nucleosomes in order.  The cuttable interval before
+    // each one runs from just past the end of the previous wrapped region
+    // up to (but not including) the first base pair wrapped by this one.
+    // Detached nucleosomes wrap nothing, so they just extend the interval.
+    const int bpPerNucleosome = nucleosomes.bpPerNucleosome();
+    int64_t start = 0;
+    nucleosome_array::cursor n(nucleosomes);
+    for (; !n.done() && (start < num_bps); n.next()) {
+        if (!n.attached()) { continue; }
+        int64_t end = std::min(n.location() - bpPerNucleosome, num_bps);
+        if (end > start) {
+            addInterval(start, end, split);
+        }
+        start = n.location() + 1;
+    }
+    if (start < num_bps) {
+        addInterval(start, num_bps, split);
+    }
+}
+
+int64_t cuttable_index::locationIn(size_t interval, int64_t offset) const
+{
+    int64_t within = offset - d_cumulative[interval];
+    if (!d_weights.empty()) {
+        within /= d_weights[interval];
+    }
+    if (d_bias != NULL) {
+        return d_bias->locate(d_biasStarts[interval] + within);
+    }
+    return d_starts[interval] + within;
+}
+
+int64_t cuttable_index::location(int64_t offset) const
+{
+    // Find the last interval that starts at or before the offset.
+    std::vector<int64_t>::const_iterator i =
+        std::upper_bound(d_cumulative.begin(), d_cumulative.end(), offset);
+    return locationIn((i - d_cumulative.begin()) - 1, offset);
+}
+
+int64_t cuttable_index::location(int64_t offset, size_t &interval) const
+{
+    while (d_cumulative[interval + 1] <= offset) {
+        interval++;
+    }
+    return locationIn(interval, offset);
+}
+
+int64_t cuttable_index::sample(double u) const
+{
+    int64_t offset = static_cast<int64_t>(u * totalCuttable());
+    if (offset >= totalCuttable()) { offset = totalCuttable() - 1; }
+    return location(offset);
+}
+
+size_t cuttable_index::memoryUsage(void) const
+{
+    return (d_starts.capacity() + d_cumulative.capacity()) * sizeof(int64_t)
+         + d_weights.capacity() * sizeof(uint32_t) + d_biasStarts.capacity() * sizeof(uint64_t);
+}
@@ -0,0 +1,96 @@
+// Index of the base pairs that can be cut in a chromatin model: the
+// linkers plus the DNA of any nucleosome whose histone is missing.  The
+// cuttable intervals are stored with a prefix sum of their lengths so that
+// the k'th cuttable base pair can be found with a binary search, which
+// lets cuts be placed directly rather than by rejecting wrapped locations.
+// When the model has regions of differing accessibility (see
+// region_track.h), the intervals are split where it changes and each base
+// pair counts ACCESSIBILITY_SCALE times its accessibility, so the same
+// search places cuts in proportion to it.  With a sequence bias (see
+// sequence_bias.h) each interval instead weighs the sum of its base pairs'
+// sequence weights, times its accessibility, and a cut is placed within
+// its interval by a search of the bias index; a cut then lands with
+// probability proportional to the product, in O(log n) time.
+
+#ifndef _CUTTABLE_INDEX_H_
+#define _CUTTABLE_INDEX_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "region_track.h"
+
+class nucleosome_array;
+class sequence_bias;
+
+class cuttable_index {
+public:
+    enum { ACCESSIBILITY_SCALE = 1024 };    // Weight of a base pair of accessibility 1
+
+    cuttable_index();
+
+    // Rebuilds the index for base pairs [0, num_bps) given the nucleosomes,
+    // each of which wraps the bpPerNucleosome base pairs before its
+    // location as well as the location itself when attached.  With
+    // regions, each base pair is weighted by its accessibility, and with a
+    // bias by its sequence weight as well.  The bias must outlive the
+    // index.
+    void build(const nucleosome_array &nucleosomes, int64_t num_bps,
+               const region_track *regions = NULL, const sequence_bias *bias = NULL);
+
+    // Total number of cuttable base pairs, or their total weight when
+    // built with regions or a bias.  Offsets below are in the same units.
+    int64_t totalCuttable(void) const { return d_cumulative.back(); }
+
+    // Returns the base-pair location of cuttable base pair number offset,
+    // which must be in [0, totalCuttable()).
+    int64_t location(int64_t offset) const;
+
+    // Same as above, but searches forward from the specified interval and
+    // updates it to the one holding the offset.  When offsets are looked up
+    // in increasing order starting from interval 0, this takes constant
+    // amortized time per lookup.
+    int64_t location(int64_t offset, size_t &interval) const;
+
+    // Returns the location of a cuttable base pair chosen uniformly using
+    // the specified value in [0, 1).
+    int64_t sample(double u) const;
+
+    // Number of cuttable intervals.
+    size_t intervalCount(void) const { return d_starts.size(); }
+
+    // Bytes used by the index.
+    size_t memoryUsage(void) const;
+
+private:
+    // Weight of the base pairs from where a lookup was made up to where
+    // the region holding them changes, kept while intervals are added in
+    // order so that most of them need no lookup.
+    class span_weight {
+    public:
+        span_weight(const region_track *track) : regions(track), weight(0), change(0) {}
+
+        region_track::cursor    regions;
+        uint32_t                weight;
+        int64_t                 change;
+    };
+
+    // Adds the interval [start, end), split where the region holding it
+    // changes when there are regions.
+    void addInterval(int64_t start, int64_t end, span_weight *span);
+
+    // Adds [start, end) as one interval, each of whose base pairs has the
+    // specified accessibility weight, or NULL without regions.
+    void addPiece(int64_t start, int64_t end, const uint32_t *weight);
+
+    // Location of offset, which is within interval.
+    int64_t locationIn(size_t interval, int64_t offset) const;
+
+    std::vector<int64_t>    d_starts;       // First base pair of each interval
+    std::vector<int64_t>    d_cumulative;   // Cuttable base pairs before each interval, plus the total
+    std::vector<uint32_t>   d_weights;      // Weight of each base pair of each interval, if any
+    const sequence_bias     *d_bias;        // Sequence weights, or NULL
+    std::vector<uint64_t>   d_biasStarts;   // Sequence weight before each interval, with a bias
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include <algorithm>
+
+#include "density_pyramid.h"
+#include "chromatin_model.h"
+#include "profiler.h"
+
+density_pyramid::density_pyramid()
+    : d_strandLength(0)
+{
+}
+
+int64_t density_pyramid::bucketWidth(int level) const
+{
+    int64_t width = BASE_BUCKET_BP;
+    int i;
+    for (i = 0; i < level; i++) {
+        width *= BRANCHING;
+    }
+    return width;
+}
+
+int density_pyramid::levelFor(double bp_per_pixel) const
+{
+    int level = 0;
+    while ( (level + 1 < levelCount()) && (bucketWidth(level + 1) <= bp_per_pixel) ) {
+        level++;
+    }
+    return level;
+}
+
+density_pyramid::bucket *density_pyramid::startLevel(size_t level, size_t count)
+{
+    if (level == d_levels.size()) {
+        d_levels.push_back(column<bucket>());
+    }
+    column<bucket> &buckets = d_levels[level];
+    buckets.clear();
+    buckets.resize(count);
+    return buckets.edit();
+}
+
+void density_pyramid::build(const chromatin_model &model)
+{
+    scoped_timer timer(PHASE_SUMMARY);
+    const nucleosome_array &nucleosomes = model.nucleosomes();
+    const cut_array &cutLocations = model.cutLocations();
+    const size_t num_cuts = cutLocations.size();
+    const int bpPerNucleosome = model.parameters().bpPerNucleosome;
+
+    d_maxCuts.clear();
+    d_strandLength = nucleosomes.size() > 0 ? model.strandLocation(nucleosomes.size() - 1) + 1 : 1;
+    size_t num_levels = 1;
+    bucket *base = startLevel(0, static_cast<size_t>((d_strandLength + BASE_BUCKET_BP - 1) / BASE_BUCKET_BP));
+
+    // Walk the nucleosomes and cuts together, placing each the same way
+    // the display does: a cut in a linker at its offset along it and one
+    // within a nucleosome's DNA at the nucleosome.
+    int64_t last_bp = 0;        // Location of the previous nucleosome
+    int64_t last_sl = 0;        // Its position along the strand
+    size_t next_cut_index = 0;
+    nucleosome_array::cursor n(nucleosomes);
+    for (; !n.done(); n.next()) {
+        int64_t new_sl = last_sl + (n.location() - last_bp) - bpPerNucleosome;
+        bucket &b = base[static_cast<size_t>(std::max(static_cast<int64_t>(0), new_sl) / BASE_BUCKET_BP)];
+        if (n.attached()) { b.attached++; }
+        else { b.detached++; }
+
+        while ( (next_cut_index < num_cuts) && (cutLocations[next_cut_index] <= n.location()) ) {
+            int64_t cut = cutLocations[next_cut_index];
+            int64_t cut_sl = new_sl;
+            if (n.location() - bpPerNucleosome > cut) {
+                cut_sl = last_sl + (cut - last_bp);
+            }
+            base[static_cast<size_t>(std::max(static_cast<int64_t>(0), cut_sl) / BASE_BUCKET_BP)].cuts++;
+            next_cut_index++;
+        }
+
+        last_bp = n.location();
+        last_sl = new_sl;
+    }
+
+    // Merge each level into the next coarser one until a single bucket
+    // covers the whole strand.
+    while (true) {
+        const size_t fine_size = d_levels[num_levels - 1].size();
+        uint32_t most = 0;
+        size_t i;
+        for (i = 0; i < fine_size; i++) {
+            most = std::max(most, d_levels[num_levels - 1][i].cuts);
+        }
+        d_maxCuts.push_back(most);
+        if (fine_size <= 1) {
+            break;
+        }
+
+        bucket *coarse = startLevel(num_levels, (fine_size + BRANCHING - 1) / BRANCHING);
+        const column<bucket> &fine = d_levels[num_levels - 1];
+        for (i = 0; i < fine_size; i++) {
+            bucket &c = coarse[i / BRANCHING];
+            c.attached += fine[i].attached;
+            c.detached += fine[i].detached;
+            c.cuts += fine[i].cuts;
+        }
+        num_levels++;
+    }
+    d_levels.resize(num_levels);
+}
+
+bool density_pyramid::assign(int64_t strandLength, const std::vector< column<bucket> > &levels,
+                             const std::vector<uint32_t> &maxCuts)
+{
+    d_levels.clear();
+    d_maxCuts.clear();
+    d_strandLength = 0;
+
+    // Each level must have as many buckets as build() would make.
+    size_t expected = static_cast<size_t>((strandLength + BASE_BUCKET_BP - 1) / BASE_BUCKET_BP);
+    size_t i;
+    for (i = 0; i < levels.size(); i++) {
+        if (levels[i].size() != expected) {
+            return false;
+        }
+        expected = (expected + BRANCHING - 1) / BRANCHING;
+    }
+    if ( levels.empty() || (levels.back().size() > 1) || (maxCuts.size() != levels.size()) ) {
+        return false;
+    }
+    d_levels = levels;
+    d_maxCuts = maxCuts;
+    d_strandLength = strandLength;
+    return true;
+}
+
+size_t density_pyramid::memoryUsage(void) const
+{
+    size_t bytes = d_maxCuts.capacity() * sizeof(uint32_t);
+    size_t i;
+    for (i = 0; i < d_levels.size(); i++) {
+        bytes += d_levels[i].capacity() * sizeof(bucket);
+    }
+    return bytes;
+}
@@ -0,0 +1,82 @@
+// Multi-resolution summary of a chromatin model along its drawn strand.
+//
+// The strand is laid out as the display draws it (see
+// chromatin_model::strandLocation) and split into buckets of
+// BASE_BUCKET_BP base pairs, each counting the attached and detached
+// nucleosomes and the cuts that fall in it.  Each coarser level merges
+// BRANCHING buckets of the one below, so a view of any width can be drawn
+// from the level whose buckets are about a pixel wide, in time that
+// depends on the size of the window rather than of the model.  The levels
+// are columns, so a summary saved in a run file can be read in place.
+
+#ifndef _DENSITY_PYRAMID_H_
+#define _DENSITY_PYRAMID_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "column.h"
+
+class chromatin_model;
+
+class density_pyramid {
+public:
+    enum { BASE_BUCKET_BP = 256 };      // Width of the finest buckets
+    enum { BRANCHING = 4 };             // Buckets merged into each coarser one
+
+    class bucket {
+    public:
+        bucket() : attached(0), detached(0), cuts(0) {}
+
+        uint32_t attached;      // Nucleosomes with their histone
+        uint32_t detached;      // Nucleosomes without
+        uint32_t cuts;
+    };
+
+    density_pyramid();
+
+    // Summarizes the specified model, replacing any previous summary.  The
+    // levels are refilled in place, so rebuilding a summary reuses its
+    // storage.
+    void build(const chromatin_model &model);
+
+    // Replaces the summary with stored levels and their most cuts, such as
+    // columns viewing a run file.  Returns false, leaving the summary
+    // empty, if the sizes of the levels do not fit the strand length.
+    bool assign(int64_t strandLength, const std::vector< column<bucket> > &levels,
+                const std::vector<uint32_t> &maxCuts);
+
+    const column<bucket> &levelColumn(int level) const { return d_levels[level]; }
+    const std::vector<uint32_t> &maxCutsByLevel(void) const { return d_maxCuts; }
+
+    // Levels run from 0, the finest, to levelCount() - 1, which has a
+    // single bucket.
+    int levelCount(void) const { return static_cast<int>(d_levels.size()); }
+    int64_t bucketWidth(int level) const;
+    size_t bucketCount(int level) const { return d_levels[level].size(); }
+    const bucket &at(int level, size_t i) const { return d_levels[level][i]; }
+
+    // Most cuts in any bucket of the level, for scaling a display.
+    uint32_t maxCuts(int level) const { return d_maxCuts[level]; }
+
+    // Returns the coarsest level whose buckets are no wider than the
+    // specified number of base pairs, or 0 if even those are wider.
+    int levelFor(double bp_per_pixel) const;
+
+    // Length of the drawn strand, in base pairs.
+    int64_t strandLength(void) const { return d_strandLength; }
+
+    // Bytes used to store the summary.
+    size_t memoryUsage(void) const;
+
+private:
+    // Empties the specified level, adding it if needed, and returns count
+    // zeroed buckets for it.
+    bucket *startLevel(size_t level, size_t count);
+
+    std::vector< column<bucket> >       d_levels;
+    std::vector<uint32_t>               d_maxCuts;
+    int64_t                             d_strandLength;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <functional>
+
+#include "digestion_course.h"
+#include "radix_sort.h"
+#include "replicate_runner.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+digestion_course::digestion_course()
+    : d_remaining(0)
+{
+}
+
+// Number of bits needed to hold values up to the specified one.
+static int bits_for(uint64_t value)
+{
+    int bits = 0;
+    while ( (bits < 64) && ((value >> bits) != 0) ) {
+        bits++;
+    }
+    return bits;
+}
+
+void digestion_course::reset(const std::vector<int64_t> &cuts)
+{
+    scoped_timer timer(PHASE_SORT);
+    d_nodes.clear();
+    d_nodes.reserve(cuts.size() + 1);
+    d_ranks.resize(cuts.size());
+
+    // Every fragment list starts at 0, so it is always a location.
+    node first;
+    first.location = 0;
+    d_nodes.push_back(first);
+
+    // Sort the cuts with their numbers, so that each can be given its
+    // place among the distinct locations in one pass.  The numbers fit
+    // below the locations in one word unless the strand is enormous.
+    // Only the oldest cut at a location ever bounds a fragment: the others
+    // are taken out while it is still there, and change nothing.
+    const int64_t largest = cuts.empty() ? 0 : *std::max_element(cuts.begin(), cuts.end());
+    const int number_bits = bits_for(cuts.size());
+    size_t i;
+    if (bits_for(largest) + number_bits <= 64) {
+        d_keys.resize(cuts.size());
+        for (i = 0; i < cuts.size(); i++) {
+            d_keys[i] = (static_cast<uint64_t>(cuts[i]) << number_bits) | i;
+        }
+        radix_sort(d_keys.empty() ? NULL : &d_keys[0], d_keys.size());
+        const uint64_t number_mask = (number_bits == 64) ? ~0ULL : ((1ULL << number_bits) - 1);
+        for (i = 0; i < d_keys.size(); i++) {
+            addCut(static_cast<int64_t>(d_keys[i] >> number_bits), d_keys[i] & number_mask);
+        }
+    } else {
+        std::vector< std::pair<int64_t, uint32_t> > sorted(cuts.size());
+        for (i = 0; i < cuts.size(); i++) {
+            sorted[i] = std::make_pair(cuts[i], static_cast<uint32_t>(i));
+        }
+        std::sort(sorted.begin(), sorted.end());
+        for (i = 0; i < sorted.size(); i++) {
+            addCut(sorted[i].first, sorted[i].second);
+        }
+    }
+
+    const size_t num_nodes = d_nodes.size();
+    for (i = 0; i < num_nodes; i++) {
+        d_nodes[i].previous = static_cast<uint32_t>(i) - 1;
+        d_nodes[i].next = (i + 1 < num_nodes) ? static_cast<uint32_t>(i + 1) : NO_LINK;
+    }
+    d_remaining = cuts.size();
+}
+
+void digestion_course::addCut(int64_t location, uint64_t number)
+{
+    if (location == d_nodes.back().location) {
+        d_ranks[number] = NO_LINK;
+    } else {
+        node n;
+        n.location = location;
+        d_ranks[number] = static_cast<uint32_t>(d_nodes.size());
+        d_nodes.push_back(n);
+    }
+}
+
+void digestion_course::addFragmentLengths(fragment_accumulator &lengths) const
+{
+    scoped_timer timer(PHASE_FRAGMENTS);
+    uint32_t at = 0;
+    while (d_nodes[at].next != NO_LINK) {
+        lengths.addFragment(d_nodes[d_nodes[at].next].location - d_nodes[at].location);
+        at = d_nodes[at].next;
+    }
+}
+
+void digestion_course::removeNewest(size_t count, fragment_histogram &histogram)
+{
+    scoped_timer timer(PHASE_FRAGMENTS);
+    if ( d_shortBins.empty() || (histogram.layout() != d_layout) ) {
+        d_layout = histogram.layout();
+        d_shortBins.resize(SHORT_LENGTHS);
+        int length;
+        for (length = 0; length < SHORT_LENGTHS; length++) {
+            d_shortBins[length] = d_layout.binFor(length);
+        }
+    }
+    while (d_remaining > count) {
+        d_remaining--;
+        uint32_t at = d_ranks[d_remaining];
+        if (at == NO_LINK) {
+            continue;           // An older cut is still there
+        }
+
+        // The fragments on either side become one.  There is always one
+        // before, since 0 is never taken out, but the last cut has none
+        // after it.
+        node &taken = d_nodes[at];
+        node &before = d_nodes[taken.previous];
+        int64_t left = taken.location - before.location;
+        if (taken.next != NO_LINK) {
+            node &after = d_nodes[taken.next];
+            int64_t right = after.location - taken.location;
+            histogram.addToBin(binFor(left), -1);
+            histogram.addToBin(binFor(right), -1);
+            histogram.addToBin(binFor(left + right), 1);
+            after.previous = taken.previous;
+        } else {
+            histogram.addToBin(binFor(left), -1);
+        }
+        before.next = taken.next;
+    }
+}
+
+size_t digestion_course::memoryUsage(void) const
+{
+    return d_keys.capacity() * sizeof(uint64_t) + d_ranks.capacity() * sizeof(uint32_t)
+         + d_nodes.capacity() * sizeof(node) + d_shortBins.capacity() * sizeof(int);
+}
+
+//----------------------------------------------------------------------
+
+bool run_digestion(const chromatin_parameters &params, uint64_t seed,
+                   const std::vector<double> &cutsPer3kBasePairs,
+                   int num_replicates, int num_threads, const histogram_layout &layout,
+                   std::vector<fragment_histogram> &histograms)
+{
+    const size_t num_points = cutsPer3kBasePairs.size();
+    histograms.assign(num_points, fragment_histogram(layout));
+    if (num_points == 0) {
+        return true;
+    }
+
+    // Each replicate fills its own histograms, which are added up in
+    // order at the end.  The replicates share their models, so each thread
+    // sizes one only once.
+    std::vector< std::vector<fragment_histogram> > partial(num_replicates);
+    std::vector<char> cuttable(num_replicates, 1);
+    model_pool models;
+    std::function<void(int)> replicate = [&](int r) {
+        chromatin_model *model = models.borrow();
+        partial[r].assign(num_points, fragment_histogram(layout));
+        if (!model->digest(params, seed + r, cutsPer3kBasePairs, partial[r])) {
+            cuttable[r] = 0;
+        }
+        models.giveBack(model);
+    };
+    run_work_stealing(num_replicates, num_threads, replicate);
+
+    bool ok = true;
+    int r;
+    for (r = 0; r < num_replicates; r++) {
+        size_t p;
+        for (p = 0; p < num_points; p++) {
+            histograms[p].merge(partial[r][p]);
+        }
+        ok = ok && (cuttable[r] != 0);
+    }
+    return ok;
+}
@@ -0,0 +1,94 @@
+// Digestion over time.  An experiment that stops the enzyme at a series
+// of time points sees the fragments of an ever denser set of cuts, and
+// the model makes the same series: cut i always comes from uniform i of
+// the cut stream (see chromatin_model::updateIncremental), so the cuts at
+// each time point are the first ones drawn for the next, and every cut
+// added in between splits one fragment in two.
+//
+// A course therefore draws the cuts for the last time point once, sorts
+// them once, and links their distinct locations into a list.  Walking the
+// time points backward, the newest cuts are taken out again one at a
+// time; taking one out joins the two fragments beside it, the reverse of
+// the split that adding it made, so only those fragments' bins change and
+// each step takes constant time.  The whole series of histograms costs
+// about as much as the last time point alone.
+
+#ifndef _DIGESTION_COURSE_H_
+#define _DIGESTION_COURSE_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "chromatin_model.h"
+
+class digestion_course {
+public:
+    digestion_course();
+
+    // Sorts and links the cuts, which must be in the order they were made.
+    void reset(const std::vector<int64_t> &cuts);
+
+    // Number of cuts still in.
+    size_t cutCount(void) const { return d_remaining; }
+
+    // Adds the lengths of the fragments between the cuts still in, the
+    // same as chromatin_model::addFragmentLengths would for them.
+    void addFragmentLengths(fragment_accumulator &lengths) const;
+
+    // Takes out the newest cuts until count remain.  The histogram, which
+    // must hold the fragments of the cuts before, is kept up to date.
+    void removeNewest(size_t count, fragment_histogram &histogram);
+
+    // Bytes used, all of which is kept for the next reset.
+    size_t memoryUsage(void) const;
+
+private:
+    enum { NO_LINK = 0xFFFFFFFFu };
+    enum { SHORT_LENGTHS = 4096 };  // Fragment lengths whose bins are looked up in a table
+
+    // Bin of a fragment of the specified length in d_layout.
+    int binFor(int64_t length) const {
+        return (length < SHORT_LENGTHS) ? d_shortBins[length]
+                                        : d_layout.binFor(static_cast<double>(length));
+    }
+
+    // A distinct cut location and its neighbors among those still cut,
+    // together so that taking a cut out touches as little memory as it can.
+    class node {
+    public:
+        int64_t     location;
+        uint32_t    previous;
+        uint32_t    next;
+    };
+
+    // Gives cut number, the next in order of location and then of number,
+    // its node, or NO_LINK if an older cut already has its location.
+    void addCut(int64_t location, uint64_t number);
+
+    std::vector<uint64_t>   d_keys;         // Cuts and their numbers, being sorted
+    std::vector<uint32_t>   d_ranks;        // Node of each cut, in the order made
+    std::vector<node>       d_nodes;        // 0, then each distinct cut location in order
+    size_t                  d_remaining;
+
+    // The bins of short fragments, which are most of them, are kept in a
+    // table small enough to stay in the cache while the nodes are visited
+    // all over memory.
+    histogram_layout        d_layout;
+    std::vector<int>        d_shortBins;
+};
+
+// Runs num_replicates digestions over time with the specified parameters,
+// except that the cut density is taken from each entry of cutsPer3kBasePairs
+// in turn, which must not decrease.  histograms is given one histogram per
+// density, binned with the specified layout, holding the fragments of all
+// the replicates at that density.  Replicate r builds its model with seed
+// + r, so the first gives the same fragments as updateIncremental with the
+// seed and each density.  A num_threads of 0 or less uses all cores, and
+// the result is the same for any number of them.  Returns false if the
+// models had cuts to place but no cuttable DNA.
+bool run_digestion(const chromatin_parameters &params, uint64_t seed,
+                   const std::vector<double> &cutsPer3kBasePairs,
+                   int num_replicates, int num_threads, const histogram_layout &layout,
+                   std::vector<fragment_histogram> &histograms);
+
+#endif
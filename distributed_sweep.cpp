@@ -0,0 +1,793 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <deque>
+#include <memory>
+
+#include "distributed_sweep.h"
+#include "replicate_runner.h"
+#include "result_cache.h"
+
+#ifdef _WIN32
+typedef SOCKET socket_handle;
+typedef intptr_t process_handle;
+static const socket_handle NO_SOCKET = INVALID_SOCKET;
+static const int SEND_FLAGS = 0;
+#define poll WSAPoll
+#define close_socket closesocket
+#else
+typedef int socket_handle;
+typedef pid_t process_handle;
+static const socket_handle NO_SOCKET = -1;
+static const int SEND_FLAGS = MSG_NOSIGNAL;     // A closed peer is an error, not a signal
+#define close_socket close
+#endif
+
+static const int POLL_MSEC = 200;               // Longest wait before checking on the workers
+static const int CONNECT_ATTEMPTS = 30;         // A worker may start before its coordinator
+static const int CONNECT_RETRY_MSEC = 1000;
+
+// Starts the sockets library, once, where it needs starting.
+static bool start_sockets(void)
+{
+#ifdef _WIN32
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        started = (WSAStartup(MAKEWORD(2, 2), &data) == 0);
+    }
+    return started;
+#else
+    return true;
+#endif
+}
+
+// Sends all of text.  Returns false if the connection has failed.
+static bool send_text(socket_handle s, const std::string &text)
+{
+    size_t sent = 0;
+    while (sent < text.size()) {
+        int n = send(s, text.data() + sent, static_cast<int>(text.size() - sent), SEND_FLAGS);
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// Reads what has arrived into buffer.  Returns false if the connection
+// has closed or failed.
+static bool receive_text(socket_handle s, std::string &buffer)
+{
+    char chunk[65536];
+    int n = recv(s, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+        return false;
+    }
+    buffer.append(chunk, n);
+    return true;
+}
+
+// Takes the first whole line out of buffer into line, without its end.
+// Returns false if no whole line has arrived yet.
+static bool take_line(std::string &buffer, std::string &line)
+{
+    size_t end = buffer.find('\n');
+    if (end == std::string::npos) {
+        return false;
+    }
+    line.assign(buffer, 0, end);
+    buffer.erase(0, end + 1);
+    return true;
+}
+
+// Appends a double that reads back exactly.
+static void append_double(std::string &text, double value)
+{
+    char number[32];
+    sprintf(number, " %.17g", value);
+    text += number;
+}
+
+static void append_integer(std::string &text, unsigned long long value)
+{
+    char number[32];
+    sprintf(number, " %llu", value);
+    text += number;
+}
+
+// Parses the next number of a line, moving p past it.
+static bool parse_integer(const char *&p, unsigned long long &value)
+{
+    char *end;
+    value = strtoull(p, &end, 10);
+    if (end == p) {
+        return false;
+    }
+    p = end;
+    return true;
+}
+
+static bool parse_double(const char *&p, double &value)
+{
+    char *end;
+    value = strtod(p, &end);
+    if (end == p) {
+        return false;
+    }
+    p = end;
+    return true;
+}
+
+// Starts a worker process that connects back to the coordinator at the
+// specified address.
+static bool start_worker(const distributed_options &options, const char *host, int port,
+                         process_handle &process)
+{
+    char port_text[64], threads_text[16];
+    sprintf(port_text, "%s:%d", host, port);
+    sprintf(threads_text, "%d", options.worker_threads);
+    std::vector<const char *> args;
+    args.push_back(options.worker_program.c_str());
+    args.push_back("--mode");
+    args.push_back("worker");
+    args.push_back("--connect");
+    args.push_back(port_text);
+    args.push_back("--threads");
+    args.push_back(threads_text);
+    if (!options.token.empty()) {
+        args.push_back("--token");
+        args.push_back(options.token.c_str());
+    }
+    args.push_back(NULL);
+#ifdef _WIN32
+    process = _spawnv(_P_NOWAIT, args[0], &args[0]);
+    return process != -1;
+#else
+    process = fork();
+    if (process == 0) {
+        execvp(args[0], const_cast<char *const *>(&args[0]));
+        _exit(127);
+    }
+    return process > 0;
+#endif
+}
+
+// Returns true if the worker process has exited, waiting for it if asked.
+static bool worker_exited(process_handle process, bool wait)
+{
+#ifdef _WIN32
+    HANDLE h = reinterpret_cast<HANDLE>(process);
+    if (WaitForSingleObject(h, wait ? INFINITE : 0) != WAIT_OBJECT_0) {
+        return false;
+    }
+    CloseHandle(h);
+    return true;
+#else
+    int status;
+    return waitpid(process, &status, wait ? 0 : WNOHANG) == process;
+#endif
+}
+
+//----------------------------------------------------------------------
+// Coordinator
+
+distributed_options::distributed_options()
+    : local_workers(0)
+    , worker_threads(1)
+    , port(0)
+    , bind_address("127.0.0.1")
+    , unit_replicates(1)
+    , max_attempts(3)
+    , unit_timeout(0)
+{
+}
+
+// Some of the replicates of one point.
+class work_unit {
+public:
+    work_unit(int p, int f, int l) : point(p), first(f), last(l), attempts(0) {}
+
+    int point;
+    int first;
+    int last;
+    int attempts;   // Times it has been handed out
+};
+
+// A connected worker.
+class worker_link {
+public:
+    worker_link(socket_handle s) : socket(s), greeted(false), ready(false), unit(-1) {}
+
+    socket_handle   socket;
+    std::string     input;      // Received but not yet handled
+    bool            greeted;    // Has it said hello and been sent the job?
+    bool            ready;      // Has it taken the job on and asked for units?
+    int             unit;       // Unit it is running, or -1
+    std::chrono::steady_clock::time_point started;
+};
+
+// The state of a distributed sweep while it runs.
+class coordinator {
+public:
+    coordinator(const std::vector<chromatin_parameters> &p, uint64_t s, const histogram_layout &l,
+                const distributed_options &o, std::vector<sweep_result> &r)
+        : points(p), seed(s), layout(l), options(o), results(r), remaining(0), failed(false) {}
+
+    // The lines every worker is sent after it says hello.
+    std::string jobText(void) const;
+
+    // Hands the next waiting unit, if any, to an idle worker.  Returns
+    // false if the worker could not be sent it.
+    bool assign(worker_link &worker);
+
+    // Puts a unit back to be tried again, or fails the sweep if it has
+    // been tried too often.
+    void retry(int unit, const char *why);
+
+    // Handles one line from a worker.  Returns false if the worker should
+    // be dropped.
+    bool handle(worker_link &worker, const std::string &line);
+
+    const std::vector<chromatin_parameters> &points;
+    uint64_t                    seed;
+    const histogram_layout      &layout;
+    const distributed_options   &options;
+    std::vector<sweep_result>   &results;
+    std::vector<work_unit>      units;
+    std::deque<int>             waiting;    // Units to hand out, in order
+    size_t                      remaining;  // Units not yet finished
+    bool                        failed;
+};
+
+std::string coordinator::jobText(void) const
+{
+    std::string text = "job";
+    append_integer(text, seed);
+    append_integer(text, static_cast<unsigned long long>(layout.kind()));
+    const std::vector<double> &edges = layout.edges();
+    append_integer(text, edges.size());
+    size_t i;
+    for (i = 0; i < edges.size(); i++) {
+        append_double(text, edges[i]);
+    }
+    text += "\n";
+
+    // The grid only varies the numbers, so every point shares the files.
+    char line[64];
+    const chromatin_parameters &params = points[0];
+    if (params.regions) {
+        sprintf(line, "regions %016llx ", static_cast<unsigned long long>(params.regions->fingerprint()));
+        text += line + params.regions->filename() + "\n";
+    }
+    if (params.bias) {
+        sprintf(line, "bias %016llx ", static_cast<unsigned long long>(params.bias->fingerprint()));
+        text += line + params.bias->filename() + "\n";
+    }
+    text += "end\n";
+    return text;
+}
+
+bool coordinator::assign(worker_link &worker)
+{
+    if (waiting.empty() || failed) {
+        return true;
+    }
+    int which = waiting.front();
+    waiting.pop_front();
+    work_unit &u = units[which];
+    const chromatin_parameters &params = points[u.point];
+    std::string text = "unit";
+    append_integer(text, which);
+    append_integer(text, u.first);
+    append_integer(text, u.last);
+    append_integer(text, params.bpPerNucleosome);
+    append_integer(text, params.bpPerLinker);
+    append_integer(text, params.totalNucleosomes);
+    append_double(text, params.missingHistonePercent);
+    append_double(text, params.nucleosomeSpacingVariance);
+    append_double(text, params.cutsPer3kBasePairs);
+    text += "\n";
+    u.attempts++;
+    worker.unit = which;
+    worker.started = std::chrono::steady_clock::now();
+    return send_text(worker.socket, text);
+}
+
+void coordinator::retry(int unit, const char *why)
+{
+    const work_unit &u = units[unit];
+    fprintf(stderr, "Replicates %d to %d of point %d %s (attempt %d of %d)\n",
+            u.first, u.last - 1, u.point + 1, why, u.attempts, options.max_attempts);
+    if (u.attempts >= options.max_attempts) {
+        failed = true;
+    } else {
+        waiting.push_back(unit);
+    }
+}
+
+bool coordinator::handle(worker_link &worker, const std::string &line)
+{
+    const char *p = line.c_str();
+    unsigned long long value;
+    if (strncmp(p, "hello ", 6) == 0) {
+        p += 6;
+        if ( !parse_integer(p, value) || (value != CHROMATIN_ENGINE_VERSION) ) {
+            fprintf(stderr, "Dropping a worker of another engine version\n");
+            return false;
+        }
+        while (*p == ' ') { p++; }
+        if (options.token != p) {
+            fprintf(stderr, "Dropping a worker that did not give the token\n");
+            return false;
+        }
+        worker.greeted = true;
+        return send_text(worker.socket, jobText());
+    }
+
+    // A worker that cannot take the job on, such as one whose host has no
+    // copy of its files, is dropped before it is handed a unit, so it uses
+    // up none of their attempts.
+    if (line == "ready") {
+        if (!worker.greeted || worker.ready) {
+            return false;
+        }
+        worker.ready = true;
+        return assign(worker);
+    }
+    if (line == "unready") {
+        fprintf(stderr, "Dropping a worker that cannot take on the job\n");
+        return false;
+    }
+
+    // Anything else must be the answer for the worker's unit.
+    unsigned long long which;
+    if (!worker.ready || (worker.unit < 0)) {
+        return false;
+    }
+    if (strncmp(p, "failed ", 7) == 0) {
+        p += 7;
+        if (!parse_integer(p, which) || (which != static_cast<unsigned long long>(worker.unit))) {
+            return false;
+        }
+        retry(worker.unit, "failed");
+        worker.unit = -1;
+        return assign(worker);
+    }
+    if (strncmp(p, "result ", 7) != 0) {
+        return false;
+    }
+    p += 7;
+    unsigned long long cuttable, underflow, overflow, bins;
+    if ( !parse_integer(p, which) || (which != static_cast<unsigned long long>(worker.unit))
+         || !parse_integer(p, cuttable) || !parse_integer(p, underflow)
+         || !parse_integer(p, overflow) || !parse_integer(p, bins)
+         || (bins != static_cast<unsigned long long>(layout.binCount())) ) {
+        return false;
+    }
+    std::vector<uint64_t> counts(static_cast<size_t>(bins));
+    size_t i;
+    for (i = 0; i < counts.size(); i++) {
+        if (!parse_integer(p, value)) {
+            return false;
+        }
+        counts[i] = value;
+    }
+    fragment_histogram unit_histogram(layout);
+    unit_histogram.setCounts(counts, underflow, overflow);
+    sweep_result &result = results[units[worker.unit].point];
+    result.histogram.merge(unit_histogram);
+    result.cuttable = result.cuttable && (cuttable != 0);
+    remaining--;
+    worker.unit = -1;
+    return assign(worker);
+}
+
+bool run_distributed_sweep(const std::vector<chromatin_parameters> &points, uint64_t seed,
+                           int num_replicates, const histogram_layout &layout,
+                           const result_cache *cache, const distributed_options &options,
+                           std::vector<sweep_result> &results)
+{
+    // Points already in the cache are taken from it; the rest are split
+    // into units.
+    results.assign(points.size(), sweep_result());
+    coordinator c(points, seed, layout, options, results);
+    std::vector<std::string> keys(points.size());
+    size_t i;
+    for (i = 0; i < points.size(); i++) {
+        sweep_result &result = results[i];
+        result.params = points[i];
+        result.histogram.reset(layout);
+        if (cache) {
+            keys[i] = result_cache::key(points[i], seed, num_replicates, layout);
+            if (cache->lookup(keys[i], result.histogram, result.cuttable)) {
+                result.cached = true;
+                continue;
+            }
+        }
+        int first;
+        for (first = 0; first < num_replicates; first += options.unit_replicates) {
+            c.waiting.push_back(static_cast<int>(c.units.size()));
+            c.units.push_back(work_unit(static_cast<int>(i), first,
+                                        std::min(first + options.unit_replicates, num_replicates)));
+        }
+    }
+    c.remaining = c.units.size();
+    if (c.remaining == 0) {
+        return true;
+    }
+
+    // Take workers on this machine only, unless a port was given for
+    // others to connect to.  Then they are taken on the address given,
+    // which must be a loopback one unless there is a token for them to
+    // prove they belong to the sweep.
+    if (options.token.find_first_of(" \t\r\n") != std::string::npos) {
+        fprintf(stderr, "The token cannot hold spaces\n");
+        return false;
+    }
+    if (!start_sockets()) {
+        fprintf(stderr, "Cannot start the sockets library\n");
+        return false;
+    }
+    in_addr bind_to;
+    bind_to.s_addr = htonl(INADDR_LOOPBACK);
+    if (options.port != 0) {
+        if (inet_pton(AF_INET, options.bind_address.c_str(), &bind_to) != 1) {
+            fprintf(stderr, "Cannot take workers on %s, which is not an IPv4 address\n",
+                    options.bind_address.c_str());
+            return false;
+        }
+        if ( ((ntohl(bind_to.s_addr) >> 24) != 127) && options.token.empty() ) {
+            fprintf(stderr, "Taking workers on %s needs a token for them to give\n",
+                    options.bind_address.c_str());
+            return false;
+        }
+    }
+    socket_handle listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == NO_SOCKET) {
+        fprintf(stderr, "Cannot make a socket to take workers on\n");
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(options.port));
+    address.sin_addr = bind_to;
+    socklen_t address_size = sizeof(address);
+    if ( (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+         || (listen(listener, SOMAXCONN) != 0)
+         || (getsockname(listener, reinterpret_cast<sockaddr *>(&address), &address_size) != 0) ) {
+        fprintf(stderr, "Cannot take workers on port %d of %s\n", options.port,
+                options.bind_address.c_str());
+        close_socket(listener);
+        return false;
+    }
+    const int port = ntohs(address.sin_port);
+    if (options.port != 0) {
+        fprintf(stderr, "Taking workers on port %d of %s\n", port, options.bind_address.c_str());
+    }
+
+    // Local workers reach any address through the loopback one.
+    char host[INET_ADDRSTRLEN] = "127.0.0.1";
+    if (bind_to.s_addr != htonl(INADDR_ANY)) {
+        inet_ntop(AF_INET, &bind_to, host, sizeof(host));
+    }
+    std::vector<process_handle> processes;
+    int w;
+    for (w = 0; w < options.local_workers; w++) {
+        process_handle process;
+        if (!start_worker(options, host, port, process)) {
+            fprintf(stderr, "Cannot start a worker from %s\n", options.worker_program.c_str());
+            break;
+        }
+        processes.push_back(process);
+    }
+    size_t running = processes.size();
+
+    // Hand out units and gather results until every unit is done, one has
+    // failed too often, or there is no worker left to run them.
+    std::vector< std::unique_ptr<worker_link> > workers;
+    while ( (c.remaining > 0) && !c.failed ) {
+        std::vector<pollfd> polled(workers.size() + 1);
+        polled[0].fd = listener;
+        polled[0].events = POLLIN;
+        for (i = 0; i < workers.size(); i++) {
+            polled[i + 1].fd = workers[i]->socket;
+            polled[i + 1].events = POLLIN;
+        }
+        poll(&polled[0], static_cast<unsigned long>(polled.size()), POLL_MSEC);
+
+        if (polled[0].revents & POLLIN) {
+            socket_handle s = accept(listener, NULL, NULL);
+            if (s != NO_SOCKET) {
+                int on = 1;
+                setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&on), sizeof(on));
+                workers.push_back(std::unique_ptr<worker_link>(new worker_link(s)));
+            }
+        }
+
+        // Handle what each worker has said, dropping any whose connection
+        // has failed, that have said something wrong or whose unit is
+        // taking too long.
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (i = 0; i < polled.size() - 1; i++) {
+            worker_link &worker = *workers[i];
+            bool keep = true;
+            if (polled[i + 1].revents & (POLLIN | POLLERR | POLLHUP)) {
+                keep = receive_text(worker.socket, worker.input);
+                std::string line;
+                while ( keep && take_line(worker.input, line) ) {
+                    keep = c.handle(worker, line);
+                }
+            }
+            if ( keep && (worker.unit >= 0) && (options.unit_timeout > 0)
+                 && (std::chrono::duration<double>(now - worker.started).count() > options.unit_timeout) ) {
+                c.retry(worker.unit, "took too long");
+                worker.unit = -1;
+                keep = false;
+            }
+            if (!keep) {
+                if (worker.unit >= 0) {
+                    c.retry(worker.unit, "lost its worker");
+                    worker.unit = -1;
+                }
+                close_socket(worker.socket);
+                worker.socket = NO_SOCKET;
+            }
+        }
+        for (i = workers.size(); i-- > 0; ) {
+            if (workers[i]->socket == NO_SOCKET) {
+                workers.erase(workers.begin() + i);
+            }
+        }
+
+        // Units put back are handed to workers left idle.
+        for (i = 0; i < workers.size(); i++) {
+            if ( workers[i]->ready && (workers[i]->unit < 0) && !c.waiting.empty()
+                 && !c.assign(*workers[i]) ) {
+                c.retry(workers[i]->unit, "lost its worker");
+                workers[i]->unit = -1;
+            }
+        }
+
+        // Without a port for others, the local workers are the only ones.
+        for (w = 0; w < static_cast<int>(processes.size()); w++) {
+            if ( (processes[w] != 0) && worker_exited(processes[w], false) ) {
+                processes[w] = 0;
+                running--;
+            }
+        }
+        if ( (options.port == 0) && (running == 0) && workers.empty() ) {
+            fprintf(stderr, "Every worker has stopped\n");
+            c.failed = true;
+        }
+    }
+
+    // Let the workers go.
+    for (i = 0; i < workers.size(); i++) {
+        send_text(workers[i]->socket, "done\n");
+        close_socket(workers[i]->socket);
+    }
+    close_socket(listener);
+    for (w = 0; w < static_cast<int>(processes.size()); w++) {
+        if (processes[w] != 0) {
+            worker_exited(processes[w], true);
+        }
+    }
+    if (c.failed) {
+        return false;
+    }
+
+    if (cache) {
+        for (i = 0; i < points.size(); i++) {
+            if (!results[i].cached) {
+                cache->store(keys[i], results[i].histogram, results[i].cuttable);
+            }
+        }
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------
+// Worker
+
+// What a worker is told once, before its units.
+class worker_job {
+public:
+    worker_job() : seed(0), ready(false) {}
+
+    uint64_t                seed;
+    histogram_layout        layout;
+    chromatin_parameters    base;       // The files, for every unit
+    bool                    ready;      // Was the job read and its files found?
+};
+
+// Reads the job line into job.
+static bool parse_job(const std::string &line, worker_job &job)
+{
+    const char *p = line.c_str() + 3;
+    unsigned long long seed, kind, count;
+    if ( !parse_integer(p, seed) || !parse_integer(p, kind) || (kind > histogram_layout::CUSTOM)
+         || !parse_integer(p, count) || (count < 2) ) {
+        return false;
+    }
+    std::vector<double> edges(static_cast<size_t>(count));
+    size_t i;
+    for (i = 0; i < edges.size(); i++) {
+        if (!parse_double(p, edges[i])) {
+            return false;
+        }
+    }
+    job.seed = seed;
+    job.layout = histogram_layout::withEdges(static_cast<histogram_layout::spacing>(kind), edges);
+    job.base = chromatin_parameters();
+    job.ready = true;
+    return true;
+}
+
+// Opens the region or bias file named on the line, which must have the
+// fingerprint the coordinator's copy has.
+static bool parse_file(const std::string &line, worker_job &job)
+{
+    bool regions = (line.compare(0, 8, "regions ") == 0);
+    size_t start = regions ? 8 : 5;
+    unsigned long long fingerprint;
+    if ( (line.size() < start + 18) || (sscanf(line.c_str() + start, "%llx", &fingerprint) != 1) ) {
+        return false;
+    }
+    std::string filename = line.substr(start + 17);
+    if (regions) {
+        std::shared_ptr<region_track> track(new region_track);
+        if (!track->open(filename.c_str()) || (track->fingerprint() != fingerprint)) {
+            fprintf(stderr, "This host has no copy of the regions in %s\n", filename.c_str());
+            return false;
+        }
+        job.base.regions = track;
+    } else {
+        std::shared_ptr<sequence_bias> bias(new sequence_bias);
+        if (!bias->open(filename.c_str()) || (bias->fingerprint() != fingerprint)) {
+            fprintf(stderr, "This host has no copy of the bias index %s\n", filename.c_str());
+            return false;
+        }
+        job.base.bias = bias;
+    }
+    return true;
+}
+
+// Runs the unit on the line and sends its counts, or says it failed.
+static bool run_unit(socket_handle s, const std::string &line, const worker_job &job,
+                     int num_threads, model_pool &models)
+{
+    const char *p = line.c_str() + 4;
+    unsigned long long which, first, last, nucleosome, linker, nucleosomes;
+    chromatin_parameters params = job.base;
+    if ( !parse_integer(p, which) ) {
+        return false;
+    }
+    bool ok = job.ready && parse_integer(p, first) && parse_integer(p, last) && (first < last)
+              && parse_integer(p, nucleosome) && parse_integer(p, linker)
+              && parse_integer(p, nucleosomes)
+              && parse_double(p, params.missingHistonePercent)
+              && parse_double(p, params.nucleosomeSpacingVariance)
+              && parse_double(p, params.cutsPer3kBasePairs);
+    std::string text;
+    if (ok) {
+        params.bpPerNucleosome = static_cast<int>(nucleosome);
+        params.bpPerLinker = static_cast<int>(linker);
+        params.totalNucleosomes = static_cast<int>(nucleosomes);
+        fragment_histogram histogram(job.layout);
+        bool cuttable = run_replicate_range(params, job.seed, static_cast<int>(first),
+                                            static_cast<int>(last), num_threads, histogram, &models);
+        text = "result";
+        append_integer(text, which);
+        append_integer(text, cuttable ? 1 : 0);
+        append_integer(text, histogram.underflow());
+        append_integer(text, histogram.overflow());
+        append_integer(text, histogram.binCount());
+        int i;
+        for (i = 0; i < histogram.binCount(); i++) {
+            append_integer(text, histogram.counts()[i]);
+        }
+    } else {
+        text = "failed";
+        append_integer(text, which);
+    }
+    text += "\n";
+    return send_text(s, text);
+}
+
+int run_sweep_worker(const char *host, int port, const std::string &token, int num_threads)
+{
+    if (!start_sockets()) {
+        fprintf(stderr, "Cannot start the sockets library\n");
+        return 1;
+    }
+    char port_text[16];
+    sprintf(port_text, "%d", port);
+    addrinfo hints, *found = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port_text, &hints, &found) != 0) {
+        fprintf(stderr, "Cannot find the coordinator host %s\n", host);
+        return 1;
+    }
+
+    // The coordinator may not be taking workers yet.
+    socket_handle s = NO_SOCKET;
+    int attempt;
+    for (attempt = 0; (s == NO_SOCKET) && (attempt < CONNECT_ATTEMPTS); attempt++) {
+        if (attempt > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_RETRY_MSEC));
+        }
+        s = socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+        if ( (s != NO_SOCKET) && (connect(s, found->ai_addr, static_cast<int>(found->ai_addrlen)) != 0) ) {
+            close_socket(s);
+            s = NO_SOCKET;
+        }
+    }
+    freeaddrinfo(found);
+    if (s == NO_SOCKET) {
+        fprintf(stderr, "Cannot connect to the coordinator at %s:%d\n", host, port);
+        return 1;
+    }
+    int on = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&on), sizeof(on));
+
+    char hello[32];
+    sprintf(hello, "hello %d", CHROMATIN_ENGINE_VERSION);
+    bool ok = send_text(s, std::string(hello) + (token.empty() ? "" : " ") + token + "\n");
+    worker_job job;
+    model_pool models;          // Kept from one unit to the next
+    std::string input, line;
+    while (ok) {
+        if (!take_line(input, line)) {
+            ok = receive_text(s, input);
+            continue;
+        }
+        if (line == "done") {
+            close_socket(s);
+            return 0;
+        } else if (line.compare(0, 4, "job ") == 0) {
+            parse_job(line, job);
+        } else if ( (line.compare(0, 8, "regions ") == 0) || (line.compare(0, 5, "bias ") == 0) ) {
+            job.ready = job.ready && parse_file(line, job);
+        } else if (line == "end") {
+            // Without everything the job needs, every unit would fail, so
+            // say so once and leave rather than take any on.
+            if (!job.ready) {
+                send_text(s, "unready\n");
+                close_socket(s);
+                fprintf(stderr, "Cannot take on the coordinator's job\n");
+                return 1;
+            }
+            ok = send_text(s, "ready\n");
+        } else if (line.compare(0, 5, "unit ") == 0) {
+            ok = run_unit(s, line, job, num_threads, models);
+        }
+    }
+    close_socket(s);
+    fprintf(stderr, "Lost the connection to the coordinator\n");
+    return 1;
+}
@@ -0,0 +1,66 @@
+// Runs a sweep across several processes, on this machine or others.
+//
+// A coordinator splits the sweep into work units, each a run of some of
+// the replicates at one point, and hands them out over plain TCP sockets
+// to worker processes, which are other copies of the batch driver.  It
+// can start workers on this machine itself, and other workers can connect
+// to it as well.  It takes them on the loopback address unless it is told
+// another, and then only those that give its shared token, since whatever
+// can reach the port could otherwise send it made-up results.  Each worker asks for one unit at a time, so
+// faster ones take more.  A unit whose worker reports a failure, drops
+// its connection or (if a timeout is set) takes too long is handed out
+// again, up to a limit.
+//
+// Replicate r always draws from stream r of the seed and the counts of
+// the units are added up, so every point gives exactly the histogram
+// run_sweep would, however the units are split and whichever workers run
+// them.
+//
+// The protocol is lines of text.  A worker opens with "hello VERSION
+// TOKEN", giving its CHROMATIN_ENGINE_VERSION and the token, if any, and is sent the seed, the bins and
+// any region or bias files once, ending with "end"; regions and bias
+// indexes are opened by name on the worker's host and must have the same
+// fingerprint there.  The worker answers "ready", or "unready" if it could
+// not set the job up, in which case it leaves and no unit is charged for
+// it.  After that the coordinator sends "unit" lines with the parameters
+// and the replicates to run, the worker answers each with a "result" line
+// of counts or a "failed" line, and "done" tells it to exit.
+
+#ifndef _DISTRIBUTED_SWEEP_H_
+#define _DISTRIBUTED_SWEEP_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "sweep_runner.h"
+
+class distributed_options {
+public:
+    distributed_options();
+
+    int         local_workers;      // Worker processes to start on this machine
+    int         worker_threads;     // Threads each of them uses
+    std::string worker_program;     // Program to start them with, the batch driver
+    int         port;               // Port to take workers on, or 0 for any, on this machine only
+    std::string bind_address;       // IPv4 address to take them on when a port is given
+    std::string token;              // Secret workers must give, needed off the loopback address
+    int         unit_replicates;    // Replicates in each work unit
+    int         max_attempts;       // Times a unit is handed out before the sweep fails
+    double      unit_timeout;       // Seconds a unit may take, or 0 for no limit
+};
+
+// Runs the sweep the way run_sweep does, but spreads the work units of
+// the points not found in the cache across worker processes.  Returns
+// false, after describing the problem on stderr, if the workers could not
+// be started or a unit failed every time it was tried.
+bool run_distributed_sweep(const std::vector<chromatin_parameters> &points, uint64_t seed,
+                           int num_replicates, const histogram_layout &layout,
+                           const result_cache *cache, const distributed_options &options,
+                           std::vector<sweep_result> &results);
+
+// Connects to the coordinator at host:port, giving it the specified token,
+// and runs the units it hands out on num_threads threads (0 or less for
+// all cores) until it is done.  Returns the process exit status.
+int run_sweep_worker(const char *host, int port, const std::string &token, int num_threads);
+
+#endif
@@ -0,0 +1,131 @@
+#include <math.h>
+#include <algorithm>
+
+#include "expected_histogram.h"
+#include "linker_distribution.h"
+
+// Stop following the chain once this little probability is left.
+static const double NEGLIGIBLE = 1e-12;
+
+bool compute_expected_histogram(const chromatin_parameters &params,
+                                const histogram_layout &layout,
+                                int num_replicates, double z,
+                                expected_histogram &result)
+{
+    const int N = params.bpPerNucleosome;
+    const linker_distribution linkers(params.bpPerLinker, params.nucleosomeSpacingVariance);
+    const int64_t num_bps = static_cast<int64_t>(N + params.bpPerLinker) * params.totalNucleosomes;
+    const int64_t num_cuts = static_cast<int64_t>((num_bps/3.0e3) * params.cutsPer3kBasePairs);
+    int64_t num_removed = static_cast<int64_t>(params.totalNucleosomes*(params.missingHistonePercent/100.0));
+    num_removed = std::min(num_removed, static_cast<int64_t>(params.totalNucleosomes));
+    const double q = static_cast<double>(num_removed) / params.totalNucleosomes;
+
+    result.layout = layout;
+    result.expected.assign(layout.binCount(), 0);
+    result.lower.assign(layout.binCount(), 0);
+    result.upper.assign(layout.binCount(), 0);
+    result.fragments = 0;
+
+    // Each unit of the strand is a linker of L base pairs, of which the
+    // first L-1 can be cut, followed by N+1 base pairs wrapped around the
+    // nucleosome, which can only be cut if its histone is missing.  Find
+    // how many base pairs can be cut in the part of the strand the cuts go
+    // in, and from that the chance that any one of them is cut.
+    const double mean_unit = linkers.mean() + N;
+    const double cuttable_per_unit = (linkers.mean() - 1) + q*(N + 1);
+    const double total_cuttable = (num_bps / mean_unit) * cuttable_per_unit;
+    if ( (num_cuts <= 0) || (total_cuttable < 1) ) {
+        return false;
+    }
+    const double p_cut = -expm1(num_cuts * log1p(-1.0 / total_cuttable));
+    const double p_skip = 1 - p_cut;
+
+    // Chain states: base pairs in a linker with r more to follow (r from 0
+    // to the longest linker minus 2), and base pairs in an attached or
+    // detached nucleosome with r more to follow (r from 0 to N).
+    const int num_linker_states = std::max(0, linkers.maxLength() - 1);
+    std::vector<double> linker(num_linker_states), attached(N + 1), detached(N + 1);
+    std::vector<double> next_linker(num_linker_states), next_attached(N + 1), next_detached(N + 1);
+
+    // The first cut sits on a cuttable base pair chosen in proportion to
+    // how often each state occurs along the strand.
+    double start_total = 0;
+    int r, length;
+    for (r = 0; r < num_linker_states; r++) {
+        double p_longer = 0;    // Chance of a linker with at least r+1 base pairs after this one
+        for (length = r + 2; length <= linkers.maxLength(); length++) {
+            p_longer += linkers.probability(length);
+        }
+        linker[r] = p_longer;
+        start_total += p_longer;
+    }
+    for (r = 0; r <= N; r++) {
+        detached[r] = q;
+        start_total += q;
+    }
+    for (r = 0; r < num_linker_states; r++) { linker[r] /= start_total; }
+    for (r = 0; r <= N; r++) { detached[r] /= start_total; }
+
+    // Step one base pair at a time.  At distance d the chance that the next
+    // cut is here is the chance of reaching a cuttable base pair with no
+    // cut so far, times the chance of a cut on it.
+    const int64_t longest = static_cast<int64_t>(ceil(layout.maxValue()));
+    std::vector<double> next_cut_at(1, 0.0);
+    int64_t d;
+    for (d = 1; d <= longest; d++) {
+
+        // Units end after their last nucleosome base pair, and a new linker
+        // (or, for one-base-pair linkers, a nucleosome) begins.
+        double unit_end = attached[0] + detached[0];
+        double nucleosome_start = (num_linker_states > 0 ? linker[0] : 0)
+                                + unit_end * linkers.probability(1);
+        for (r = 0; r + 1 < num_linker_states; r++) { next_linker[r] = linker[r + 1]; }
+        if (num_linker_states > 0) { next_linker[num_linker_states - 1] = 0; }
+        for (length = std::max(2, linkers.minLength()); length <= linkers.maxLength(); length++) {
+            next_linker[length - 2] += unit_end * linkers.probability(length);
+        }
+        for (r = 0; r < N; r++) {
+            next_attached[r] = attached[r + 1];
+            next_detached[r] = detached[r + 1];
+        }
+        next_attached[N] = (1 - q) * nucleosome_start;
+        next_detached[N] = q * nucleosome_start;
+        linker.swap(next_linker);
+        attached.swap(next_attached);
+        detached.swap(next_detached);
+
+        // Cut here, or carry on past this base pair uncut.
+        double cuttable = 0, remaining = 0;
+        for (r = 0; r < num_linker_states; r++) {
+            cuttable += linker[r];
+            linker[r] *= p_skip;
+        }
+        for (r = 0; r <= N; r++) {
+            cuttable += detached[r];
+            detached[r] *= p_skip;
+            remaining += attached[r] + detached[r];
+        }
+        for (r = 0; r < num_linker_states; r++) { remaining += linker[r]; }
+        next_cut_at.push_back(cuttable * p_cut);
+        if (remaining < NEGLIGIBLE) { break; }
+    }
+
+    // Every distinct cut location starts a fragment, so scale the length
+    // distribution by the expected number of cut base pairs.
+    result.fragments = total_cuttable * p_cut * num_replicates;
+    for (d = 1; d < static_cast<int64_t>(next_cut_at.size()); d++) {
+        int bin = layout.binFor(static_cast<double>(d));
+        if ( (bin >= 0) && (bin < layout.binCount()) ) {
+            result.expected[bin] += next_cut_at[d];
+        }
+    }
+    int i;
+    for (i = 0; i < layout.binCount(); i++) {
+        double p = result.expected[i];
+        double sd = sqrt(result.fragments * p * (1 - p));
+        result.expected[i] = result.fragments * p;
+        result.lower[i] = std::max(0.0, result.expected[i] - z*sd);
+        result.upper[i] = result.expected[i] + z*sd;
+    }
+    return true;
+}
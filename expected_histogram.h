@@ -0,0 +1,38 @@
+// Semi-analytic fragment-length distribution for the chromatin model.
+//
+// Instead of generating a model, this treats the strand as a Markov chain
+// over base pairs (position within a linker, an attached nucleosome or a
+// detached one) and the cuts as independent per cuttable base pair with
+// the density the model would give them.  Starting from a cut placed like
+// the model places them, it propagates the probability that the next cut
+// is d base pairs away.  That gives the expected histogram, with
+// approximate confidence bands, in a few milliseconds, which is fast enough
+// to update while a slider is being dragged.
+
+#ifndef _EXPECTED_HISTOGRAM_H_
+#define _EXPECTED_HISTOGRAM_H_
+
+#include <vector>
+#include "chromatin_model.h"
+
+class expected_histogram {
+public:
+    expected_histogram() : fragments(0) {}
+
+    histogram_layout    layout;     // Bins the values below refer to
+    std::vector<double> expected;   // Expected count in each bin
+    std::vector<double> lower;      // Lower edge of the confidence band
+    std::vector<double> upper;      // Upper edge of the confidence band
+    double              fragments;  // Expected number of fragments in all
+};
+
+// Computes the expected histogram for num_replicates models with the
+// specified parameters, binned into layout.  The bands are the expected
+// count plus or minus z standard deviations, treating each bin count as
+// binomial.  Returns false if there is no cuttable DNA or no cuts.
+bool compute_expected_histogram(const chromatin_parameters &params,
+                                const histogram_layout &layout,
+                                int num_replicates, double z,
+                                expected_histogram &result);
+
+#endif
@@ -0,0 +1,272 @@
+#include <math.h>
+#include <algorithm>
+
+#include "fragment_histogram.h"
+
+//----------------------------------------------------------------------
+// histogram_layout
+
+histogram_layout::histogram_layout()
+    : d_kind(CUSTOM)
+{
+    d_edges.push_back(0);
+    d_edges.push_back(0);
+}
+
+histogram_layout histogram_layout::linear(double min_bp, double max_bp, int num_bins)
+{
+    histogram_layout layout;
+    layout.d_kind = LINEAR;
+    layout.d_edges.resize(num_bins + 1);
+    double bin_size = (max_bp - min_bp) / num_bins;
+    int i;
+    for (i = 0; i < num_bins; i++) {
+        layout.d_edges[i] = min_bp + i*bin_size;
+    }
+    layout.d_edges[num_bins] = max_bp;
+    return layout;
+}
+
+histogram_layout histogram_layout::logarithmic(double min_bp, double max_bp, int num_bins)
+{
+    histogram_layout layout;
+    layout.d_kind = LOGARITHMIC;
+    layout.d_edges.resize(num_bins + 1);
+    double log_min = log(min_bp);
+    double log_step = (log(max_bp) - log_min) / num_bins;
+    int i;
+    for (i = 0; i < num_bins; i++) {
+        layout.d_edges[i] = exp(log_min + i*log_step);
+    }
+    layout.d_edges[0] = min_bp;
+    layout.d_edges[num_bins] = max_bp;
+    return layout;
+}
+
+histogram_layout histogram_layout::hdr(double min_bp, double max_bp, int sub_bucket_bits)
+{
+    // Edges fall on whole base pairs.  Within [2^e, 2^(e+1)) the bins are
+    // 2^e / 2^sub_bucket_bits wide, but never narrower than one base pair.
+    histogram_layout layout;
+    layout.d_kind = HDR;
+    layout.d_edges.clear();
+    int64_t value = std::max(static_cast<int64_t>(1), static_cast<int64_t>(floor(min_bp)));
+    int64_t top = static_cast<int64_t>(ceil(max_bp));
+    layout.d_edges.push_back(static_cast<double>(value));
+    while (value < top) {
+        int exponent = 0;
+        while ((static_cast<int64_t>(2) << exponent) <= value) {
+            exponent++;
+        }
+        int64_t width = std::max(static_cast<int64_t>(1),
+                                 (static_cast<int64_t>(1) << exponent) >> sub_bucket_bits);
+        value = (value / width + 1) * width;
+        layout.d_edges.push_back(static_cast<double>(value));
+    }
+    if (layout.d_edges.size() < 2) {
+        layout.d_edges.push_back(layout.d_edges.back() + 1);
+    }
+    return layout;
+}
+
+histogram_layout histogram_layout::custom(const std::vector<double> &edges)
+{
+    histogram_layout layout;
+    layout.d_kind = CUSTOM;
+    if (edges.size() >= 2) {
+        layout.d_edges = edges;
+    }
+    return layout;
+}
+
+histogram_layout histogram_layout::withEdges(spacing kind, const std::vector<double> &edges)
+{
+    histogram_layout layout = custom(edges);
+    layout.d_kind = kind;
+    return layout;
+}
+
+int histogram_layout::binFor(double value) const
+{
+    const int num_bins = binCount();
+    if (value < d_edges.front()) { return -1; }
+    if (value > d_edges.back()) { return num_bins; }
+
+    // Linear bins are found directly, the same way the original
+    // statistics code did, so that results do not change.
+    if (d_kind == LINEAR) {
+        double bin_size = (d_edges.back() - d_edges.front()) / num_bins;
+        int bin = 0;
+        if (bin_size > 0) {
+            bin = static_cast<int>(floor( (value - d_edges.front()) / bin_size ));
+        }
+        if (bin >= num_bins) { bin = num_bins - 1; }    // For one right at the end
+        return bin;
+    }
+
+    // Others are found by searching the edges.
+    std::vector<double>::const_iterator i =
+        std::upper_bound(d_edges.begin(), d_edges.end(), value);
+    int bin = static_cast<int>(i - d_edges.begin()) - 1;
+    if (bin >= num_bins) { bin = num_bins - 1; }
+    return bin;
+}
+
+bool histogram_layout::operator == (const histogram_layout &other) const
+{
+    return (d_kind == other.d_kind) && (d_edges == other.d_edges);
+}
+
+//----------------------------------------------------------------------
+// fragment_histogram
+
+fragment_histogram::fragment_histogram()
+    : d_underflow(0)
+    , d_overflow(0)
+{
+    reset(histogram_layout());
+}
+
+fragment_histogram::fragment_histogram(const histogram_layout &layout)
+    : d_underflow(0)
+    , d_overflow(0)
+{
+    reset(layout);
+}
+
+void fragment_histogram::reset(const histogram_layout &layout)
+{
+    d_layout = layout;
+    d_counts.assign(layout.binCount(), 0);
+    d_underflow = 0;
+    d_overflow = 0;
+}
+
+void fragment_histogram::add(double length, uint64_t count)
+{
+    int bin = d_layout.binFor(length);
+    if (bin < 0) {
+        d_underflow += count;
+    } else if (bin >= binCount()) {
+        d_overflow += count;
+    } else {
+        d_counts[bin] += count;
+    }
+}
+
+void fragment_histogram::addToBin(int bin, int64_t count)
+{
+    if (bin < 0) {
+        d_underflow += count;
+    } else if (bin >= binCount()) {
+        d_overflow += count;
+    } else {
+        d_counts[bin] += count;
+    }
+}
+
+void fragment_histogram::setCounts(const std::vector<uint64_t> &counts,
+                                   uint64_t underflow, uint64_t overflow)
+{
+    d_counts = counts;
+    d_underflow = underflow;
+    d_overflow = overflow;
+}
+
+void fragment_histogram::merge(const fragment_accumulator &other)
+{
+    const fragment_histogram &o = static_cast<const fragment_histogram &>(other);
+    size_t i;
+    for (i = 0; i < d_counts.size(); i++) {
+        d_counts[i] += o.d_counts[i];
+    }
+    d_underflow += o.d_underflow;
+    d_overflow += o.d_overflow;
+}
+
+//----------------------------------------------------------------------
+// fragment_length_counts
+
+void fragment_length_counts::addFragment(int64_t length)
+{
+    size_t which = static_cast<size_t>(length);
+    if (which >= d_counts.size()) {
+        d_counts.resize(which + 1, 0);
+    }
+    d_counts[which]++;
+}
+
+void fragment_length_counts::merge(const fragment_accumulator &other)
+{
+    const fragment_length_counts &o = static_cast<const fragment_length_counts &>(other);
+    if (o.d_counts.size() > d_counts.size()) {
+        d_counts.resize(o.d_counts.size(), 0);
+    }
+    size_t i;
+    for (i = 0; i < o.d_counts.size(); i++) {
+        d_counts[i] += o.d_counts[i];
+    }
+}
+
+uint64_t fragment_length_counts::totalFragments(void) const
+{
+    uint64_t total = 0;
+    size_t i;
+    for (i = 0; i < d_counts.size(); i++) {
+        total += d_counts[i];
+    }
+    return total;
+}
+
+bool fragment_length_counts::moments(double &mean, double &variance) const
+{
+    double count = 0, sum = 0;
+    size_t i;
+    for (i = 0; i < d_counts.size(); i++) {
+        count += d_counts[i];
+        sum += static_cast<double>(d_counts[i]) * i;
+    }
+    if (count == 0) {
+        return false;
+    }
+    mean = sum / count;
+    double sum_sq = 0;
+    for (i = 0; i < d_counts.size(); i++) {
+        double diff = i - mean;
+        sum_sq += d_counts[i] * diff * diff;
+    }
+    variance = sum_sq / count;
+    return true;
+}
+
+bool fragment_length_counts::histogram(fragment_histogram &histogram, int num_bins) const
+{
+    // Find the minimum and maximum lengths found.
+    size_t min_bp = 0, max_bp = 0;
+    size_t i;
+    for (i = 1; i < d_counts.size(); i++) {
+        if (d_counts[i] > 0) {
+            if (min_bp == 0) { min_bp = i; }
+            max_bp = i;
+        }
+    }
+    if (totalFragments() <= 1) {
+        return false;
+    }
+
+    // Fill in a histogram that has many steps from the minimum value to the
+    // maximum value, adding each of the entries into the bin associated with it.
+    histogram.reset(histogram_layout::linear(min_bp, max_bp, num_bins));
+    addTo(histogram);
+    return true;
+}
+
+void fragment_length_counts::addTo(fragment_histogram &histogram) const
+{
+    size_t i;
+    for (i = 1; i < d_counts.size(); i++) {
+        if (d_counts[i] > 0) {
+            histogram.add(static_cast<double>(i), d_counts[i]);
+        }
+    }
+}
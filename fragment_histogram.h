@@ -0,0 +1,149 @@
+// Accumulators for the lengths of the fragments between cuts.
+//
+// Every accumulator can be filled one fragment at a time and merged with
+// another of the same kind, so threads and replicates can each fill their
+// own and combine them at the end.  fragment_length_counts keeps an exact
+// count per base-pair length; fragment_histogram keeps counts in a fixed
+// set of bins described by a histogram_layout.
+
+#ifndef _FRAGMENT_HISTOGRAM_H_
+#define _FRAGMENT_HISTOGRAM_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class fragment_accumulator {
+public:
+    virtual ~fragment_accumulator() {}
+
+    // Adds one fragment of the specified length (which must be positive).
+    virtual void addFragment(int64_t length) = 0;
+
+    // Returns a new, empty accumulator of the same kind and binning, for
+    // another thread to fill.  The caller deletes it.
+    virtual fragment_accumulator *emptyCopy(void) const = 0;
+
+    // Adds the contents of another accumulator, which must have been made
+    // by emptyCopy() from this one (or one like it), into this one.
+    virtual void merge(const fragment_accumulator &other) = 0;
+};
+
+// Where the bin edges of a histogram fall.  Linear bins evenly divide the
+// range; logarithmic bins have evenly-spaced logarithms, to match a log
+// axis; HDR bins are exact base-pair counts for short fragments and then
+// split each power of two into 2^bits equal pieces, giving about the same
+// relative precision at every scale.  Custom layouts take explicit edges.
+class histogram_layout {
+public:
+    enum spacing { LINEAR, LOGARITHMIC, HDR, CUSTOM };
+
+    histogram_layout();
+
+    static histogram_layout linear(double min_bp, double max_bp, int num_bins);
+    static histogram_layout logarithmic(double min_bp, double max_bp, int num_bins);
+    static histogram_layout hdr(double min_bp, double max_bp, int sub_bucket_bits);
+    static histogram_layout custom(const std::vector<double> &edges);
+
+    // A layout of the specified kind with edges that its own function
+    // above made, as when one is sent to another process; it finds the
+    // same bins as the original.
+    static histogram_layout withEdges(spacing kind, const std::vector<double> &edges);
+
+    spacing kind(void) const { return d_kind; }
+    int binCount(void) const { return static_cast<int>(d_edges.size()) - 1; }
+    double minValue(void) const { return d_edges.front(); }
+    double maxValue(void) const { return d_edges.back(); }
+
+    // Edges of the bins; bin i spans [edges[i], edges[i+1]).  There is one
+    // more edge than there are bins.
+    const std::vector<double> &edges(void) const { return d_edges; }
+
+    // Returns the bin holding the value, -1 if it is below the range or
+    // binCount() if it is above.  The maximum value itself falls in the
+    // last bin.
+    int binFor(double value) const;
+
+    bool operator == (const histogram_layout &other) const;
+    bool operator != (const histogram_layout &other) const { return !(*this == other); }
+
+private:
+    spacing             d_kind;
+    std::vector<double> d_edges;
+};
+
+// Counts of fragments in the bins of a fixed layout, plus those that fell
+// below or above its range.  Two histograms with the same layout merge by
+// adding their counts, and memory depends only on the number of bins.
+class fragment_histogram : public fragment_accumulator {
+public:
+    fragment_histogram();
+    fragment_histogram(const histogram_layout &layout);
+
+    // Sets a new layout and clears the counts.
+    void reset(const histogram_layout &layout);
+
+    const histogram_layout &layout(void) const { return d_layout; }
+    int binCount(void) const { return d_layout.binCount(); }
+    double min_bp(void) const { return d_layout.minValue(); }
+    double max_bp(void) const { return d_layout.maxValue(); }
+    const std::vector<uint64_t> &counts(void) const { return d_counts; }
+    uint64_t underflow(void) const { return d_underflow; }
+    uint64_t overflow(void) const { return d_overflow; }
+
+    // Adds count fragments of the specified length.
+    void add(double length, uint64_t count = 1);
+
+    // Adds count fragments to the specified bin, which is -1 for those
+    // below the range or binCount() for those above it, as from
+    // histogram_layout::binFor.  A negative count takes back fragments
+    // that were added, as when two fragments are joined.
+    void addToBin(int bin, int64_t count);
+
+    // Replaces the counts, as when reading back a stored histogram.  There
+    // must be one count per bin.
+    void setCounts(const std::vector<uint64_t> &counts, uint64_t underflow, uint64_t overflow);
+
+    virtual void addFragment(int64_t length) { add(static_cast<double>(length)); }
+    virtual fragment_accumulator *emptyCopy(void) const { return new fragment_histogram(d_layout); }
+    virtual void merge(const fragment_accumulator &other);
+
+private:
+    histogram_layout        d_layout;
+    std::vector<uint64_t>   d_counts;
+    uint64_t                d_underflow;
+    uint64_t                d_overflow;
+};
+
+// Exact count of fragments at each length, in base pairs.  Memory grows
+// with the longest fragment seen rather than with the number of them.
+// When no range is known ahead of time these can be binned at the end to
+// span exactly the lengths that were seen.
+class fragment_length_counts : public fragment_accumulator {
+public:
+    virtual void addFragment(int64_t length);
+    virtual fragment_accumulator *emptyCopy(void) const { return new fragment_length_counts; }
+    virtual void merge(const fragment_accumulator &other);
+
+    // Returns the total number of fragments counted.
+    uint64_t totalFragments(void) const;
+
+    // Computes the mean and variance of the fragment lengths, in base
+    // pairs.  Returns false if there are no fragments.
+    bool moments(double &mean, double &variance) const;
+
+    // Fills in a histogram with the specified number of linear bins
+    // spanning the shortest to the longest fragment.  Returns false if
+    // there were not enough fragments to form one.
+    bool histogram(fragment_histogram &histogram, int num_bins = 100) const;
+
+    // Adds these counts into a histogram, whatever its layout.
+    void addTo(fragment_histogram &histogram) const;
+
+    void clear(void) { d_counts.clear(); }
+
+private:
+    std::vector<uint64_t>   d_counts;   // Entry i counts fragments i bp long
+};
+
+#endif
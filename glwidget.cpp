@@ -2,242 +2,233 @@
 #include <QtOpenGL>
 #include <QColor>
 #include <math.h>
-// For rand()
-#include <cstdlib>
 
 #include "glwidget.h"
+#include "expected_histogram.h"
+#include "run_file.h"
+#include "profiler.h"
 
 #ifndef GL_MULTISAMPLE
 #define GL_MULTISAMPLE  0x809D
 #endif
 
-//----------------------------------------------------------------------
-// Helper functions
-
-static double random_0_1(void)
-{
-  return static_cast<double>(rand())/RAND_MAX;
-}
-
-// Polar method for normal density discussed in Knuth
-
-static double random_normal_sample(void)
-{
-  double u1, u2, v1, v2;
-  double S = 2;
-  while (S >= 1) {
-    u1 = random_0_1();
-    u2 = random_0_1();
-    v1 = 2*u1 - 1;
-    v2 = 2*u2 - 1;
-    S = pow(v1, 2) + pow(v2, 2);
-  };
-  return v1*sqrt( (-2*log(S))/S );
-}
-
 GLWidget::GLWidget(QWidget *parent)
     : QGLWidget(QGLFormat(QGL::SampleBuffers), parent)
+    , worker(NULL)
+    , latestRequest(0)
+    , previewing(false)
+    , viewLeft(0)
 {
-    bpPerLinker = 20;
-    bpPerNucleosome = 146;
-
-    missingHistonePercent = 0;
-    nucleosomeSpacingVariance = 0;
-    cutsPer3kBasePairs = 1;
-
-    // How many nucleosomes to add to our model.
-    totalNucleosomes = 5000;
-
-    // Set the initial state of the model.
+    // The histogram is displayed on a log axis, so its bins are evenly
+    // spaced in log(base pairs) across a fixed range.  That keeps the short
+    // mono-, di- and tri-nucleosome fragments apart and means successive
+    // histograms share the same bins.
+    layout = histogram_layout::logarithmic(1, 1e5, 100);
+
+    // Start out showing the beginning of the strand at the same scale
+    // across as up and down.
+    bpPerUnit = params.bpPerNucleosome;
+
+    // Models are built on a thread of their own and come back to us
+    // through a queued signal, so the window never waits for one.  Their
+    // histograms go on to the display as shared snapshots.
+    qRegisterMetaType<histogram_snapshot>("histogram_snapshot");
+    worker = new ModelWorker(layout);
+    worker->moveToThread(&workerThread);
+    connect(worker, SIGNAL(modelReady(quint64, model_result_pointer)),
+            this, SLOT(modelReady(quint64, model_result_pointer)));
+    workerThread.start();
+
+    // Set the initial state of the model.  The parameters start out with
+    // their default values, including how many nucleosomes to add to it.
     updateModel();
 }
 
 GLWidget::~GLWidget()
 {
+    worker->cancel();
+    workerThread.quit();
+    workerThread.wait();
+    delete worker;
+
+    makeCurrent();
+    renderer.clear();
 }
 
 void GLWidget::updateModel(void)
 {
-    // Clear the lists of nucleosome locations and cut locations
-    // in preparation to making a new model.
-    nucleosomes.clear();
-    cutLocations.clear();
-
-    // Add nucleosomes into the model.  Each histone causes a chain of
-    // DNA bpPerNucleosome base-pairs long to wrap around it to form a nucleosome.
-    // The length of DNA between each wrapped nucleosome is on average
-    // bpPerLinker base-pairs long.  When we add a new nucleosome, we do so by
-    // figuring out how long the linker is from the last one (must be
-    // at least 1 base-pair long) and add it to the last nucleosome
-    // index, then we add a whole nucleosome length and locate the
-    // new nucleosome there.
-    int i;
-    long last_location = 0;
-    for (i = 0; i < totalNucleosomes; i++) {
-
-        // Select a linker length.  It will Gaussian distributed based on
-        // the variance, with a mean at the specified linker length.  If the
-        // length is less than 1, we pick another random number to avoid
-        // this case.  Also, if it tries to go above twice the linker length
-        // then we reject it; this will avoid increasing the mean separation.
-        int linker_length = bpPerLinker; // XXX Will be based on variance
-        if (nucleosomeSpacingVariance > 0) do {
-            linker_length = bpPerLinker + random_normal_sample() * sqrt(nucleosomeSpacingVariance);
-        } while ((linker_length <= 0) || (linker_length >= 2*bpPerLinker));
-
-        // Add the length onto the existing DNA strand and put a nucleosome
-        // there.
-        int add_length = linker_length + bpPerNucleosome;
-        long location = last_location + add_length;
-        nucleosome n;
-        n.location = location;
-        n.attached = true;
-        nucleosomes.push_back(n);
-        last_location = n.location;
-    }
+    latestRequest = worker->request(params);
+}
 
-    // Sort the list of nucleosomes by location (this should already be in order,
-    // but we make sure).
-    qSort(nucleosomes);
-
-    // Figure out which nucleosomes are detached.  We do this by
-    // randomly removing them until the specified percent is unattached.
-    // if they are all to be detached, we just do that without randomness.
-    int num_to_remove = static_cast<int>(totalNucleosomes*(missingHistonePercent/100.0));
-    if (num_to_remove >= nucleosomes.size()) {
-        for (i = 0; i < nucleosomes.size(); i++) {
-            nucleosomes[i].attached = false;
-        }
-    } else {
-        for (i = 0; i < num_to_remove; i++) {
-            // Select one at random until we find one that is not yet removed.
-            // Then remove it.
-            int which;
-            do {
-                which = static_cast<int>((nucleosomes.size()-1) * random_0_1());
-            } while (nucleosomes[which].attached == false);
-            nucleosomes[which].attached = false;
-        }
+void GLWidget::modelReady(quint64 generation, model_result_pointer result)
+{
+    // A model that was started before the latest change of parameters
+    // is out of date and is never shown.
+    if (generation != latestRequest) {
+        return;
     }
+    showResult(result);
+}
 
-    // Select locations for the cuts.  First figure out how many there are total and then
-    // put them all in.  Don't allow cuts that would fall within a wrapped nucleosome.
-    // We compute the number of base pairs by multiplying the expected amount of DNA
-    // per nucleosome (including linker) by the number of nucleosomes.
-    long num_bps = (bpPerNucleosome + bpPerLinker) * totalNucleosomes;
-    int num_cuts = (num_bps/3.0e3) * cutsPer3kBasePairs;
-    for (i = 0; i < num_cuts; i++) {
-
-        // Keep trying until we find a valid cut location
-        long try_cut;
-        do {
-            try_cut = random_0_1() * num_bps;
-        } while (!validCutLocation(try_cut));
-        cutLocations.push_back(try_cut);
+void GLWidget::showResult(model_result_pointer result)
+{
+    current = result;
+    makeCurrent();
+    renderer.setModel(current);
+    emit newStatusMessage(current->status);
+
+    // Tell the histogram display what to fill in, range and counts together.
+    if (!current->counts.isNull()) {
+        emit newHistogramCounts(current->counts);
     }
+    updateGL();
+}
 
-    // Sort the cut locations, to make it faster to process them during graphics and
-    // histogram formation.
-    qSort(cutLocations);
-
-    // Figure out the histogram of cut lengths, including the minimum and maximum,
-    // and fill in the histogram values.  Then emit messages to tell the histogram
-    // display what to fill in.
-    updateStatistics();
+QString GLWidget::openRun(const QString &filename)
+{
+    run_file file;
+    if (!file.open(QFile::encodeName(filename).constData())) {
+        return tr("%1 is not a run file that can be read").arg(filename);
+    }
+    QSharedPointer<model_result> result(new model_result);
+    result->seed = file.seed();
+    fragment_histogram histogram;
+    bool saved_histogram = file.hasHistogram();
+    if (!file.load(&result->model, &result->summary, saved_histogram ? &histogram : NULL)) {
+        return tr("%1 is damaged or incomplete").arg(filename);
+    }
+    if (!saved_histogram) {
+        histogram.reset(layout);
+        result->model.addFragmentLengths(histogram);
+    }
+    result->counts = make_histogram_snapshot(histogram);
+    result->status = tr("Showing the run saved in %1").arg(QFileInfo(filename).fileName());
+
+    // Abandon any model on its way, so that it does not replace this one,
+    // and start at the beginning of the strand.
+    worker->cancel();
+    latestRequest = 0;
+    viewLeft = 0;
+    showResult(result);
+    limitView();
+    return QString();
 }
 
-// Returns true if the specified location is a valid cut location
-// (a base pair that is not inside a wrapped nucleosome) and false if
-// it is inside a wrapped nucleosome.
-bool GLWidget::validCutLocation(long loc)
+QString GLWidget::setRegions(const QString &filename)
 {
-    // Find the first nucleosome that is at a location that is equal to
-    // or larger than the location.
-    nucleosome  which;
-    which.location = loc;
-    QVector<nucleosome>::ConstIterator i = qLowerBound(nucleosomes, which);
-
-    // If there is one, then see if we're within the wrapped base-pair region.
-    // Then see if this histone is wrapped.
-    // If so, return false.
-    if ( (i != nucleosomes.end()) && (*i).attached ) {
-        long nuc_loc = (*i).location;
-        if (nuc_loc - bpPerNucleosome <= loc) {
-            return false;
+    if (filename.isEmpty()) {
+        params.regions.reset();
+    } else {
+        std::shared_ptr<region_track> regions(new region_track);
+        size_t bad_line;
+        region_track::problem why;
+        if (!regions->open(QFile::encodeName(filename).constData(), &bad_line, &why)) {
+            if (bad_line == 0) {
+                return tr("Cannot read %1").arg(filename);
+            }
+            return tr("Line %1 of %2 %3").arg(bad_line).arg(filename)
+                       .arg(QString::fromLatin1(region_track::describe(why)));
         }
+        params.regions = regions;
     }
-
-    // We're in the clear.
-    return true;
+    updateModel();
+    return QString();
 }
 
-void GLWidget::updateStatistics(void)
+QString GLWidget::setBias(const QString &filename)
 {
-    // Compute the number of base pairs between each pair of cuts.
-    // Also keep track of the minimum and maximum found.
-    double min_bp = 1e50, max_bp = 0;
-    int i;
-    QVector<double> bps;
-    long last_cut = 0;
-    for (i = 0; i < cutLocations.size(); i++) {
-        double bp = cutLocations[i] - last_cut;
-
-        // If two cut at the same location, we don't count it as a zero cut.
-        if (bp > 0) {
-            bps.push_back(bp);
-            if (bp < min_bp) { min_bp = bp; }
-            if (bp > max_bp) { max_bp = bp; }
-            last_cut = cutLocations[i];
+    if (filename.isEmpty()) {
+        params.bias.reset();
+    } else {
+        std::shared_ptr<sequence_bias> bias(new sequence_bias);
+        if (!bias->open(QFile::encodeName(filename).constData())) {
+            return tr("Cannot read a sequence bias index from %1").arg(filename);
         }
+        params.bias = bias;
     }
+    updateModel();
+    return QString();
+}
 
-    // Fill in a histogram that has many steps from the minimum value to the
-    // maximum value, adding each of the entries into the bin associated with it.
-    // Then send the new values to the histogram.
-    if (bps.size() > 1) {
+QString GLWidget::saveRun(const QString &filename, bool compress)
+{
+    if (current.isNull()) {
+        return tr("There is no model to save yet");
+    }
+    fragment_histogram histogram(layout);
+    current->model.addFragmentLengths(histogram);
+    if (!run_file::write(QFile::encodeName(filename).constData(), current->model, current->seed,
+                         &current->summary, &histogram, compress)) {
+        return tr("Cannot write %1").arg(filename);
+    }
+    return QString();
+}
 
-        const int num_bins = 100;
-        double bin_size = (max_bp - min_bp) / num_bins;
-        histogram_values_passer    counts;
-        counts.resize(num_bins);
+void GLWidget::updatePreview(void)
+{
+    expected_histogram histogram;
+    if (compute_expected_histogram(params, layout, 1, 1.96, histogram)) {
+        histogram_values_passer    *counts = new histogram_values_passer;
+        counts->resize(histogram.layout.binCount());
+        counts->lower.resize(counts->size());
+        counts->upper.resize(counts->size());
         int i;
-        for (i = 0; i < num_bins; i++) {
-            counts[i] = 0;
-        }
-        for (i = 0; i < bps.size(); i++) {
-            int bin = floor( (bps[i]-min_bp) / bin_size );
-            if (bin >= num_bins) { bin = num_bins - 1; }    // For one right at the end
-            counts[bin] = counts[bin] + 1;
+        for (i = 0; i < counts->size(); i++) {
+            (*counts)[i] = qRound(histogram.expected[i]);
+            counts->lower[i] = histogram.lower[i];
+            counts->upper[i] = histogram.upper[i];
         }
+        counts->edges = QVector<double>::fromStdVector(histogram.layout.edges());
+        counts->min_value = histogram.layout.minValue();
+        counts->max_value = histogram.layout.maxValue();
+        emit newHistogramCounts(histogram_snapshot(counts));
+    }
+}
 
-        // Fill in the histogram and then emit messages to update its display.
-        emit newMinHistogramValue(min_bp);
-        emit newMaxHistogramValue(max_bp);
-        emit newHistogramCounts(counts);
+void GLWidget::parametersChanged(void)
+{
+    // While previewing, a model still being built would be out of date by
+    // the time it arrived, so it is abandoned.  The expected distribution
+    // assumes a uniform strand cut evenly, though, so with regions or a
+    // sequence bias loaded it would show a model other than the one being
+    // run; full models are built instead, and the worker drops each one a
+    // newer request overtakes.
+    if (previewing && !params.regions && !params.bias) {
+        worker->cancel();
+        latestRequest = 0;
+        updatePreview();
+    } else {
+        updateModel();
     }
 }
 
+void GLWidget::startPreview(void)
+{
+    previewing = true;
+}
 
+void GLWidget::endPreview(void)
+{
+    previewing = false;
+    parametersChanged();
+}
 
 void GLWidget::setMissingHistonePercent(int percent)
 {
-    missingHistonePercent = percent;
-    updateModel();
-    updateGL();
+    params.missingHistonePercent = percent;
+    parametersChanged();
 }
 
 void GLWidget::setNucleosomeSpacingVariance(int variance)
 {
-    nucleosomeSpacingVariance = variance;
-    updateModel();
-    updateGL();
+    params.nucleosomeSpacingVariance = variance;
+    parametersChanged();
 }
 
 void GLWidget::setCutsPer3kBasePairs(int cuts)
 {
-    cutsPer3kBasePairs = cuts;
-    updateModel();
-    updateGL();
+    params.cutsPer3kBasePairs = cuts;
+    parametersChanged();
 }
 
 void GLWidget::initializeGL()
@@ -263,9 +254,16 @@ void GLWidget::initializeGL()
 
 void GLWidget::paintGL()
 {
-    int i;
-
+    scoped_timer timer(PHASE_PAINT);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (current.isNull()) {
+        return;
+    }
+
+    // Draw the model that was built, whose parameters may be behind the
+    // sliders while a newer one is on its way.
+    const int bpPerNucleosome = current->model.parameters().bpPerNucleosome;
+
     glLoadIdentity();
     glTranslatef(0.0, 0.0, -10.0);
 
@@ -273,76 +271,22 @@ void GLWidget::paintGL()
     glPointSize(5.0);
     glDisable(GL_TEXTURE_2D);
 
-    // Set the base-pair to full-screen scale.
-    glScalef(1.0/bpPerNucleosome, 1.0/bpPerNucleosome, 1.0);
+    // Set the base-pair to full-screen scale.  Up and down it is fixed;
+    // across it follows the zoom.
+    glScalef(1.0/bpPerUnit, 1.0/bpPerNucleosome, 1.0);
 
 //    float scale = 1.0 / log(cutsPer3kBasePairs+9);
 //    glScalef(scale,scale,scale);
 
     // Draw the model, showing the linkers, the nucleosomes, and the cuts for the
-    // first part of the chain to give an idea of what it looks like.
+    // part of the chain that is in view.
     // The window is 1 unit high and however wide the aspect ratio requires.
     // Set the scale so that the bpPerNucleosome base pairs span from the top of the display
-    // to the bottom.
-    int last_bp = 0;    // Last base-pair location drawn.
-    int last_sl = 0;    // Screen location of this last pair.
-    int next_cut_index = 0; // Index of the next cut location to draw.
-    for (i = 0; i < nucleosomes.size(); i++) {
-
-        // Draw the line from the previous nucleosome to this one.
-        glColor3f(1.0, 1.0, 1.0);
-        int inc_bp = nucleosomes[i].location - last_bp;
-        int new_sl = last_sl + inc_bp - bpPerNucleosome;
-        glBegin(GL_LINES);
-            glVertex2f(last_sl, 0);
-            glVertex2f(new_sl, 0);
-        glEnd();
-
-        // Draw this nucleosome, either in wrapped form or unwrapped.
-        glColor3f(0.3, 1.0, 0.3);
-        if (nucleosomes[i].attached) {
-            glBegin(GL_POINTS);
-                glVertex2f(new_sl, 0);
-            glEnd();
-        } else {
-            glBegin(GL_LINES);
-                glVertex2f(new_sl, bpPerNucleosome/2.0);
-                glVertex2f(new_sl, -bpPerNucleosome/2.0);
-            glEnd();
-        }
-
-        // Draw any cut lines that fall between the last and the
-        // current base-pair value.
-        glColor3f(1.0, 0.3, 0.3);
-        while ( (next_cut_index < cutLocations.size())
-                && (cutLocations[next_cut_index] <= last_bp + inc_bp) ) {
-
-            // If this cut is before the start of the nucleosome, then we
-            // draw it vertically across the DNA.
-            float halfcut = bpPerLinker/2.0;    // Half length of cut line
-            if (last_bp + inc_bp - bpPerNucleosome > cutLocations[next_cut_index]) {
-                long xloc = last_sl + (cutLocations[next_cut_index] - last_bp);
-                glBegin(GL_LINES);
-                    glVertex3f(xloc, halfcut, 1.0);
-                    glVertex3f(xloc, -halfcut, 1.0);
-                glEnd();
-            } else {
-                // If this is cut within the chromosome, then draw it horizontally
-                // the fraction of the way from the bottom of the screen to the top
-                // that it is along the nucleosomal DNA (this is an abstract representation).
-                long yloc = -bpPerNucleosome/2 + (last_bp + inc_bp - cutLocations[next_cut_index]);
-                glBegin(GL_LINES);
-                    glVertex3f(new_sl - halfcut, yloc, 1.0);
-                    glVertex3f(new_sl + halfcut, yloc, 1.0);
-                glEnd();
-            }
-
-            next_cut_index++;
-        }
-
-        last_bp += inc_bp;
-        last_sl = new_sl;
-    }
+    // to the bottom.  Only the part of the strand that is on screen is drawn, and
+    // when zoomed far out it is drawn as densities rather than one piece at a time.
+    double aspect = (height() > 0) ? static_cast<double>(width())/height() : 1.0;
+    double bp_per_pixel = bpPerUnit / qMax(1, height());
+    renderer.draw(viewLeft, viewLeft + aspect * bpPerUnit, bp_per_pixel);
 }
 
 void GLWidget::resizeGL(int width, int height)
@@ -376,10 +320,49 @@ void GLWidget::mouseMoveEvent(QMouseEvent *event)
     int dx = event->x() - lastPos.x();
     int dy = event->y() - lastPos.y();
 
+    // Dragging with the left button moves the strand along with the mouse.
+    // Dragging up with the right button zooms in and down zooms out.
     if (event->buttons() & Qt::LeftButton) {
-        // XXX
+        viewLeft -= dx * bpPerUnit / qMax(1, height());
+        limitView();
+        updateGL();
     } else if (event->buttons() & Qt::RightButton) {
-        // XXX
+        zoomAbout(lastPos.x(), exp(dy * 0.01));
+        updateGL();
     }
     lastPos = event->pos();
 }
+
+void GLWidget::wheelEvent(QWheelEvent *event)
+{
+    // Each notch of the wheel zooms by a factor of the square root of two.
+    zoomAbout(event->x(), pow(2.0, -event->delta() / 240.0));
+    updateGL();
+}
+
+void GLWidget::zoomAbout(int x, double factor)
+{
+    double bp_per_pixel = bpPerUnit / qMax(1, height());
+    double anchor = viewLeft + x * bp_per_pixel;
+    bpPerUnit *= factor;
+
+    // Go no closer than a few base pairs across the window and no
+    // further than the whole strand.
+    double longest = params.bpPerNucleosome;
+    if (!current.isNull()) {
+        longest = qMax(longest, static_cast<double>(current->summary.strandLength()));
+    }
+    bpPerUnit = qBound(4.0, bpPerUnit, longest);
+
+    viewLeft = anchor - x * bpPerUnit / qMax(1, height());
+    limitView();
+}
+
+void GLWidget::limitView(void)
+{
+    // Let at most half the window go past either end of the strand.
+    double aspect = (height() > 0) ? static_cast<double>(width())/height() : 1.0;
+    double half_window = aspect * bpPerUnit / 2;
+    double length = current.isNull() ? 0 : static_cast<double>(current->summary.strandLength());
+    viewLeft = qBound(-half_window, viewLeft, qMax(-half_window, length - half_window));
+}
@@ -2,16 +2,11 @@
 #define GLWIDGET_H
 
 #include <QGLWidget>
+#include <QThread>
 #include "histogram_values_passer.h"
-
-class nucleosome {
-public:
-    long location;  // Index of the last base pair wrapped around the nucleosome
-    bool attached;  // Stores whether it is attached or not.
-
-    const bool operator < (const nucleosome &n) const { return location < n.location; };
-    const bool operator < (const long num) const { return location < num; };
-};
+#include "chromatin_model.h"
+#include "model_worker.h"
+#include "strand_renderer.h"
 
 class GLWidget : public QGLWidget
 {
@@ -21,16 +16,48 @@ public:
     GLWidget(QWidget *parent = 0);
     ~GLWidget();
 
+    // Shows the run saved in the specified file in place of the model,
+    // reading it in place rather than loading it, until the parameters
+    // are next changed.  Returns a description of what went wrong, or an
+    // empty string.
+    QString openRun(const QString &filename);
+
+    // Saves the model being shown, with its histogram, as a run file.
+    // Returns a description of what went wrong, or an empty string.
+    QString saveRun(const QString &filename, bool compress);
+
+    // Reads per-region parameters (see region_track.h) from the specified
+    // file, or goes back to a uniform strand for an empty name, and builds
+    // a new model.  Returns a description of what went wrong, or an empty
+    // string.
+    QString setRegions(const QString &filename);
+
+    // Maps a sequence bias index (see sequence_bias.h) that weights where
+    // the cuts go, or goes back to uniform cutting for an empty name, and
+    // builds a new model.  Returns a description of what went wrong, or
+    // an empty string.
+    QString setBias(const QString &filename);
+
 public slots:
     void setMissingHistonePercent(int percent);
     void setNucleosomeSpacingVariance(int variance);
     void setCutsPer3kBasePairs(int cuts);
 
+    // While a slider is being dragged, parameter changes only update the
+    // histogram, with the fast expected distribution, unless regions or a
+    // sequence bias are loaded.  When it is let go the full model is
+    // generated.
+    void startPreview(void);
+    void endPreview(void);
+
+    // Displays a model built by the worker, unless a newer one has been
+    // asked for since.
+    void modelReady(quint64 generation, model_result_pointer result);
+
 signals:
-    void newMinHistogramValue(double val);
-    void newMaxHistogramValue(double val);
-    void newHistogramCounts(histogram_values_passer);
+    void newHistogramCounts(histogram_snapshot);
     void newVersionLabel(QString);
+    void newStatusMessage(QString);
 
 protected:
     void initializeGL();
@@ -38,32 +65,43 @@ protected:
     void resizeGL(int width, int height);
     void mousePressEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
+    void wheelEvent(QWheelEvent *event);
+
+    // Scales the number of base pairs across the window by factor, keeping
+    // the base pair under window column x where it is.
+    void zoomAbout(int x, double factor);
+
+    // Keeps the view from wandering away from the strand.
+    void limitView(void);
 
-    // Updates the model of histone and cut locations based on
-    // the now-current values for the private variables.
+    // Asks the worker thread for a new model of histone and cut locations
+    // based on the now-current values for the parameters.  It and its
+    // statistics are displayed when it arrives.
     void updateModel(void);
 
-    // Updates the statistics based on the model.  This reports
-    // the new values through signals.
-    void updateStatistics(void);
+    // Either regenerates the model or, while previewing, reports the
+    // expected histogram for the current parameters.
+    void parametersChanged(void);
 
-private:
-    int bpPerNucleosome;
-    int bpPerLinker;
-    int totalNucleosomes;
-    int missingHistonePercent;
-    int nucleosomeSpacingVariance;
-    int cutsPer3kBasePairs;
-    QPoint lastPos; // Last place the mouse was.
+    // Reports the expected histogram for the current parameters through
+    // the same signal as a finished model.
+    void updatePreview(void);
 
-    // This is a list of histone center locations, in base pairs.
-    // Then a function to tell whether a specified base-pair location
-    // can be cut (it can if it is not inside a nuclesome section).
-    QVector<nucleosome>    nucleosomes;
-    bool validCutLocation(long loc);
+    // Displays the specified model and its histogram.
+    void showResult(model_result_pointer result);
 
-    // This is a list of cut locations, in base pairs.
-    QVector<long>    cutLocations;
+private:
+    chromatin_parameters params;    // Parameters set by the sliders
+    histogram_layout layout;        // Bins for the fragment-length histogram
+    model_result_pointer current;   // Model being displayed, if any yet
+    StrandRenderer renderer;        // Draws it from vertex buffers
+    ModelWorker *worker;            // Builds models on workerThread
+    QThread workerThread;
+    quint64 latestRequest;          // Generation of the model to display next
+    bool previewing;                // Is a slider being dragged?
+    double viewLeft;                // Base pair along the strand at the left edge
+    double bpPerUnit;               // Base pairs across a window-height of width
+    QPoint lastPos; // Last place the mouse was.
 };
 
 #endif
@@ -1,14 +1,41 @@
 // This file is a horrible hack to let us use Qt Designer to create the object
 // of a type needed to pass values to the histogram.  It basically encapsulates
-// a templated class.
+// a templated class.  The counts are the vector itself; the range and the
+// bin edges ride along with them so that the display gets everything it
+// needs in one update and does not have to assume even bins.
+//
+// A histogram is handed around as a histogram_snapshot, a shared pointer
+// to one that is never changed once it is made, so passing it through
+// signals and keeping it for the next replot shares it rather than
+// copying it.
 
 #ifndef _HISTOGRAM_VALUES_PASSER_H_
 #define _HISTOGRAM_VALUES_PASSER_H_
 
 #include <qvector.h>
+#include <QSharedPointer>
+#include <QMetaType>
 
 class histogram_values_passer: public QVector<int>
 {
+public:
+    histogram_values_passer() : min_value(0), max_value(0) {}
+
+    // Left side of the minimum bin and right side of the maximum bin.
+    double min_value;
+    double max_value;
+
+    // Edges of the bins, one more than there are counts, or empty if the
+    // bins evenly divide the range set by the minimum and maximum.
+    QVector<double> edges;
+
+    // Confidence band around each count, or empty when the counts come
+    // from a simulation rather than from the expected distribution.
+    QVector<double> lower;
+    QVector<double> upper;
 };
 
+typedef QSharedPointer<const histogram_values_passer> histogram_snapshot;
+Q_DECLARE_METATYPE(histogram_snapshot)
+
 #endif
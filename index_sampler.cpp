@@ -0,0 +1,113 @@
+#include "index_sampler.h"
+#include "random_stream.h"
+
+static const size_t MIN_SLOTS = 64;
+
+index_sampler::index_sampler(uint64_t n)
+    : d_used(0)
+    , d_stamp(1)
+    , d_shift(64)
+{
+    reset(n);
+}
+
+void index_sampler::reset(uint64_t n)
+{
+    d_n = n;
+    d_drawn = 0;
+    d_used = 0;
+
+    // Every slot is stale once the stamp moves on.  Only when it wraps
+    // around do they need clearing for real.
+    if (++d_stamp == 0) {
+        size_t i;
+        for (i = 0; i < d_slots.size(); i++) {
+            d_slots[i].stamp = 0;
+        }
+        d_stamp = 1;
+    }
+}
+
+void index_sampler::reserve(uint64_t count)
+{
+    // Each draw stores at most two positions, and the table is kept at
+    // most half full.
+    size_t size = MIN_SLOTS;
+    while (size < 4 * count) {
+        size *= 2;
+    }
+    if (size > d_slots.size()) {
+        grow(size);
+    }
+}
+
+void index_sampler::grow(size_t size)
+{
+    std::vector<slot> old;
+    old.swap(d_slots);
+    slot empty;
+    empty.position = 0;
+    empty.value = 0;
+    empty.stamp = 0;
+    d_slots.assign(size, empty);
+    d_shift = 64;
+    while ((static_cast<size_t>(1) << (64 - d_shift)) < size) {
+        d_shift--;
+    }
+    d_used = 0;
+    size_t i;
+    for (i = 0; i < old.size(); i++) {
+        if (old[i].stamp == d_stamp) {
+            setValue(old[i].position, old[i].value);
+        }
+    }
+}
+
+uint64_t index_sampler::valueAt(uint64_t position) const
+{
+    if (d_used == 0) {
+        return position;
+    }
+    const size_t mask = d_slots.size() - 1;
+    size_t i;
+    for (i = home(position); d_slots[i].stamp == d_stamp; i = (i + 1) & mask) {
+        if (d_slots[i].position == position) {
+            return d_slots[i].value;
+        }
+    }
+    return position;
+}
+
+void index_sampler::setValue(uint64_t position, uint64_t value)
+{
+    if (2 * (d_used + 1) > d_slots.size()) {
+        grow(d_slots.empty() ? MIN_SLOTS : 2 * d_slots.size());
+    }
+    const size_t mask = d_slots.size() - 1;
+    size_t i;
+    for (i = home(position); d_slots[i].stamp == d_stamp; i = (i + 1) & mask) {
+        if (d_slots[i].position == position) {
+            d_slots[i].value = value;
+            return;
+        }
+    }
+    d_slots[i].position = position;
+    d_slots[i].value = value;
+    d_slots[i].stamp = d_stamp;
+    d_used++;
+}
+
+uint64_t index_sampler::next(random_stream &rng)
+{
+    // Swap a uniformly-chosen position from the not-yet-drawn tail into
+    // the next drawn slot and return what ends up there.  The drawn slot
+    // keeps its value so that drawnAt() can report it later.
+    uint64_t position = d_drawn + rng.below(d_n - d_drawn);
+    uint64_t chosen = valueAt(position);
+    if (position != d_drawn) {
+        setValue(position, valueAt(d_drawn));
+        setValue(d_drawn, chosen);
+    }
+    d_drawn++;
+    return chosen;
+}
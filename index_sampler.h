@@ -0,0 +1,80 @@
+// Draws distinct indices from [0, n) without replacement.
+//
+// This is a partial Fisher-Yates shuffle of the identity permutation of
+// [0, n).  Only the entries that have been swapped away from their
+// identity value are stored, so drawing k of n indices costs O(k) time
+// and memory no matter how large n is, and every subset of size k is
+// equally likely.  They are kept in an open-addressed table whose slots
+// outlive a reset, so a sampler that is reset and drawn from again, as
+// one is for every model a workspace builds, allocates nothing once its
+// table has grown to fit.
+
+#ifndef _INDEX_SAMPLER_H_
+#define _INDEX_SAMPLER_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class random_stream;
+
+class index_sampler {
+public:
+    index_sampler(uint64_t n = 0);
+
+    // Starts over drawing from [0, n).  This takes constant time, however
+    // many were drawn before.
+    void reset(uint64_t n);
+
+    // Sizes the table for drawing count indices between resets without
+    // growing it.
+    void reserve(uint64_t count);
+
+    // Returns the next index, which has not been returned since the last
+    // reset.  Must not be called more than n times between resets.
+    uint64_t next(random_stream &rng);
+
+    // How many indices have been drawn since the last reset.
+    uint64_t drawn(void) const { return d_drawn; }
+
+    // Returns the index that was returned by call number position (counting
+    // from zero) since the last reset.  position must be less than drawn().
+    uint64_t drawnAt(uint64_t position) const { return valueAt(position); }
+
+    // Bytes used by the table.
+    size_t memoryUsage(void) const { return d_slots.capacity() * sizeof(slot); }
+
+private:
+    // A position not holding its own index.  A slot is only in use if its
+    // stamp is the current one, so a reset just moves to the next stamp.
+    class slot {
+    public:
+        uint64_t    position;
+        uint64_t    value;
+        uint32_t    stamp;
+    };
+
+    // Value at the specified position in the virtual permutation.
+    uint64_t valueAt(uint64_t position) const;
+
+    // Records the value now at a position.
+    void setValue(uint64_t position, uint64_t value);
+
+    // First slot to probe for a position.
+    size_t home(uint64_t position) const {
+        return static_cast<size_t>((position * 0x9E3779B97F4A7C15ULL) >> d_shift);
+    }
+
+    // Makes the table at least the specified number of slots, a power of
+    // two, keeping the slots in use.
+    void grow(size_t size);
+
+    uint64_t    d_n;        // Size of the range being drawn from
+    uint64_t    d_drawn;    // Positions [0, d_drawn) hold the indices returned so far
+    std::vector<slot>   d_slots;    // Positions not holding their own index
+    size_t      d_used;     // Slots with the current stamp
+    uint32_t    d_stamp;    // Stamp of the slots in use
+    int         d_shift;    // 64 less the bits of a slot number
+};
+
+#endif
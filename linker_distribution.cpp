@@ -0,0 +1,78 @@
+#include <math.h>
+
+#include "linker_distribution.h"
+
+// Cumulative distribution function of the standard normal.
+static double normal_cdf(double x)
+{
+    return 0.5 * erfc(-x / sqrt(2.0));
+}
+
+linker_distribution::linker_distribution(int bpPerLinker, double variance)
+{
+    // With no variance every linker is the same length.
+    if (variance <= 0) {
+        d_min = bpPerLinker;
+        d_pmf.assign(1, 1.0);
+        d_mean = bpPerLinker;
+        d_cdf.assign(1, 1.0);
+        d_guide.assign(1, 0);
+        return;
+    }
+
+    // A sample x becomes length k when k <= x < k+1 (conversion to an
+    // integer truncates, and only positive lengths are kept).  Lengths
+    // outside [1, 2*bpPerLinker - 1] are rejected, so renormalize.
+    double sigma = sqrt(variance);
+    int max_length = 2*bpPerLinker - 1;
+    d_min = 1;
+    d_pmf.resize(max_length);
+    double total = 0;
+    int k;
+    for (k = 1; k <= max_length; k++) {
+        double p = normal_cdf((k + 1 - bpPerLinker) / sigma) - normal_cdf((k - bpPerLinker) / sigma);
+        d_pmf[k - 1] = p;
+        total += p;
+    }
+    d_mean = 0;
+    for (k = 1; k <= max_length; k++) {
+        d_pmf[k - 1] /= total;
+        d_mean += k * d_pmf[k - 1];
+    }
+
+    // Tabulate the cumulative distribution for sampling.  The last entry
+    // is made exactly one so that every u below one finds a length.
+    d_cdf.resize(max_length);
+    double sum = 0;
+    for (k = 0; k < max_length; k++) {
+        sum += d_pmf[k];
+        d_cdf[k] = sum;
+    }
+    d_cdf[max_length - 1] = 1;
+    d_guide.resize(max_length);
+    int j;
+    k = 0;
+    for (j = 0; j < max_length; j++) {
+        while (d_cdf[k] <= static_cast<double>(j) / max_length) {
+            k++;
+        }
+        d_guide[j] = k;
+    }
+}
+
+int linker_distribution::sample(double u) const
+{
+    size_t k = d_guide[static_cast<size_t>(u * d_guide.size())];
+    while (d_cdf[k] <= u) {
+        k++;
+    }
+    return d_min + static_cast<int>(k);
+}
+
+double linker_distribution::probability(int length) const
+{
+    if ( (length < d_min) || (length > maxLength()) ) {
+        return 0;
+    }
+    return d_pmf[length - d_min];
+}
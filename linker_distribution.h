@@ -0,0 +1,48 @@
+// The distribution of linker lengths that the model draws from.
+//
+// A linker is bpPerLinker plus a normal sample scaled by the square root
+// of the variance, truncated to an integer, and drawn again until the
+// length is in [1, 2*bpPerLinker - 1].  This class tabulates the exact
+// probability of each length that procedure produces, so that it can be
+// used analytically or sampled without rejection.  The model draws its
+// linkers from it that way.
+
+#ifndef _LINKER_DISTRIBUTION_H_
+#define _LINKER_DISTRIBUTION_H_
+
+#include <vector>
+
+class linker_distribution {
+public:
+    linker_distribution(int bpPerLinker = 20, double variance = 0);
+
+    // Shortest and longest possible linker lengths.
+    int minLength(void) const { return d_min; }
+    int maxLength(void) const { return d_min + static_cast<int>(d_pmf.size()) - 1; }
+
+    // Probability of a linker of the specified length.
+    double probability(int length) const;
+
+    // Mean linker length.
+    double mean(void) const { return d_mean; }
+
+    // Returns the length whose share of the cumulative distribution holds
+    // u, which must be in [0, 1).  With u uniform this draws a length with
+    // exactly the distribution above, truncation included, in constant
+    // expected time and without rejection.
+    int sample(double u) const;
+
+private:
+    int                 d_min;      // Length of the first entry in d_pmf
+    std::vector<double> d_pmf;      // Probability of each length from d_min up
+    double              d_mean;
+
+    // For sample(): d_cdf[k] is the probability of a length at most
+    // d_min + k, and d_guide[j] is the first k with d_cdf[k] above
+    // j / d_guide.size(), so a search starts close to its answer
+    // (Chen and Asau's guide table).
+    std::vector<double> d_cdf;
+    std::vector<int>    d_guide;
+};
+
+#endif
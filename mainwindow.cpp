@@ -1,11 +1,169 @@
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QMenu>
+#include <QLabel>
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    lastUpdate(0)
 {
     ui->setupUi(this);
+
+    // Problems with the model are reported on the status bar.
+    connect(ui->widget, SIGNAL(newStatusMessage(QString)),
+            ui->statusBar, SLOT(showMessage(QString)));
+
+    // Runs can be saved and opened again later without regenerating them.
+    QMenu *file = ui->menuBar->addMenu(tr("&File"));
+    file->addAction(tr("&Open Run..."), this, SLOT(openRun()), QKeySequence::Open);
+    file->addAction(tr("&Save Run..."), this, SLOT(saveRun()), QKeySequence::Save);
+    file->addAction(tr("Save &Compressed Run..."), this, SLOT(saveCompressedRun()));
+    file->addSeparator();
+    file->addAction(tr("Open &Regions..."), this, SLOT(openRegions()));
+    file->addAction(tr("C&lear Regions"), this, SLOT(clearRegions()));
+    file->addAction(tr("Open Cut &Bias..."), this, SLOT(openBias()));
+    file->addAction(tr("Clear C&ut Bias"), this, SLOT(clearBias()));
+
+    // When things are slow, the time going to each phase of building and
+    // drawing the model can be shown on the status bar.
+    QMenu *view = ui->menuBar->addMenu(tr("&View"));
+    QAction *performance = view->addAction(tr("&Performance"));
+    performance->setCheckable(true);
+    performance->setShortcut(Qt::Key_F12);
+    connect(performance, SIGNAL(toggled(bool)), this, SLOT(showPerformance(bool)));
+    performanceLabel = new QLabel;
+    performanceLabel->hide();
+    ui->statusBar->addPermanentWidget(performanceLabel);
+    performanceTimer.setInterval(PERFORMANCE_MSEC);
+    connect(&performanceTimer, SIGNAL(timeout()), this, SLOT(updatePerformance()));
+}
+
+void MainWindow::openRegions()
+{
+    QString filename = QFileDialog::getOpenFileName(this, tr("Open Regions"), QString(),
+                                                    tr("Region files (*.bed *.txt);;All files (*)"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    QString problem = ui->widget->setRegions(filename);
+    if (!problem.isEmpty()) {
+        QMessageBox::warning(this, tr("Open Regions"), problem);
+    }
+}
+
+void MainWindow::clearRegions()
+{
+    ui->widget->setRegions(QString());
+}
+
+void MainWindow::openBias()
+{
+    QString filename = QFileDialog::getOpenFileName(this, tr("Open Cut Bias"), QString(),
+                                                    tr("Bias indexes (*.bias);;All files (*)"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    QString problem = ui->widget->setBias(filename);
+    if (!problem.isEmpty()) {
+        QMessageBox::warning(this, tr("Open Cut Bias"), problem);
+    }
+}
+
+void MainWindow::clearBias()
+{
+    ui->widget->setBias(QString());
+}
+
+void MainWindow::showPerformance(bool on)
+{
+    profiler::setEnabled(on);
+    performanceLabel->setVisible(on);
+    if (on) {
+        profiler::totals(lastTotals);
+        lastUpdate = profiler::now();
+        performanceLabel->setText(tr("Profiling..."));
+        performanceTimer.start();
+    } else {
+        performanceTimer.stop();
+    }
+}
+
+void MainWindow::updatePerformance()
+{
+    profile_totals totals;
+    profiler::totals(totals);
+    qint64 now = profiler::now();
+
+    // List the phases that ran, with how long they took and how many
+    // times, then the work they counted.
+    QStringList phases;
+    int i;
+    for (i = 0; i < NUM_PHASES; i++) {
+        quint64 calls = totals.calls[i] - lastTotals.calls[i];
+        if (calls > 0) {
+            double msec = (totals.nanoseconds[i] - lastTotals.nanoseconds[i]) / 1e6;
+            phases << tr("%1 %2 ms x%3").arg(profiler::phaseName(static_cast<profile_phase>(i)))
+                                        .arg(msec, 0, 'f', 1).arg(calls);
+        }
+    }
+    QStringList counts;
+    for (i = 0; i < NUM_COUNTERS; i++) {
+        quint64 count = totals.counts[i] - lastTotals.counts[i];
+        if (count > 0) {
+            counts << tr("%1 %2").arg(profiler::counterName(static_cast<profile_counter>(i))).arg(count);
+        }
+    }
+    QString text = tr("Last %1 s: ").arg((now - lastUpdate) / 1e9, 0, 'f', 1);
+    if (phases.isEmpty()) {
+        text += tr("idle");
+    } else {
+        text += phases.join(", ");
+    }
+    if (!counts.isEmpty()) {
+        text += " | " + counts.join(", ");
+    }
+    performanceLabel->setText(text);
+    lastTotals = totals;
+    lastUpdate = now;
+}
+
+void MainWindow::openRun()
+{
+    QString filename = QFileDialog::getOpenFileName(this, tr("Open Run"), QString(),
+                                                    tr("Run files (*.ccrun);;All files (*)"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    QString problem = ui->widget->openRun(filename);
+    if (!problem.isEmpty()) {
+        QMessageBox::warning(this, tr("Open Run"), problem);
+    }
+}
+
+void MainWindow::saveRun()
+{
+    saveRun(false);
+}
+
+void MainWindow::saveCompressedRun()
+{
+    saveRun(true);
+}
+
+void MainWindow::saveRun(bool compress)
+{
+    QString filename = QFileDialog::getSaveFileName(this, tr("Save Run"), QString(),
+                                                    tr("Run files (*.ccrun)"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    QString problem = ui->widget->saveRun(filename, compress);
+    if (!problem.isEmpty()) {
+        QMessageBox::warning(this, tr("Save Run"), problem);
+    }
 }
 
 MainWindow::~MainWindow()
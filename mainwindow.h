@@ -2,6 +2,10 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QTimer>
+#include "profiler.h"
+
+class QLabel;
 
 namespace Ui {
     class MainWindow;
@@ -15,8 +19,40 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+private slots:
+    // Ask for a run file and show it, or save the model shown to one.
+    void openRun();
+    void saveRun();
+    void saveCompressedRun();
+
+    // Ask for a file of per-region parameters to model, or go back to a
+    // uniform strand.
+    void openRegions();
+    void clearRegions();
+
+    // Ask for a sequence bias index to weight the cuts by, or go back to
+    // cutting uniformly.
+    void openBias();
+    void clearBias();
+
+    // Turns profiling on or off and shows or hides the status-bar panel
+    // with the time spent in each phase.
+    void showPerformance(bool on);
+
+    // Shows the time each phase took, and the work counted, since the
+    // panel was last updated.
+    void updatePerformance();
+
 private:
+    enum { PERFORMANCE_MSEC = 1000 };   // Time between panel updates
+
+    void saveRun(bool compress);
+
     Ui::MainWindow *ui;
+    QLabel *performanceLabel;       // Status-bar panel, shown while profiling
+    QTimer performanceTimer;
+    profile_totals lastTotals;      // At the previous update
+    qint64 lastUpdate;              // When that was, from profiler::now()
 };
 
 #endif // MAINWINDOW_H
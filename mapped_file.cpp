@@ -0,0 +1,108 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+mapped_file::mapped_file()
+    : d_data(NULL)
+    , d_size(0)
+#ifdef _WIN32
+    , d_file(INVALID_HANDLE_VALUE)
+    , d_mapping(NULL)
+#endif
+{
+}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool mapped_file::open(const char *filename)
+{
+    close();
+    d_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (d_file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(d_file, &size) || (size.QuadPart == 0)) {
+        close();
+        return false;
+    }
+    d_mapping = CreateFileMappingA(d_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (d_mapping == NULL) {
+        close();
+        return false;
+    }
+    d_data = static_cast<const char *>(MapViewOfFile(d_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (d_data == NULL) {
+        close();
+        return false;
+    }
+    d_size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void mapped_file::close(void)
+{
+    if (d_data) {
+        UnmapViewOfFile(d_data);
+    }
+    if (d_mapping) {
+        CloseHandle(d_mapping);
+    }
+    if (d_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(d_file);
+    }
+    d_data = NULL;
+    d_size = 0;
+    d_mapping = NULL;
+    d_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool mapped_file::open(const char *filename)
+{
+    close();
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if ( (fstat(fd, &info) != 0) || (info.st_size <= 0) ) {
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file open on its own, so the descriptor can go.
+    void *data = mmap(NULL, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    d_data = static_cast<const char *>(data);
+    d_size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void mapped_file::close(void)
+{
+    if (d_data) {
+        munmap(const_cast<char *>(d_data), d_size);
+    }
+    d_data = NULL;
+    d_size = 0;
+}
+
+#endif
@@ -0,0 +1,35 @@
+// A whole file mapped read-only into memory, so that its contents can be
+// read in place without copying them.  Pages are read from disk only as
+// they are touched, so even a very large file opens at once.
+
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <stddef.h>
+
+class mapped_file {
+public:
+    mapped_file();
+    ~mapped_file();
+
+    // Maps the specified file, replacing any mapped before.  Returns false
+    // if it cannot be opened or is empty.
+    bool open(const char *filename);
+    void close(void);
+
+    const char *data(void) const { return d_data; }
+    size_t size(void) const { return d_size; }
+
+private:
+    mapped_file(const mapped_file &);               // Not copyable
+    mapped_file &operator=(const mapped_file &);
+
+    const char  *d_data;
+    size_t      d_size;
+#ifdef _WIN32
+    void        *d_file;        // HANDLE of the file
+    void        *d_mapping;     // HANDLE of its mapping
+#endif
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QList>
+
+#include "model_worker.h"
+#include "result_cache.h"
+
+histogram_snapshot make_histogram_snapshot(const fragment_histogram &histogram)
+{
+    const histogram_layout &layout = histogram.layout();
+    histogram_values_passer *counts = new histogram_values_passer;
+    counts->resize(histogram.binCount());
+    int i;
+    for (i = 0; i < counts->size(); i++) {
+        (*counts)[i] = static_cast<int>(histogram.counts()[i]);
+    }
+    counts->edges = QVector<double>::fromStdVector(layout.edges());
+    counts->min_value = layout.minValue();
+    counts->max_value = layout.maxValue();
+    return histogram_snapshot(counts);
+}
+
+// Results whose last reference has gone, kept for ModelWorker::newResult.
+// That can happen on any thread, and after the worker itself is gone, so
+// the worker and every result it hands out share the recycler.
+class result_recycler {
+public:
+    ~result_recycler() { qDeleteAll(d_idle); }
+
+    // Keeps a released result, or deletes it if enough are kept already.
+    void recycle(model_result *result) {
+        QMutexLocker lock(&d_mutex);
+        if (d_idle.size() < ModelWorker::MAX_IDLE_RESULTS) {
+            d_idle.append(result);
+        } else {
+            delete result;
+        }
+    }
+
+    // Takes a kept result, or returns NULL if there is none.
+    model_result *take(void) {
+        QMutexLocker lock(&d_mutex);
+        return d_idle.isEmpty() ? NULL : d_idle.takeLast();
+    }
+
+private:
+    QMutex                  d_mutex;
+    QList<model_result *>   d_idle;
+};
+
+// Deletes a result by handing it back to the recycler.
+class recycling_deleter {
+public:
+    recycling_deleter(const std::shared_ptr<result_recycler> &recycler) : d_recycler(recycler) {}
+
+    void operator()(model_result *result) const { d_recycler->recycle(result); }
+
+private:
+    std::shared_ptr<result_recycler> d_recycler;
+};
+
+ModelWorker::ModelWorker(const histogram_layout &layout)
+    : d_layout(layout)
+    , d_histogram(layout)
+    , d_recycler(new result_recycler)
+    , d_seed(0)
+    , d_cancel(false)
+    , d_generation(0)
+    , d_pending(false)
+    , d_scheduled(false)
+{
+    qRegisterMetaType<model_result_pointer>("model_result_pointer");
+    d_recent.setMaxCost(MAX_CACHED_KB);
+}
+
+QSharedPointer<model_result> ModelWorker::newResult(void)
+{
+    model_result *result = d_recycler->take();
+    if (result == NULL) {
+        result = new model_result;
+    }
+    return QSharedPointer<model_result>(result, recycling_deleter(d_recycler));
+}
+
+quint64 ModelWorker::request(const chromatin_parameters &params)
+{
+    QMutexLocker lock(&d_mutex);
+    d_params = params;
+    d_generation++;
+    d_pending = true;
+    d_cancel = true;
+
+    // Only queue a call to run() if there is not one on its way already;
+    // it will pick up whatever the latest parameters are when it starts.
+    if (!d_scheduled) {
+        d_scheduled = true;
+        QMetaObject::invokeMethod(this, "run", Qt::QueuedConnection);
+    }
+    return d_generation;
+}
+
+void ModelWorker::cancel(void)
+{
+    QMutexLocker lock(&d_mutex);
+    d_generation++;
+    d_pending = false;
+    d_cancel = true;
+}
+
+void ModelWorker::run(void)
+{
+    while (true) {
+        // Take the latest request, if there is one.  Clearing the cancel
+        // flag here, under the lock, means that only a request made after
+        // this point can set it again.
+        chromatin_parameters params;
+        quint64 generation;
+        {
+            QMutexLocker lock(&d_mutex);
+            if (!d_pending) {
+                d_scheduled = false;
+                return;
+            }
+            params = d_params;
+            generation = d_generation;
+            d_pending = false;
+            d_cancel = false;
+        }
+
+        // Parameters seen recently need nothing built.
+        QString key = QString::fromStdString(result_cache::key(params, d_seed, 1, d_layout));
+        model_result_pointer *recent = d_recent.object(key);
+        if (recent) {
+            emit modelReady(generation, *recent);
+            continue;
+        }
+
+        // Bring our working model up to date, which redoes only what the
+        // changed parameters affect, and publish a copy of it along with a
+        // summary for drawing it zoomed out.  A result that was let go of
+        // is copied over, so its storage only grows when models do.
+        bool cuttable = d_model.updateIncremental(params, d_seed, &d_cancel);
+        if (d_cancel) {
+            continue;
+        }
+        QSharedPointer<model_result> result = newResult();
+        result->seed = d_seed;
+        result->model = d_model;
+        result->summary.build(result->model);
+        result->counts.clear();
+        result->status.clear();
+        if (d_cancel) {
+            continue;
+        }
+        if (!cuttable) {
+            result->status = tr("No cuttable DNA remains: every base pair is wrapped by an attached histone");
+        }
+
+        // Bin the fragment lengths here as well, since for a large model
+        // that takes about as long as making it.
+        if (result->model.cutLocations().size() > 1) {
+            d_histogram.reset(d_layout);
+            result->model.addFragmentLengths(d_histogram);
+            if (d_cancel) {
+                continue;
+            }
+            result->counts = make_histogram_snapshot(d_histogram);
+        }
+
+        size_t kb = (result->model.memoryUsage() + result->summary.memoryUsage()) / 1024 + 1;
+        d_recent.insert(key, new model_result_pointer(result), static_cast<int>(qMin<size_t>(kb, MAX_CACHED_KB)));
+        emit modelReady(generation, result);
+    }
+}
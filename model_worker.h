@@ -0,0 +1,101 @@
+// Regenerates the chromatin model on a thread of its own, so that the
+// window stays responsive while large models are built.
+//
+// Requests are coalesced: asking for a new model while one is being built
+// cancels that one, and if several requests arrive before the worker gets
+// to them only the latest is built.  Each request is given a generation
+// number that comes back with its result, so the receiver can ignore any
+// result that was already on its way when a newer request was made.
+// The worker keeps one model that it updates incrementally, so moving one
+// slider only redoes the part of the model that depends on it.  It also
+// keeps the most recent results, up to MAX_CACHED_KB of them, keyed the
+// same way as a result_cache, so going back to parameters seen before
+// republishes the result rather than building it again.  Results the
+// window and the cache have let go of are kept for reuse, so building the
+// next one copies the model into storage that is already the right size
+// rather than allocating it all again.
+
+#ifndef _MODEL_WORKER_H_
+#define _MODEL_WORKER_H_
+
+#include <atomic>
+#include <memory>
+#include <QObject>
+#include <QMutex>
+#include <QString>
+#include <QSharedPointer>
+#include <QMetaType>
+#include <QCache>
+#include "histogram_values_passer.h"
+#include "chromatin_model.h"
+#include "density_pyramid.h"
+
+// Everything one regeneration produced, handed to the GUI thread as a
+// whole.  The model is not changed once it has been published.
+class model_result {
+public:
+    model_result() : seed(0) {}
+
+    uint64_t                seed;       // Seed the model was made from
+    chromatin_model         model;      // Nucleosome and cut locations
+    density_pyramid         summary;    // Densities along it, for zooming out
+    histogram_snapshot      counts;     // Fragment-length histogram, or null
+    QString                 status;     // Problem to report, or empty
+};
+
+typedef QSharedPointer<const model_result> model_result_pointer;
+Q_DECLARE_METATYPE(model_result_pointer)
+
+// Makes a snapshot of a histogram in the form the histogram display takes.
+histogram_snapshot make_histogram_snapshot(const fragment_histogram &histogram);
+
+class result_recycler;
+
+class ModelWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum { MAX_CACHED_KB = 512 * 1024 };
+    enum { MAX_IDLE_RESULTS = 2 };      // Released results kept for reuse
+
+    // The histogram of each model is binned with the specified layout.
+    ModelWorker(const histogram_layout &layout);
+
+    // Asks for a model with the specified parameters, abandoning any that
+    // is being built.  This may be called from any thread.  Returns the
+    // generation number its result will carry.
+    quint64 request(const chromatin_parameters &params);
+
+    // Abandons any model that is being built or waiting to be built.
+    void cancel(void);
+
+signals:
+    void modelReady(quint64 generation, model_result_pointer result);
+
+private slots:
+    // Builds models until there are no requests waiting.  This runs on
+    // the worker's thread.
+    void run(void);
+
+private:
+    // Returns a result to build into, reusing a released one if there is
+    // one.  Its model and summary hold whatever they last held.
+    QSharedPointer<model_result> newResult(void);
+
+    histogram_layout        d_layout;       // Bins for the histogram
+    fragment_histogram      d_histogram;    // Binned anew for each result
+    chromatin_model         d_model;        // Updated in place for each request
+    std::shared_ptr<result_recycler> d_recycler; // Results let go of, for reuse
+    uint64_t                d_seed;         // Seed for its random streams
+    std::atomic<bool>       d_cancel;       // Tells the running build to stop
+    QCache<QString, model_result_pointer> d_recent; // Results by parameters
+
+    QMutex                  d_mutex;        // Protects the members below
+    chromatin_parameters    d_params;       // Parameters of the latest request
+    quint64                 d_generation;   // Generation of the latest request
+    bool                    d_pending;      // Is a request waiting to be built?
+    bool                    d_scheduled;    // Is run() already queued?
+};
+
+#endif
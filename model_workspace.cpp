@@ -0,0 +1,33 @@
+#include "model_workspace.h"
+#include "digestion_course.h"
+
+model_workspace::model_workspace()
+{
+}
+
+model_workspace::model_workspace(const model_workspace &)
+{
+}
+
+model_workspace &model_workspace::operator=(const model_workspace &)
+{
+    return *this;
+}
+
+model_workspace::~model_workspace()
+{
+}
+
+digestion_course &model_workspace::course(void)
+{
+    if (!d_course) {
+        d_course.reset(new digestion_course);
+    }
+    return *d_course;
+}
+
+size_t model_workspace::memoryUsage(void) const
+{
+    return d_uniforms.capacity() * sizeof(double) + d_cuts.capacity() * sizeof(int64_t)
+         + d_sampler.memoryUsage() + (d_course ? d_course->memoryUsage() : 0);
+}
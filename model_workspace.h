@@ -0,0 +1,68 @@
+// Scratch memory for building a chromatin model.
+//
+// Every stage of building a model fills buffers that are thrown away once
+// it is done: chunks of uniform draws, the histones being detached, the
+// cuts being added or taken out, the links of a digestion course.  A
+// model keeps them in a workspace that lives as long as it does, so
+// regenerating it, or running one replicate after another with it, reuses
+// the memory the largest model so far needed rather than allocating and
+// freeing it every time.  Copying a model does not copy its workspace;
+// the scratch belongs to whoever is building with it.
+
+#ifndef _MODEL_WORKSPACE_H_
+#define _MODEL_WORKSPACE_H_
+
+#include <vector>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include "index_sampler.h"
+#include "fragment_histogram.h"
+
+class digestion_course;
+
+class model_workspace {
+public:
+    model_workspace();
+    model_workspace(const model_workspace &other);
+    model_workspace &operator=(const model_workspace &other);
+    ~model_workspace();
+
+    // Returns room for count uniforms, which is reused by the next call.
+    double *uniforms(size_t count) {
+        if (d_uniforms.size() < count) {
+            d_uniforms.resize(count);
+        }
+        return d_uniforms.empty() ? NULL : &d_uniforms[0];
+    }
+
+    // Returns the cut list, emptied, with room for count cuts.
+    std::vector<int64_t> &cuts(size_t count) {
+        d_cuts.clear();
+        d_cuts.reserve(count);
+        return d_cuts;
+    }
+
+    // Returns the sampler, reset to draw count of [0, n).
+    index_sampler &sampler(uint64_t n, uint64_t count) {
+        d_sampler.reset(n);
+        d_sampler.reserve(count);
+        return d_sampler;
+    }
+
+    // The digestion course and the histogram it keeps up to date.
+    digestion_course &course(void);
+    fragment_histogram &histogram(void) { return d_histogram; }
+
+    // Bytes of scratch being kept.
+    size_t memoryUsage(void) const;
+
+private:
+    std::vector<double>                 d_uniforms;
+    std::vector<int64_t>                d_cuts;
+    index_sampler                       d_sampler;
+    std::unique_ptr<digestion_course>   d_course;   // Made the first time it is needed
+    fragment_histogram                  d_histogram;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include <algorithm>
+
+#include "nucleosome_array.h"
+
+nucleosome_array::nucleosome_array()
+{
+    reset(0);
+}
+
+void nucleosome_array::reset(int bpPerNucleosome)
+{
+    d_bpPerNucleosome = bpPerNucleosome;
+    d_lastLocation = 0;
+    d_linkers.clear();
+    d_attached.clear();
+    d_blockStarts.clear();
+}
+
+void nucleosome_array::reserve(size_t count)
+{
+    d_linkers.reserve(count);
+    d_attached.reserve((count + 63) / 64);
+    d_blockStarts.reserve((count + BLOCK_SIZE - 1) / BLOCK_SIZE);
+}
+
+void nucleosome_array::push_back(int linker_length)
+{
+    size_t i = d_linkers.size();
+    if (i % BLOCK_SIZE == 0) {
+        d_blockStarts.push_back(d_lastLocation);
+    }
+    if (i % 64 == 0) {
+        d_attached.push_back(0);
+    }
+    d_linkers.push_back(static_cast<uint16_t>(linker_length));
+    d_attached.edit()[i >> 6] |= static_cast<uint64_t>(1) << (i & 63);
+    d_lastLocation += linker_length + d_bpPerNucleosome;
+}
+
+int64_t nucleosome_array::location(size_t i) const
+{
+    size_t j = i - (i % BLOCK_SIZE);
+    int64_t loc = d_blockStarts[j / BLOCK_SIZE];
+    for (; j <= i; j++) {
+        loc += d_linkers[j] + d_bpPerNucleosome;
+    }
+    return loc;
+}
+
+void nucleosome_array::setAttached(size_t i, bool attached)
+{
+    uint64_t bit = static_cast<uint64_t>(1) << (i & 63);
+    if (attached) {
+        d_attached.edit()[i >> 6] |= bit;
+    } else {
+        d_attached.edit()[i >> 6] &= ~bit;
+    }
+}
+
+void nucleosome_array::setAllAttached(bool attached)
+{
+    uint64_t *words = d_attached.edit();
+    std::fill(words, words + d_attached.size(), attached ? ~static_cast<uint64_t>(0) : 0);
+}
+
+bool nucleosome_array::assign(int bpPerNucleosome, const column<uint16_t> &linkers,
+                              const column<uint64_t> &attached, const column<int64_t> &blockStarts)
+{
+    reset(bpPerNucleosome);
+    const size_t count = linkers.size();
+    if ( (attached.size() != (count + 63) / 64)
+         || (blockStarts.size() != (count + BLOCK_SIZE - 1) / BLOCK_SIZE) ) {
+        return false;
+    }
+    d_linkers = linkers;
+    d_attached = attached;
+    d_blockStarts = blockStarts;
+    d_lastLocation = (count > 0) ? location(count - 1) : 0;
+    return true;
+}
+
+size_t nucleosome_array::lowerBound(int64_t loc) const
+{
+    // Every nucleosome in a block lies after that block's start, so the
+    // answer is in the last block that starts before loc (or is the end).
+    const int64_t *b = std::lower_bound(d_blockStarts.begin(), d_blockStarts.end(), loc);
+    if (b == d_blockStarts.begin()) {
+        return 0;
+    }
+    size_t i = ((b - d_blockStarts.begin()) - 1) * BLOCK_SIZE;
+    int64_t here = *(b - 1);
+    for (; i < d_linkers.size(); i++) {
+        here += d_linkers[i] + d_bpPerNucleosome;
+        if (here >= loc) {
+            return i;
+        }
+    }
+    return d_linkers.size();
+}
+
+size_t nucleosome_array::memoryUsage(void) const
+{
+    return d_linkers.capacity() * sizeof(uint16_t)
+         + d_attached.capacity() * sizeof(uint64_t)
+         + d_blockStarts.capacity() * sizeof(int64_t);
+}
+
+nucleosome_array::cursor::cursor(const nucleosome_array &array, size_t start)
+    : d_array(&array)
+    , d_index(start)
+    , d_location(0)
+{
+    if (!done()) {
+        d_location = array.location(start);
+    }
+}
+
+void nucleosome_array::cursor::next(void)
+{
+    d_index++;
+    if (!done()) {
+        d_location += d_array->d_linkers[d_index] + d_array->d_bpPerNucleosome;
+    }
+}
@@ -0,0 +1,114 @@
+// Compact storage for the nucleosomes of a chromatin model.
+//
+// Rather than keeping a 64-bit location and a flag for each nucleosome,
+// this stores the 16-bit linker length before each one, a packed bitset
+// of which are attached, and the absolute location once every
+// BLOCK_SIZE nucleosomes so that any location can be recovered with a
+// short scan.  That is a little over 2 bytes per nucleosome, which keeps a
+// whole genome's worth (about 18 million) in a few tens of megabytes.
+// The three are columns, so they can also be read in place from a
+// mapped run file.
+
+#ifndef _NUCLEOSOME_ARRAY_H_
+#define _NUCLEOSOME_ARRAY_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "column.h"
+
+// One nucleosome, as returned when looking one up in the array.
+class nucleosome {
+public:
+    int64_t location;   // Index of the last base pair wrapped around the nucleosome
+    bool attached;      // Stores whether it is attached or not.
+
+    bool operator < (const nucleosome &n) const { return location < n.location; }
+    bool operator < (const int64_t num) const { return location < num; }
+};
+
+class nucleosome_array {
+public:
+    enum { BLOCK_SIZE = 64 };           // Nucleosomes per stored location
+    enum { MAX_LINKER = 65535 };        // Longest linker that can be stored
+
+    nucleosome_array();
+
+    // Removes all nucleosomes; each one added afterwards wraps the
+    // specified number of base pairs.
+    void reset(int bpPerNucleosome);
+    void reserve(size_t count);
+
+    // Adds an attached nucleosome after a linker of the specified length
+    // (at most MAX_LINKER) following the previous one.
+    void push_back(int linker_length);
+
+    size_t size(void) const { return d_linkers.size(); }
+    int bpPerNucleosome(void) const { return d_bpPerNucleosome; }
+
+    // Index of the last base pair wrapped around nucleosome i.
+    int64_t location(size_t i) const;
+
+    nucleosome operator[](size_t i) const {
+        nucleosome n;
+        n.location = location(i);
+        n.attached = attached(i);
+        return n;
+    }
+
+    // Length of the linker before nucleosome i.
+    int linkerLength(size_t i) const { return d_linkers[i]; }
+
+    bool attached(size_t i) const {
+        return (d_attached[i >> 6] >> (i & 63)) & 1;
+    }
+    void setAttached(size_t i, bool attached);
+    void setAllAttached(bool attached);
+
+    // The stored columns: the linker length before each nucleosome, the
+    // attached bits packed 64 to a word, and the location before the first
+    // nucleosome of each block.
+    const column<uint16_t> &linkerColumn(void) const { return d_linkers; }
+    const column<uint64_t> &attachedColumn(void) const { return d_attached; }
+    const column<int64_t> &blockStartColumn(void) const { return d_blockStarts; }
+
+    // Replaces the nucleosomes with ones stored as above, such as columns
+    // viewing a run file.  Returns false, leaving the array empty, if the
+    // columns do not have matching sizes.
+    bool assign(int bpPerNucleosome, const column<uint16_t> &linkers,
+                const column<uint64_t> &attached, const column<int64_t> &blockStarts);
+
+    // Index of the first nucleosome whose location is at or after loc, or
+    // size() if there is none.
+    size_t lowerBound(int64_t loc) const;
+
+    // Bytes used to store the nucleosomes.
+    size_t memoryUsage(void) const;
+
+    // Walks the nucleosomes in order, keeping a running location so that
+    // each step is constant time.
+    class cursor {
+    public:
+        cursor(const nucleosome_array &array, size_t start = 0);
+
+        bool done(void) const { return d_index >= d_array->size(); }
+        size_t index(void) const { return d_index; }
+        int64_t location(void) const { return d_location; }
+        bool attached(void) const { return d_array->attached(d_index); }
+        void next(void);
+
+    private:
+        const nucleosome_array  *d_array;
+        size_t                  d_index;
+        int64_t                 d_location;
+    };
+
+private:
+    int                     d_bpPerNucleosome;
+    int64_t                 d_lastLocation;     // Location of the last nucleosome added
+    column<uint16_t>        d_linkers;          // Linker length before each nucleosome
+    column<uint64_t>        d_attached;         // One bit per nucleosome
+    column<int64_t>         d_blockStarts;      // Location before the first nucleosome of each block
+};
+
+#endif
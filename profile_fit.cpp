@@ -0,0 +1,394 @@
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+#include "profile_fit.h"
+#include "thread_pool.h"
+
+//----------------------------------------------------------------------
+// Reading and comparing profiles
+
+bool read_measured_profile(const char *filename, measured_profile &profile)
+{
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    // Read every data line, noting how many columns the first one had.
+    std::vector<double> first, second, third;
+    int columns = 0;
+    bool ok = true;
+    char line[1024];
+    while (ok && fgets(line, sizeof(line), f)) {
+        double a, b, c;
+        const char *p = line;
+        while ((*p == ' ') || (*p == '\t')) { p++; }
+        if ((*p == '#') || (*p == '\n') || (*p == '\r') || (*p == '\0')) {
+            continue;
+        }
+        int found = sscanf(p, "%lf %lf %lf", &a, &b, &c);
+        if (columns == 0) {
+            columns = found;
+        }
+        ok = (found == columns) && (columns >= 2);
+        first.push_back(a);
+        second.push_back(b);
+        if (columns == 3) {
+            third.push_back(c);
+        }
+    }
+    fclose(f);
+    if (!ok || (first.size() < 2)) {
+        return false;
+    }
+
+    std::vector<double> edges;
+    const std::vector<double> &values = (columns == 3) ? third : second;
+    size_t i;
+    if (columns == 3) {
+        for (i = 0; i < first.size(); i++) {
+            if ( (second[i] <= first[i]) || ((i > 0) && (first[i] != second[i-1])) ) {
+                return false;
+            }
+            edges.push_back(first[i]);
+        }
+        edges.push_back(second.back());
+    } else {
+        for (i = 0; i < first.size(); i++) {
+            if ( (first[i] <= 0) || ((i > 0) && (first[i] <= first[i-1])) ) {
+                return false;
+            }
+        }
+        edges.push_back(first[0] * first[0] / sqrt(first[0] * first[1]));
+        for (i = 1; i < first.size(); i++) {
+            edges.push_back(sqrt(first[i-1] * first[i]));
+        }
+        size_t n = first.size();
+        edges.push_back(first[n-1] * first[n-1] / sqrt(first[n-2] * first[n-1]));
+    }
+
+    double total = 0;
+    for (i = 0; i < values.size(); i++) {
+        if (values[i] < 0) {
+            return false;
+        }
+        total += values[i];
+    }
+    if (total <= 0) {
+        return false;
+    }
+    profile.layout = histogram_layout::custom(edges);
+    profile.density.resize(values.size());
+    for (i = 0; i < values.size(); i++) {
+        profile.density[i] = values[i] / total;
+    }
+    return true;
+}
+
+double profile_distance(const measured_profile &profile, const fragment_histogram &histogram)
+{
+    const std::vector<uint64_t> &counts = histogram.counts();
+    double total = 0;
+    size_t i;
+    for (i = 0; i < counts.size(); i++) {
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 2;
+    }
+    double distance = 0;
+    for (i = 0; i < counts.size(); i++) {
+        double diff = counts[i] / total - profile.density[i];
+        distance += diff * diff;
+    }
+    return distance;
+}
+
+fit_options::fit_options()
+    : parameters(FIT_MISSING | FIT_VARIANCE | FIT_CUTS)
+    , seed(1)
+    , num_replicates(4)
+    , num_threads(0)
+    , max_evaluations(400)
+    , tolerance(1e-9)
+{
+}
+
+//----------------------------------------------------------------------
+// Evaluating batches of points
+
+// Evaluates batches of parameter sets with common random numbers.  There
+// is one incremental model for each replicate and place in a batch, kept
+// from one batch to the next.
+class batch_evaluator {
+public:
+    batch_evaluator(const measured_profile &profile, const fit_options &options)
+        : d_profile(profile), d_options(options), d_places(0), d_evaluations(0) {}
+    ~batch_evaluator();
+
+    // Fills in the distance of each point from the profile.
+    void evaluate(const std::vector<chromatin_parameters> &points, std::vector<double> &distances);
+
+    // Fills in the merged histogram for one point.
+    void histogram(const chromatin_parameters &params, fragment_histogram &merged);
+
+    int evaluations(void) const { return d_evaluations; }
+
+private:
+    // Seed for replicate r; every point uses the same ones.
+    uint64_t replicateSeed(int r) const {
+        return d_options.seed ^ (static_cast<uint64_t>(r + 1) * 0x9E3779B97F4A7C15ULL);
+    }
+
+    void run(const std::vector<chromatin_parameters> &points,
+             std::vector<fragment_histogram> &merged);
+
+    const measured_profile     &d_profile;
+    const fit_options          &d_options;
+    std::vector<chromatin_model *>  d_models;   // Replicate-major, by place in batch
+    size_t                      d_places;       // Places in batch per replicate
+    int                         d_evaluations;
+};
+
+batch_evaluator::~batch_evaluator()
+{
+    size_t i;
+    for (i = 0; i < d_models.size(); i++) {
+        delete d_models[i];
+    }
+}
+
+void batch_evaluator::run(const std::vector<chromatin_parameters> &points,
+                          std::vector<fragment_histogram> &merged)
+{
+    const int num_replicates = d_options.num_replicates;
+    const int num_points = static_cast<int>(points.size());
+
+    // Grow the set of models if this batch is larger than any before.
+    if (points.size() > d_places) {
+        size_t i;
+        for (i = 0; i < d_models.size(); i++) {
+            delete d_models[i];
+        }
+        d_places = points.size();
+        d_models.resize(num_replicates * d_places);
+        for (i = 0; i < d_models.size(); i++) {
+            d_models[i] = new chromatin_model;
+        }
+    }
+
+    // Each (replicate, point) pair is a task with its own model and
+    // histogram; the histograms are merged in replicate order afterwards.
+    std::vector<fragment_histogram> partial(num_replicates * num_points,
+                                            fragment_histogram(d_profile.layout));
+    std::function<void(int)> task = [&](int t) {
+        int r = t / num_points;
+        int p = t % num_points;
+        chromatin_model &model = *d_models[r * d_places + p];
+        // A model with no cuttable DNA adds no fragments, which leaves the
+        // point as far from the profile as can be.
+        if (model.updateIncremental(points[p], replicateSeed(r))) {
+            model.addFragmentLengths(partial[t]);
+        }
+    };
+    run_work_stealing(num_replicates * num_points, d_options.num_threads, task);
+
+    merged.assign(num_points, fragment_histogram(d_profile.layout));
+    int r, p;
+    for (r = 0; r < num_replicates; r++) {
+        for (p = 0; p < num_points; p++) {
+            merged[p].merge(partial[r * num_points + p]);
+        }
+    }
+    d_evaluations += num_points;
+}
+
+void batch_evaluator::evaluate(const std::vector<chromatin_parameters> &points,
+                               std::vector<double> &distances)
+{
+    std::vector<fragment_histogram> merged;
+    run(points, merged);
+    distances.resize(points.size());
+    size_t i;
+    for (i = 0; i < points.size(); i++) {
+        distances[i] = profile_distance(d_profile, merged[i]);
+    }
+}
+
+void batch_evaluator::histogram(const chromatin_parameters &params, fragment_histogram &merged)
+{
+    std::vector<fragment_histogram> all;
+    run(std::vector<chromatin_parameters>(1, params), all);
+    merged = all[0];
+}
+
+//----------------------------------------------------------------------
+// Nelder-Mead
+
+// Maps between a point of the simplex and the parameters it stands for,
+// keeping each parameter within its bounds.
+class fit_space {
+public:
+    fit_space(const chromatin_parameters &base, int which) : d_base(base), d_which(which) {}
+
+    size_t dimensions(void) const {
+        return ((d_which & FIT_MISSING) ? 1 : 0) + ((d_which & FIT_VARIANCE) ? 1 : 0)
+             + ((d_which & FIT_CUTS) ? 1 : 0);
+    }
+
+    std::vector<double> point(const chromatin_parameters &params) const {
+        std::vector<double> x;
+        if (d_which & FIT_MISSING) { x.push_back(params.missingHistonePercent); }
+        if (d_which & FIT_VARIANCE) { x.push_back(params.nucleosomeSpacingVariance); }
+        if (d_which & FIT_CUTS) { x.push_back(params.cutsPer3kBasePairs); }
+        return x;
+    }
+
+    // Initial step along each dimension.
+    std::vector<double> steps(const chromatin_parameters &params) const {
+        std::vector<double> s;
+        if (d_which & FIT_MISSING) { s.push_back(params.missingHistonePercent < 50 ? 10 : -10); }
+        if (d_which & FIT_VARIANCE) { s.push_back(std::max(5.0, params.nucleosomeSpacingVariance / 2)); }
+        if (d_which & FIT_CUTS) { s.push_back(std::max(0.1, params.cutsPer3kBasePairs / 2)); }
+        return s;
+    }
+
+    // Clamps the point into bounds and returns its parameters.
+    chromatin_parameters params(std::vector<double> &x) const {
+        chromatin_parameters p = d_base;
+        size_t i = 0;
+        if (d_which & FIT_MISSING) {
+            x[i] = std::min(100.0, std::max(0.0, x[i]));
+            p.missingHistonePercent = x[i++];
+        }
+        if (d_which & FIT_VARIANCE) {
+            x[i] = std::max(0.0, x[i]);
+            p.nucleosomeSpacingVariance = x[i++];
+        }
+        if (d_which & FIT_CUTS) {
+            x[i] = std::max(0.01, x[i]);
+            p.cutsPer3kBasePairs = x[i++];
+        }
+        return p;
+    }
+
+private:
+    chromatin_parameters    d_base;
+    int                     d_which;
+};
+
+// Returns a + scale * (a - b).
+static std::vector<double> step_from(const std::vector<double> &a, const std::vector<double> &b,
+                                     double scale)
+{
+    std::vector<double> x(a.size());
+    size_t i;
+    for (i = 0; i < a.size(); i++) {
+        x[i] = a[i] + scale * (a[i] - b[i]);
+    }
+    return x;
+}
+
+bool fit_profile(const measured_profile &profile, const chromatin_parameters &start,
+                 const fit_options &options, fit_result &result)
+{
+    fit_space space(start, options.parameters);
+    const size_t n = space.dimensions();
+    if (n == 0) {
+        return false;
+    }
+    batch_evaluator evaluator(profile, options);
+
+    // The first simplex is the starting point and one step along each
+    // dimension from it, all evaluated together.
+    std::vector< std::vector<double> > simplex(n + 1, space.point(start));
+    std::vector<double> steps = space.steps(start);
+    std::vector<chromatin_parameters> batch(n + 1);
+    size_t i, j;
+    for (i = 0; i <= n; i++) {
+        if (i > 0) {
+            simplex[i][i-1] += steps[i-1];
+        }
+        batch[i] = space.params(simplex[i]);
+    }
+    std::vector<double> values;
+    evaluator.evaluate(batch, values);
+
+    while (evaluator.evaluations() < options.max_evaluations) {
+
+        // Order the simplex from best to worst.
+        std::vector<size_t> order(n + 1);
+        for (i = 0; i <= n; i++) { order[i] = i; }
+        std::sort(order.begin(), order.end(),
+                  [&](size_t a, size_t b) { return values[a] < values[b]; });
+        std::vector< std::vector<double> > sorted_simplex(n + 1);
+        std::vector<double> sorted_values(n + 1);
+        for (i = 0; i <= n; i++) {
+            sorted_simplex[i] = simplex[order[i]];
+            sorted_values[i] = values[order[i]];
+        }
+        simplex.swap(sorted_simplex);
+        values.swap(sorted_values);
+        if (values[n] - values[0] <= options.tolerance) {
+            break;
+        }
+
+        // Try every move the step might take at once: reflection,
+        // expansion, and the outside and inside contractions.
+        std::vector<double> centroid(n, 0.0);
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < n; j++) {
+                centroid[j] += simplex[i][j] / n;
+            }
+        }
+        std::vector< std::vector<double> > moves;
+        moves.push_back(step_from(centroid, simplex[n], 1.0));
+        moves.push_back(step_from(centroid, simplex[n], 2.0));
+        moves.push_back(step_from(centroid, simplex[n], 0.5));
+        moves.push_back(step_from(centroid, simplex[n], -0.5));
+        batch.resize(moves.size());
+        for (i = 0; i < moves.size(); i++) {
+            batch[i] = space.params(moves[i]);
+        }
+        std::vector<double> move_values;
+        evaluator.evaluate(batch, move_values);
+        const double reflected = move_values[0], expanded = move_values[1];
+        const double outside = move_values[2], inside = move_values[3];
+
+        int accept = -1;
+        if (reflected < values[0]) {
+            accept = (expanded < reflected) ? 1 : 0;
+        } else if (reflected < values[n-1]) {
+            accept = 0;
+        } else if (reflected < values[n]) {
+            accept = (outside <= reflected) ? 2 : -1;
+        } else {
+            accept = (inside < values[n]) ? 3 : -1;
+        }
+        if (accept >= 0) {
+            simplex[n] = moves[accept];
+            values[n] = move_values[accept];
+            continue;
+        }
+
+        // Nothing helped, so shrink everything towards the best point.
+        batch.resize(n);
+        for (i = 1; i <= n; i++) {
+            simplex[i] = step_from(simplex[0], simplex[i], -0.5);
+            batch[i-1] = space.params(simplex[i]);
+        }
+        std::vector<double> shrunk;
+        evaluator.evaluate(batch, shrunk);
+        for (i = 1; i <= n; i++) {
+            values[i] = shrunk[i-1];
+        }
+    }
+
+    size_t best = std::min_element(values.begin(), values.end()) - values.begin();
+    result.params = space.params(simplex[best]);
+    result.distance = values[best];
+    result.evaluations = evaluator.evaluations();
+    evaluator.histogram(result.params, result.histogram);
+    return true;
+}
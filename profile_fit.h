@@ -0,0 +1,78 @@
+// Fits the model parameters to a measured fragment-length profile, such
+// as one read off a gel, by searching for the parameters whose simulated
+// histogram is closest to it.
+//
+// The search is Nelder-Mead over the chosen parameters.  Every evaluation
+// uses the same random numbers (common random numbers): replicate r of
+// every point is generated by updateIncremental from the same seed, so
+// two points differ only because their parameters do, and the objective
+// is a deterministic function the simplex can follow.  Each step asks for
+// all of the points it might need at once (reflection, expansion and both
+// contractions, or the whole shrunken simplex) and evaluates that batch
+// in parallel, one task per replicate and point.  Each task keeps its own
+// incremental model between steps, so nucleosome positions are reused
+// whenever the spacing variance has not changed.
+
+#ifndef _PROFILE_FIT_H_
+#define _PROFILE_FIT_H_
+
+#include <vector>
+#include <stdint.h>
+#include "chromatin_model.h"
+
+// A measured density of fragments in each of a set of bins.
+class measured_profile {
+public:
+    histogram_layout    layout;
+    std::vector<double> density;    // One per bin, summing to one
+};
+
+// Reads a profile from a text file.  Each line that is not blank or a
+// '#' comment holds either "bin_min_bp bin_max_bp value", with the bins
+// adjacent (as the batch driver writes them), or "length_bp value", in
+// which case the bin edges are placed halfway between successive lengths
+// on a log scale.  The values may be counts or densities; they are
+// normalized.  Returns false if the file cannot be read or makes no sense.
+bool read_measured_profile(const char *filename, measured_profile &profile);
+
+// Returns the squared distance between the profile and the normalized
+// counts of a histogram with the same layout, summed over the bins.
+// Fragments outside the bins are ignored.  A histogram with no fragments
+// in the bins is as far away as can be (2).
+double profile_distance(const measured_profile &profile, const fragment_histogram &histogram);
+
+// Which parameters the fit may change.
+enum fit_parameter {
+    FIT_MISSING = 1,        // missingHistonePercent, in [0, 100]
+    FIT_VARIANCE = 2,       // nucleosomeSpacingVariance, at least 0
+    FIT_CUTS = 4            // cutsPer3kBasePairs, at least 0.01
+};
+
+class fit_options {
+public:
+    fit_options();
+
+    int         parameters;         // Bitwise or of fit_parameter values
+    uint64_t    seed;               // Seed for the common random numbers
+    int         num_replicates;     // Models merged for each evaluation
+    int         num_threads;        // 0 or less uses all cores
+    int         max_evaluations;    // Stop after about this many
+    double      tolerance;          // Stop when the simplex distances are this close
+};
+
+class fit_result {
+public:
+    fit_result() : distance(0), evaluations(0) {}
+
+    chromatin_parameters    params;     // Best parameters found
+    double                  distance;   // Their distance from the profile
+    int                     evaluations;
+    fragment_histogram      histogram;  // Their simulated histogram
+};
+
+// Searches for the parameters closest to the profile, starting from the
+// specified ones.  Returns false if no parameters were chosen to fit.
+bool fit_profile(const measured_profile &profile, const chromatin_parameters &start,
+                 const fit_options &options, fit_result &result);
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <memory>
+
+#include "profiler.h"
+
+std::atomic<bool>       profiler::s_enabled(false);
+std::atomic<bool>       profiler::s_tracing(false);
+std::atomic<uint64_t>   profiler::s_calls[NUM_PHASES];
+std::atomic<int64_t>    profiler::s_nanoseconds[NUM_PHASES];
+std::atomic<uint64_t>   profiler::s_counts[NUM_COUNTERS];
+
+static const char *PHASE_NAMES[NUM_PHASES] = {
+    "model", "positions", "detach", "cuttable_index", "cuts", "sort",
+    "stream", "fragments", "binning", "summary", "replot", "paint"
+};
+
+static const char *COUNTER_NAMES[NUM_COUNTERS] = {
+    "nucleosomes", "detached", "reattached", "cuts", "fragments", "duplicate_cuts"
+};
+
+//----------------------------------------------------------------------
+// The spans kept while tracing.  Each thread appends to a buffer of its
+// own, found through a thread-local pointer, so threads only share the
+// list of buffers, which is locked when a thread first traces and when
+// the trace is written.  A buffer's own lock is only ever contended by
+// the writer.
+
+class trace_span {
+public:
+    int     phase;
+    int64_t start;      // Nanoseconds since the trace began
+    int64_t duration;
+};
+
+class trace_buffer {
+public:
+    trace_buffer() : dropped(0) {}
+
+    std::mutex              lock;
+    std::vector<trace_span> spans;
+    uint64_t                dropped;    // Spans beyond MAX_TRACE_EVENTS
+};
+
+static std::mutex                           buffers_lock;
+static std::vector< std::unique_ptr<trace_buffer> > buffers;   // Index is the thread's track
+static std::atomic<int64_t>                 trace_start(0);
+static thread_local trace_buffer            *this_thread_buffer = NULL;
+
+static trace_buffer &thread_buffer(void)
+{
+    if (this_thread_buffer == NULL) {
+        std::lock_guard<std::mutex> guard(buffers_lock);
+        buffers.push_back(std::unique_ptr<trace_buffer>(new trace_buffer));
+        this_thread_buffer = buffers.back().get();
+    }
+    return *this_thread_buffer;
+}
+
+//----------------------------------------------------------------------
+
+profile_totals::profile_totals()
+{
+    int i;
+    for (i = 0; i < NUM_PHASES; i++) {
+        calls[i] = 0;
+        nanoseconds[i] = 0;
+    }
+    for (i = 0; i < NUM_COUNTERS; i++) {
+        counts[i] = 0;
+    }
+}
+
+void profiler::setEnabled(bool on)
+{
+    s_enabled.store(on);
+    if (!on) {
+        s_tracing.store(false);
+    }
+}
+
+void profiler::setTracing(bool on)
+{
+    if (on) {
+        trace_start.store(now());
+        s_enabled.store(true);
+    }
+    s_tracing.store(on);
+}
+
+void profiler::reset(void)
+{
+    int i;
+    for (i = 0; i < NUM_PHASES; i++) {
+        s_calls[i].store(0);
+        s_nanoseconds[i].store(0);
+    }
+    for (i = 0; i < NUM_COUNTERS; i++) {
+        s_counts[i].store(0);
+    }
+    std::lock_guard<std::mutex> guard(buffers_lock);
+    size_t b;
+    for (b = 0; b < buffers.size(); b++) {
+        std::lock_guard<std::mutex> buffer_guard(buffers[b]->lock);
+        buffers[b]->spans.clear();
+        buffers[b]->dropped = 0;
+    }
+    trace_start.store(now());
+}
+
+void profiler::totals(profile_totals &result)
+{
+    int i;
+    for (i = 0; i < NUM_PHASES; i++) {
+        result.calls[i] = s_calls[i].load(std::memory_order_relaxed);
+        result.nanoseconds[i] = s_nanoseconds[i].load(std::memory_order_relaxed);
+    }
+    for (i = 0; i < NUM_COUNTERS; i++) {
+        result.counts[i] = s_counts[i].load(std::memory_order_relaxed);
+    }
+}
+
+const char *profiler::phaseName(profile_phase phase)
+{
+    return PHASE_NAMES[phase];
+}
+
+const char *profiler::counterName(profile_counter counter)
+{
+    return COUNTER_NAMES[counter];
+}
+
+int64_t profiler::now(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profiler::record(profile_phase phase, int64_t start, int64_t end)
+{
+    s_calls[phase].fetch_add(1, std::memory_order_relaxed);
+    s_nanoseconds[phase].fetch_add(end - start, std::memory_order_relaxed);
+    if (!s_tracing.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    trace_buffer &buffer = thread_buffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    if (buffer.spans.size() >= MAX_TRACE_EVENTS) {
+        buffer.dropped++;
+        return;
+    }
+    trace_span span;
+    span.phase = phase;
+    span.start = start - trace_start.load(std::memory_order_relaxed);
+    span.duration = end - start;
+    buffer.spans.push_back(span);
+}
+
+bool profiler::writeTrace(const char *filename)
+{
+    FILE *f = fopen(filename, "w");
+    if (f == NULL) {
+        return false;
+    }
+
+    // Complete ("X") events, with times in microseconds, then a name for
+    // each thread's track and the counts as a counter ("C") event at the
+    // end of the trace.
+    fprintf(f, "{\"traceEvents\":[\n");
+    int64_t last = 0;
+    uint64_t dropped = 0;
+    std::lock_guard<std::mutex> guard(buffers_lock);
+    size_t b, s;
+    for (b = 0; b < buffers.size(); b++) {
+        std::lock_guard<std::mutex> buffer_guard(buffers[b]->lock);
+        const std::vector<trace_span> &spans = buffers[b]->spans;
+        for (s = 0; s < spans.size(); s++) {
+            fprintf(f, "{\"name\":\"%s\",\"cat\":\"chromatin\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                       "\"pid\":1,\"tid\":%u},\n",
+                    PHASE_NAMES[spans[s].phase], spans[s].start / 1e3, spans[s].duration / 1e3,
+                    static_cast<unsigned>(b));
+            if (spans[s].start + spans[s].duration > last) {
+                last = spans[s].start + spans[s].duration;
+            }
+        }
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                   "\"args\":{\"name\":\"thread %u\"}},\n",
+                static_cast<unsigned>(b), static_cast<unsigned>(b));
+        dropped += buffers[b]->dropped;
+    }
+    fprintf(f, "{\"name\":\"counts\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":0,\"args\":{", last / 1e3);
+    int i;
+    for (i = 0; i < NUM_COUNTERS; i++) {
+        fprintf(f, "%s\"%s\":%llu", (i > 0) ? "," : "", COUNTER_NAMES[i],
+                static_cast<unsigned long long>(s_counts[i].load()));
+    }
+    fprintf(f, "}}\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_spans\":%llu}}\n",
+            static_cast<unsigned long long>(dropped));
+
+    bool ok = (ferror(f) == 0);
+    return (fclose(f) == 0) && ok;
+}
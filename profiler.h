@@ -0,0 +1,132 @@
+// Timing of the phases of building and showing a model, and counts of the
+// work each one does, so that when things stall we can see where the time
+// goes.  A scoped_timer around a phase adds its time to that phase's
+// totals, which the GUI shows as they change; when tracing, each timed
+// span is also kept, by thread, so that a headless run can write them all
+// as a Chrome trace (chrome://tracing or Perfetto opens it).
+//
+// Nothing is recorded until profiling is enabled.  Until then a timer or
+// count costs one relaxed load of a flag, and the timers are only placed
+// around whole phases, never inside the per-nucleosome or per-cut loops.
+// Building with CHROMATIN_NO_PROFILING (CONFIG+=noprofiling) removes even
+// that.
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <atomic>
+#include <stdint.h>
+
+enum profile_phase {
+    PHASE_MODEL,        // Building a whole model, around the phases below
+    PHASE_POSITIONS,    // Laying out the nucleosomes
+    PHASE_DETACH,       // Detaching and reattaching histones
+    PHASE_CUTTABLE,     // Indexing the DNA left uncovered
+    PHASE_CUTS,         // Drawing cut locations
+    PHASE_SORT,         // Sorting and merging the cuts
+    PHASE_STREAM,       // Drawing cuts and counting their fragments in one pass
+    PHASE_FRAGMENTS,    // Measuring the fragments between stored cuts
+    PHASE_BINNING,      // Turning fragment lengths into a histogram
+    PHASE_SUMMARY,      // Building the density summary for drawing
+    PHASE_REPLOT,       // Replotting the histogram
+    PHASE_PAINT,        // Drawing the strand
+    NUM_PHASES
+};
+
+enum profile_counter {
+    COUNT_NUCLEOSOMES,  // Nucleosomes laid out
+    COUNT_DETACHED,     // Histones detached
+    COUNT_REATTACHED,   // Histones reattached by an incremental update
+    COUNT_CUTS,         // Cut locations drawn
+    COUNT_FRAGMENTS,    // Fragments measured
+    COUNT_DUPLICATE_CUTS,   // Cuts that landed on an earlier cut and made no fragment
+    NUM_COUNTERS
+};
+
+// Totals since profiling was last reset.
+class profile_totals {
+public:
+    profile_totals();
+
+    uint64_t    calls[NUM_PHASES];
+    int64_t     nanoseconds[NUM_PHASES];
+    uint64_t    counts[NUM_COUNTERS];
+};
+
+class profiler {
+public:
+    enum { MAX_TRACE_EVENTS = 1 << 20 };    // Spans kept per thread; later ones are dropped
+
+    static bool enabled(void) {
+#ifdef CHROMATIN_NO_PROFILING
+        return false;
+#else
+        return s_enabled.load(std::memory_order_relaxed);
+#endif
+    }
+
+    // Starts or stops adding up the phase times and counts.
+    static void setEnabled(bool on);
+
+    // Starts or stops keeping every timed span for writeTrace(); this
+    // enables profiling as well when it is turned on.
+    static void setTracing(bool on);
+
+    // Clears the totals and any spans kept.
+    static void reset(void);
+
+    static void count(profile_counter counter, uint64_t n) {
+        if (enabled()) {
+            s_counts[counter].fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    // Copies the current totals.
+    static void totals(profile_totals &result);
+
+    // Writes the spans kept, one track per thread, and the final counts as
+    // Chrome trace JSON.  Returns false if the file could not be written.
+    static bool writeTrace(const char *filename);
+
+    static const char *phaseName(profile_phase phase);
+    static const char *counterName(profile_counter counter);
+
+    // Nanoseconds on a steady clock.
+    static int64_t now(void);
+
+    // Adds a span of the specified phase, started and ended at times from
+    // now(), to the totals and, when tracing, to this thread's spans.
+    static void record(profile_phase phase, int64_t start, int64_t end);
+
+private:
+    static std::atomic<bool>        s_enabled;
+    static std::atomic<bool>        s_tracing;
+    static std::atomic<uint64_t>    s_calls[NUM_PHASES];
+    static std::atomic<int64_t>     s_nanoseconds[NUM_PHASES];
+    static std::atomic<uint64_t>    s_counts[NUM_COUNTERS];
+};
+
+// Times the phase from construction to destruction.
+class scoped_timer {
+public:
+    explicit scoped_timer(profile_phase phase)
+        : d_phase(phase)
+        , d_start(profiler::enabled() ? profiler::now() : -1)
+    {
+    }
+
+    ~scoped_timer() {
+        if (d_start >= 0) {
+            profiler::record(d_phase, d_start, profiler::now());
+        }
+    }
+
+private:
+    scoped_timer(const scoped_timer &);             // Not copyable
+    scoped_timer &operator=(const scoped_timer &);
+
+    profile_phase   d_phase;
+    int64_t         d_start;    // Or -1 when profiling was off
+};
+
+#endif
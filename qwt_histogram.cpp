@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <math.h>
 #include <qpen.h>
 #include <qwt_plot_layout.h>
 #include <qwt_legend.h>
@@ -9,29 +10,42 @@
 #include <qwt_series_data.h>
 #include <qwt_scale_map.h>
 #include <qwt_scale_engine.h>
+#include <qwt_plot_intervalcurve.h>
 #include "qwt_histogram.h"
+#include "profiler.h"
+
+// Interval samples that are rewritten in place, so that a new histogram
+// with as many bins as the last one allocates nothing.
+class histogram_series: public QwtIntervalSeriesData
+{
+public:
+    // Returns the samples to be filled in, forgetting the cached bounds.
+    QVector<QwtIntervalSample> &buffer()
+    {
+        d_boundingRect = QRectF(0.0, 0.0, -1.0, -1.0);
+        return d_samples;
+    }
+};
 
 class Histogram: public QwtPlotHistogram
 {
 public:
-    Histogram(const QString &, const QColor &,
-              double min_x, double max_x);
+    Histogram(const QString &, const QColor &);
 
     void setColor(const QColor &);
-    void setValues(uint numValues, const double *);
+    void setValues(const QVector<int> &counts, const QVector<double> &edges,
+                   double min_x, double max_x);
 
 private:
-    double  d_min_x;    // Left-hand border
-    double  d_max_x;    // Right-hand border
+    histogram_series    *d_series;  // Our data, owned by the plot item
 };
 
-Histogram::Histogram(const QString &title, const QColor &symbolColor,
-                     double min_x, double max_x):
+Histogram::Histogram(const QString &title, const QColor &symbolColor):
     QwtPlotHistogram(title)
-    , d_min_x(min_x)
-    , d_max_x(max_x)
+    , d_series(new histogram_series)
 {
     setStyle(QwtPlotHistogram::Columns);
+    setData(d_series);
 
     setColor(symbolColor);
 }
@@ -51,19 +65,27 @@ void Histogram::setColor(const QColor &symbolColor)
     setSymbol(symbol);
 }
 
-void Histogram::setValues(uint numValues, const double *values)
+// If edges holds one more entry than counts, they are the bin edges;
+// otherwise the bins evenly divide the range from min_x to max_x.
+void Histogram::setValues(const QVector<int> &counts, const QVector<double> &edges,
+                          double min_x, double max_x)
 {
-    double step_size = (d_max_x - d_min_x) / numValues;
-    QVector<QwtIntervalSample> samples(numValues);
-    for ( uint i = 0; i < numValues; i++ )
+    const int numValues = counts.size();
+    const bool use_edges = (edges.size() == numValues + 1);
+    double step_size = (max_x - min_x) / numValues;
+    QVector<QwtIntervalSample> &samples = d_series->buffer();
+    samples.resize(numValues);
+    for ( int i = 0; i < numValues; i++ )
     {
-        QwtInterval interval(double(d_min_x + i*step_size), d_min_x + (i+1)*step_size);
+        QwtInterval interval(double(min_x + i*step_size), min_x + (i+1)*step_size);
+        if (use_edges) {
+            interval = QwtInterval(edges[i], edges[i+1]);
+        }
         interval.setBorderFlags(QwtInterval::ExcludeMaximum);
         
-        samples[i] = QwtIntervalSample(values[i], interval);
+        samples[i] = QwtIntervalSample(counts[i], interval);
     }
-
-    setData(new QwtIntervalSeriesData(samples));
+    itemChanged();
 }
 
 HistoPlot::HistoPlot(QWidget *parent)
@@ -71,6 +93,8 @@ HistoPlot::HistoPlot(QWidget *parent)
     , d_min_value(100)
     , d_max_value(200)
     , d_histogram(NULL)
+    , d_band(NULL)
+    , d_bandSeries(NULL)
 {
     setTitle("Gel Density");
 
@@ -81,15 +105,28 @@ HistoPlot::HistoPlot(QWidget *parent)
     setAxisTitle(QwtPlot::xBottom, "Base Pairs");
     setAxisScaleEngine(QwtPlot::xBottom, new QwtLog10ScaleEngine);
 
-    // Fill in the counts vector with what we show by default,
-    // which is nothing.  When we get a report telling us about
-    // counts, then we want to redraw.
-
+    // The histogram and the band around it are made once and refilled
+    // with each update.  They stay hidden until there are counts to show.
     createGrid();
-    createOrUpdateHistogram();
-    // replot();
-
-    setAutoReplot(true);
+    d_histogram = new Histogram("Ignored", Qt::red);
+    d_histogram->setVisible(false);
+    d_histogram->attach(this);
+
+    d_bandSeries = new histogram_series;
+    d_band = new QwtPlotIntervalCurve("Expected range");
+    d_band->setStyle(QwtPlotIntervalCurve::Tube);
+    d_band->setPen(QPen(Qt::darkRed));
+    d_band->setBrush(QBrush(QColor(200, 0, 0, 60)));
+    d_band->setData(d_bandSeries);
+    d_band->setVisible(false);
+    d_band->attach(this);
+
+    // Updates can arrive much faster than the screen is redrawn, so rather
+    // than replotting after each one we wait for a frame's worth of time and
+    // then show the latest.
+    d_updateTimer.setSingleShot(true);
+    d_updateTimer.setInterval(FRAME_MSEC);
+    connect(&d_updateTimer, SIGNAL(timeout()), this, SLOT(createOrUpdateHistogram()));
 }
 
 void HistoPlot::createGrid()
@@ -103,48 +140,74 @@ void HistoPlot::createGrid()
     grid->attach(this);
 }
 
+void HistoPlot::scheduleUpdate()
+{
+    if (!d_updateTimer.isActive()) {
+        d_updateTimer.start();
+    }
+}
+
 void HistoPlot::createOrUpdateHistogram()
 {
-    // If we already have a histogram, get rid of it.
-    if (d_histogram) {
-        d_histogram->detach();
-        delete d_histogram;
-        d_histogram = NULL;
+    scoped_timer timer(PHASE_REPLOT);
+
+    // Fill the histogram's samples in place from our data.
+    const bool shown = !d_counts.isNull() && (d_counts->size() > 0);
+    d_histogram->setVisible(shown);
+    if (shown) {
+        d_histogram->setValues(*d_counts, d_counts->edges, d_min_value, d_max_value);
     }
 
-    // Create a new histogram based on our data.  We put the
-    // values into a double array and then pass the array and its
-    // counts into the Histogram to be displayed.
-    if (d_counts.size() > 0) {
-        double *vals = new double[d_counts.size()];
+    // If the counts are expected values, show the band around them as a
+    // tube through the middle of each bin.
+    bool band = shown && (d_counts->lower.size() == d_counts->size())
+                && (d_counts->upper.size() == d_counts->size());
+    d_band->setVisible(band);
+    if (band) {
+        const histogram_values_passer &counts = *d_counts;
+        QVector<QwtIntervalSample> &samples = d_bandSeries->buffer();
+        samples.resize(counts.size());
+        double step_size = (d_max_value - d_min_value) / counts.size();
         int i;
-        for (i = 0; i < d_counts.size(); i++) {
-            vals[i] = d_counts[i];
+        for (i = 0; i < counts.size(); i++) {
+            double left = d_min_value + i*step_size;
+            double right = d_min_value + (i+1)*step_size;
+            if (counts.edges.size() == counts.size() + 1) {
+                left = counts.edges[i];
+                right = counts.edges[i+1];
+            }
+            double middle = (left > 0) ? sqrt(left * right) : (left + right) / 2;
+            samples[i] = QwtIntervalSample(middle, counts.lower[i], counts.upper[i]);
         }
-
-        d_histogram = new Histogram("Ignored", Qt::red, d_min_value, d_max_value);
-        d_histogram->setValues(d_counts.size(), vals);
-        d_histogram->attach(this);
-
-        delete [] vals;
+        d_band->itemChanged();
     }
+
+    replot();
 }
 
 void HistoPlot::setMinX(double min_value)
 {
     d_min_value = min_value;
-    createOrUpdateHistogram();
+    scheduleUpdate();
 }
 
 void HistoPlot::setMaxX(double max_value)
 {
     d_max_value = max_value;
-    createOrUpdateHistogram();
+    scheduleUpdate();
 }
 
-void HistoPlot::setCounts(const histogram_values_passer counts)
+void HistoPlot::setCounts(histogram_snapshot counts)
 {
     d_counts = counts;
-    //printf("dbg: Got %d counts in HistoPlot::setCounts()\n", counts.size());
-    createOrUpdateHistogram();
+    scheduleUpdate();
+}
+
+void HistoPlot::setHistogram(histogram_snapshot counts)
+{
+    if (!counts.isNull()) {
+        d_min_value = counts->min_value;
+        d_max_value = counts->max_value;
+    }
+    setCounts(counts);
 }
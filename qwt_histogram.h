@@ -1,10 +1,13 @@
 #ifndef _HISTO_PLOT_H_
 
 #include <qvector.h>
+#include <qtimer.h>
 #include <qwt_plot.h>
 #include <histogram_values_passer.h>
 
 class Histogram;
+class histogram_series;
+class QwtPlotIntervalCurve;
 
 class HistoPlot: public QwtPlot
 {
@@ -20,20 +23,39 @@ public slots:
     void setMaxX(double max_value);
 
     // Sets the counts within each bin, as well as telling us how many bins there
-    // are (there is one per entry in the vector).  This is just a QVector of
-    // integer counts.
-    void setCounts(const histogram_values_passer counts);
+    // are (there is one per entry in the vector).  This is a QVector of
+    // integer counts, along with the bin edges if the bins are not even.
+    // The snapshot is kept, not copied, until the next one arrives.
+    void setCounts(histogram_snapshot counts);
+
+    // Sets the range and the counts together, which is how a new histogram
+    // should be reported so that it is shown in one update.
+    void setHistogram(histogram_snapshot counts);
+
+private slots:
+    // Shows the latest range and counts and replots.
+    void createOrUpdateHistogram();
 
 private:
+    enum { FRAME_MSEC = 16 };   // Shortest time between replots
+
     void createGrid();
-    void createOrUpdateHistogram();
+
+    // Arranges for createOrUpdateHistogram() to be called once the current
+    // frame is over, however many changes are made before then.
+    void scheduleUpdate();
 
     double  d_min_value;
     double  d_max_value;
 
     Histogram   *d_histogram;   // Our histogram plot
+    QwtPlotIntervalCurve *d_band;   // Confidence band, when we have one
+    histogram_series *d_bandSeries; // Its data, owned by d_band
+    QTimer      d_updateTimer;  // Runs until the pending update is shown
 
-    QVector<int>    d_counts;   // The bins and counts in our histogram plot.
+    // The bins and counts in our histogram plot, with their edges if the
+    // bins are not even and their band if they have one, or null.
+    histogram_snapshot  d_counts;
 };
 
 #endif
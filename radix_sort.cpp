@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <vector>
+#include <functional>
+
+#include "radix_sort.h"
+#include "thread_pool.h"
+
+static const int RADIX_BITS = 11;
+static const size_t RADIX_BUCKETS = static_cast<size_t>(1) << RADIX_BITS;
+
+// Values per slice at the least, so that a slice's counts and the thread
+// to fill them are worth their cost.
+static const size_t SLICE_MIN_VALUES = RADIX_PARALLEL_MIN_VALUES / 4;
+
+template <class T>
+static void sort_values(T *values, size_t count, int num_threads)
+{
+    if (count < RADIX_MIN_VALUES) {
+        std::sort(values, values + count);
+        return;
+    }
+    if (num_threads <= 0) {
+        num_threads = default_thread_count();
+    }
+    if (count < RADIX_PARALLEL_MIN_VALUES) {
+        num_threads = 1;
+    }
+    int num_slices = static_cast<int>(std::min(static_cast<size_t>(num_threads),
+                                               count / SLICE_MIN_VALUES));
+    if (num_slices < 1) {
+        num_slices = 1;
+    }
+    std::vector<size_t> slice_start(num_slices + 1);
+    int s;
+    for (s = 0; s <= num_slices; s++) {
+        slice_start[s] = static_cast<size_t>(static_cast<uint64_t>(count) * s / num_slices);
+    }
+
+    // Only the digits below the largest value need sorting on.
+    std::vector<T> slice_max(num_slices, 0);
+    std::function<void(int)> find_max = [&](int slice) {
+        T most = 0;
+        size_t i;
+        for (i = slice_start[slice]; i < slice_start[slice + 1]; i++) {
+            most = std::max(most, values[i]);
+        }
+        slice_max[slice] = most;
+    };
+    run_work_stealing(num_slices, num_slices, find_max);
+    T largest = *std::max_element(slice_max.begin(), slice_max.end());
+    int bits = 0;
+    while ( (bits < static_cast<int>(8 * sizeof(T))) && ((largest >> bits) != 0) ) {
+        bits++;
+    }
+
+    std::vector<T> scratch(count);
+    T *from = values;
+    T *to = &scratch[0];
+    std::vector<size_t> counts(num_slices * RADIX_BUCKETS);
+    int shift = 0;
+
+    // Counts each slice's values by digit.
+    std::function<void(int)> count_digits = [&](int slice) {
+        size_t *slice_counts = &counts[slice * RADIX_BUCKETS];
+        size_t i;
+        for (i = slice_start[slice]; i < slice_start[slice + 1]; i++) {
+            slice_counts[(from[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+        }
+    };
+
+    // Moves each slice's values to their places, keeping their order.
+    std::function<void(int)> move_values = [&](int slice) {
+        size_t *next = &counts[slice * RADIX_BUCKETS];
+        size_t i;
+        for (i = slice_start[slice]; i < slice_start[slice + 1]; i++) {
+            T value = from[i];
+            to[next[(value >> shift) & (RADIX_BUCKETS - 1)]++] = value;
+        }
+    };
+
+    for (shift = 0; shift < bits; shift += RADIX_BITS) {
+        std::fill(counts.begin(), counts.end(), 0);
+        run_work_stealing(num_slices, num_slices, count_digits);
+
+        // Turn the counts into where each slice's values with each digit
+        // start: all smaller digits come first, then the same digit from
+        // earlier slices.  If every value has the same digit the pass
+        // would leave them where they are.
+        size_t total = 0;
+        bool one_digit = false;
+        size_t d;
+        for (d = 0; d < RADIX_BUCKETS; d++) {
+            size_t digit_total = 0;
+            for (s = 0; s < num_slices; s++) {
+                size_t n = counts[s * RADIX_BUCKETS + d];
+                counts[s * RADIX_BUCKETS + d] = total + digit_total;
+                digit_total += n;
+            }
+            if (digit_total == count) {
+                one_digit = true;
+            }
+            total += digit_total;
+        }
+        if (one_digit) {
+            continue;
+        }
+
+        run_work_stealing(num_slices, num_slices, move_values);
+        std::swap(from, to);
+    }
+
+    if (from != values) {
+        std::copy(from, from + count, values);
+    }
+}
+
+void radix_sort(uint32_t *values, size_t count, int num_threads)
+{
+    sort_values(values, count, num_threads);
+}
+
+void radix_sort(uint64_t *values, size_t count, int num_threads)
+{
+    sort_values(values, count, num_threads);
+}
+
+void radix_sort(int64_t *values, size_t count, int num_threads)
+{
+    // Values that are not negative sort the same as their unsigned bits.
+    sort_values(reinterpret_cast<uint64_t *>(values), count, num_threads);
+}
@@ -0,0 +1,31 @@
+// Sorting of large arrays of base-pair locations in linear time.
+//
+// This is a least-significant-digit radix sort.  Each pass counts the
+// values with each digit, then moves every value, stably, to where its
+// digit's share of the output starts.  Only the digits below the largest
+// value are sorted on, and a pass is skipped when every value has the same
+// digit, so uniformly spread cuts into a model of a billion base pairs
+// take three passes of 11 bits.  Large arrays are split into one slice per
+// thread: each thread counts its own slice, and the counts are summed in
+// slice order, so each thread knows where to put every one of its values
+// without any locking and the result does not depend on the thread count.
+// Sorting needs scratch space as large as the array.
+
+#ifndef _RADIX_SORT_H_
+#define _RADIX_SORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Below this many values std::sort is used, and below RADIX_PARALLEL_MIN_VALUES
+// the radix sort runs on the calling thread.
+enum { RADIX_MIN_VALUES = 1 << 16 };
+enum { RADIX_PARALLEL_MIN_VALUES = 1 << 20 };
+
+// Sorts count values into increasing order.  A num_threads of 0 or less
+// uses all cores.  Signed values must not be negative.
+void radix_sort(uint32_t *values, size_t count, int num_threads = 0);
+void radix_sort(uint64_t *values, size_t count, int num_threads = 0);
+void radix_sort(int64_t *values, size_t count, int num_threads = 0);
+
+#endif
@@ -0,0 +1,272 @@
+#include <math.h>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "random_stream.h"
+
+// Constants from the Random123 reference implementation.
+static const uint32_t PHILOX_M0 = 0xD2511F53;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57;
+static const uint32_t PHILOX_W0 = 0x9E3779B9;
+static const uint32_t PHILOX_W1 = 0xBB67AE85;
+
+random_stream::random_stream(uint64_t seed, uint64_t stream)
+{
+    reset(seed, stream);
+}
+
+void random_stream::reset(uint64_t seed, uint64_t stream)
+{
+    d_key[0] = static_cast<uint32_t>(seed);
+    d_key[1] = static_cast<uint32_t>(seed >> 32);
+    d_counter[0] = 0;
+    d_counter[1] = 0;
+    d_counter[2] = static_cast<uint32_t>(stream);
+    d_counter[3] = static_cast<uint32_t>(stream >> 32);
+    d_used = 4;
+}
+
+void random_stream::seek(uint64_t position)
+{
+    uint64_t block = position / 4;
+    d_counter[0] = static_cast<uint32_t>(block);
+    d_counter[1] = static_cast<uint32_t>(block >> 32);
+    d_used = 4;
+    if (position % 4 != 0) {
+        next32();
+        d_used = static_cast<int>(position % 4);
+    }
+}
+
+void random_stream::philox(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    int round;
+    for (round = 0; round < 10; round++) {
+        uint64_t p0 = static_cast<uint64_t>(PHILOX_M0) * c0;
+        uint64_t p1 = static_cast<uint64_t>(PHILOX_M1) * c2;
+        uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n1 = static_cast<uint32_t>(p1);
+        uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        uint32_t n3 = static_cast<uint32_t>(p0);
+        c0 = n0; c1 = n1; c2 = n2; c3 = n3;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+// Computes count consecutive blocks starting at the specified counter,
+// storing the four outputs of each block one after another.
+static void philox_blocks(const uint32_t counter[4], const uint32_t key[2],
+                          uint32_t *out, size_t count)
+{
+    uint64_t block = (static_cast<uint64_t>(counter[1]) << 32) | counter[0];
+    size_t done = 0;
+
+#if defined(__AVX512F__)
+    // Sixteen blocks at a time, one per 32-bit lane, with each word of the
+    // counter in its own register.  The multiplies give only the even
+    // lanes' 64-bit products, so the odd lanes are shifted down, multiplied
+    // separately and blended back.
+    const __m512i m0 = _mm512_set1_epi32(static_cast<int>(PHILOX_M0));
+    const __m512i m1 = _mm512_set1_epi32(static_cast<int>(PHILOX_M1));
+    for (; done + 16 <= count; done += 16) {
+        uint32_t low[16], high[16];
+        int lane;
+        for (lane = 0; lane < 16; lane++) {
+            uint64_t b = block + done + lane;
+            low[lane] = static_cast<uint32_t>(b);
+            high[lane] = static_cast<uint32_t>(b >> 32);
+        }
+        __m512i c0 = _mm512_loadu_si512(low);
+        __m512i c1 = _mm512_loadu_si512(high);
+        __m512i c2 = _mm512_set1_epi32(static_cast<int>(counter[2]));
+        __m512i c3 = _mm512_set1_epi32(static_cast<int>(counter[3]));
+        uint32_t k0 = key[0], k1 = key[1];
+        int round;
+        for (round = 0; round < 10; round++) {
+            __m512i hi0 = _mm512_mask_blend_epi32(0xAAAA,
+                _mm512_srli_epi64(_mm512_mul_epu32(c0, m0), 32),
+                _mm512_mul_epu32(_mm512_srli_epi64(c0, 32), m0));
+            __m512i hi1 = _mm512_mask_blend_epi32(0xAAAA,
+                _mm512_srli_epi64(_mm512_mul_epu32(c2, m1), 32),
+                _mm512_mul_epu32(_mm512_srli_epi64(c2, 32), m1));
+            __m512i lo0 = _mm512_mullo_epi32(c0, m0);
+            __m512i lo1 = _mm512_mullo_epi32(c2, m1);
+            c0 = _mm512_xor_si512(_mm512_xor_si512(hi1, c1), _mm512_set1_epi32(static_cast<int>(k0)));
+            c1 = lo1;
+            c2 = _mm512_xor_si512(_mm512_xor_si512(hi0, c3), _mm512_set1_epi32(static_cast<int>(k1)));
+            c3 = lo0;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        uint32_t words[4][16];
+        _mm512_storeu_si512(words[0], c0);
+        _mm512_storeu_si512(words[1], c1);
+        _mm512_storeu_si512(words[2], c2);
+        _mm512_storeu_si512(words[3], c3);
+        for (lane = 0; lane < 16; lane++) {
+            uint32_t *o = out + 4 * (done + lane);
+            o[0] = words[0][lane]; o[1] = words[1][lane];
+            o[2] = words[2][lane]; o[3] = words[3][lane];
+        }
+    }
+#elif defined(__AVX2__)
+    // Eight blocks at a time, in the same way as above.
+    const __m256i m0 = _mm256_set1_epi32(static_cast<int>(PHILOX_M0));
+    const __m256i m1 = _mm256_set1_epi32(static_cast<int>(PHILOX_M1));
+    for (; done + 8 <= count; done += 8) {
+        uint32_t low[8], high[8];
+        int lane;
+        for (lane = 0; lane < 8; lane++) {
+            uint64_t b = block + done + lane;
+            low[lane] = static_cast<uint32_t>(b);
+            high[lane] = static_cast<uint32_t>(b >> 32);
+        }
+        __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(low));
+        __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(high));
+        __m256i c2 = _mm256_set1_epi32(static_cast<int>(counter[2]));
+        __m256i c3 = _mm256_set1_epi32(static_cast<int>(counter[3]));
+        uint32_t k0 = key[0], k1 = key[1];
+        int round;
+        for (round = 0; round < 10; round++) {
+            __m256i hi0 = _mm256_blend_epi32(
+                _mm256_srli_epi64(_mm256_mul_epu32(c0, m0), 32),
+                _mm256_mul_epu32(_mm256_srli_epi64(c0, 32), m0), 0xAA);
+            __m256i hi1 = _mm256_blend_epi32(
+                _mm256_srli_epi64(_mm256_mul_epu32(c2, m1), 32),
+                _mm256_mul_epu32(_mm256_srli_epi64(c2, 32), m1), 0xAA);
+            __m256i lo0 = _mm256_mullo_epi32(c0, m0);
+            __m256i lo1 = _mm256_mullo_epi32(c2, m1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(static_cast<int>(k0)));
+            c1 = lo1;
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(static_cast<int>(k1)));
+            c3 = lo0;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        uint32_t words[4][8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[0]), c0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[1]), c1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[2]), c2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[3]), c3);
+        for (lane = 0; lane < 8; lane++) {
+            uint32_t *o = out + 4 * (done + lane);
+            o[0] = words[0][lane]; o[1] = words[1][lane];
+            o[2] = words[2][lane]; o[3] = words[3][lane];
+        }
+    }
+#endif
+
+    // Whatever is left, one block at a time.
+    for (; done < count; done++) {
+        uint64_t b = block + done;
+        uint32_t c[4] = { static_cast<uint32_t>(b), static_cast<uint32_t>(b >> 32),
+                          counter[2], counter[3] };
+        random_stream::philox(c, key, out + 4 * done);
+    }
+}
+
+uint32_t random_stream::next32(void)
+{
+    if (d_used == 4) {
+        philox(d_counter, d_key, d_block);
+        if (++d_counter[0] == 0) {
+            ++d_counter[1];
+        }
+        d_used = 0;
+    }
+    return d_block[d_used++];
+}
+
+void random_stream::fill32(uint32_t *values, size_t count)
+{
+    // Finish the current block, then compute whole blocks straight into
+    // values, then start a new block for the rest.
+    while ( (count > 0) && (d_used < 4) ) {
+        *values++ = d_block[d_used++];
+        count--;
+    }
+    size_t blocks = count / 4;
+    if (blocks > 0) {
+        philox_blocks(d_counter, d_key, values, blocks);
+        uint64_t next = ((static_cast<uint64_t>(d_counter[1]) << 32) | d_counter[0]) + blocks;
+        d_counter[0] = static_cast<uint32_t>(next);
+        d_counter[1] = static_cast<uint32_t>(next >> 32);
+        values += 4 * blocks;
+        count -= 4 * blocks;
+    }
+    while (count > 0) {
+        *values++ = next32();
+        count--;
+    }
+}
+
+void random_stream::fillUniform(double *values, size_t count)
+{
+    // Convert a chunk of outputs at a time.  The two parts are exact in a
+    // double and do not overlap, so their sum is the same value uniform()
+    // makes from them.
+    const size_t CHUNK = 512;
+    uint32_t raw[2 * CHUNK];
+    while (count > 0) {
+        size_t n = (count < CHUNK) ? count : CHUNK;
+        fill32(raw, 2 * n);
+        size_t i;
+        for (i = 0; i < n; i++) {
+            values[i] = (raw[2*i] >> 5) * (1.0 / 134217728.0)
+                      + (raw[2*i + 1] >> 6) * (1.0 / 9007199254740992.0);
+        }
+        values += n;
+        count -= n;
+    }
+}
+
+double random_stream::uniform(void)
+{
+    uint64_t hi = next32() >> 5;   // 27 bits
+    uint64_t lo = next32() >> 6;   // 26 bits
+    return ((hi << 26) | lo) * (1.0 / 9007199254740992.0);
+}
+
+uint64_t random_stream::below(uint64_t n)
+{
+    // Reject the values at the top of the 64-bit range that would make
+    // some remainders more likely than others.
+    const uint64_t all_ones = ~static_cast<uint64_t>(0);
+    uint64_t limit = all_ones - (all_ones % n);
+    uint64_t value;
+    do {
+        value = (static_cast<uint64_t>(next32()) << 32) | next32();
+    } while (value >= limit);
+    return value % n;
+}
+
+// Polar method for normal density discussed in Knuth
+
+double random_stream::normal(void)
+{
+    double u1, u2, v1, v2;
+    double S = 2;
+    while ( (S >= 1) || (S == 0) ) {
+        u1 = uniform();
+        u2 = uniform();
+        v1 = 2*u1 - 1;
+        v2 = 2*u2 - 1;
+        S = v1*v1 + v2*v2;
+    }
+    return v1*sqrt( (-2*log(S))/S );
+}
+
+double sorted_uniforms::next(random_stream &rng)
+{
+    // The smallest of the k values still to come, measured as a fraction of
+    // the gap above the last one, is distributed as 1 - V^(1/k).  Work in
+    // logs so that the gap does not lose precision as it shrinks.
+    d_logGap += log(1 - rng.uniform()) / static_cast<double>(d_remaining);
+    d_remaining--;
+    return -expm1(d_logGap);
+}
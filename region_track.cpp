@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "region_track.h"
+#include "mapped_file.h"
+#include "nucleosome_array.h"
+#include "result_cache.h"
+
+static const int64_t NO_REGION_END = INT64_MAX;     // Where the last gap ends
+
+// Columns a line may have.
+enum { CHROM, START, END, LINKER, OCCUPANCY, VARIANCE, ACCESSIBILITY, NUM_COLUMNS };
+
+// Copies the token [begin, end) into text, which holds size bytes, and
+// returns false if it does not fit.
+static bool copy_token(const char *begin, const char *end, char *text, size_t size)
+{
+    size_t length = end - begin;
+    if (length + 1 > size) {
+        return false;
+    }
+    memcpy(text, begin, length);
+    text[length] = '\0';
+    return true;
+}
+
+static bool parse_integer(const char *begin, const char *end, int64_t &value)
+{
+    char text[32];
+    char *stop;
+    if (!copy_token(begin, end, text, sizeof(text))) {
+        return false;
+    }
+    value = strtoll(text, &stop, 10);
+    return (*stop == '\0') && (stop != text);
+}
+
+// Parses a value column, leaving value alone if it is ".".
+static bool parse_value(const char *begin, const char *end, double &value)
+{
+    char text[64];
+    char *stop;
+    if (!copy_token(begin, end, text, sizeof(text))) {
+        return false;
+    }
+    if (strcmp(text, ".") == 0) {
+        return true;
+    }
+    value = strtod(text, &stop);
+    return (*stop == '\0') && (stop != text);
+}
+
+//----------------------------------------------------------------------
+
+region::region()
+    : start(0)
+    , end(0)
+    , bpPerLinker(0)
+    , occupancy(-1)
+    , variance(-1)
+    , accessibility(1)
+{
+}
+
+region_track::region_track()
+    : d_count(0)
+    , d_fingerprint(0)
+{
+}
+
+int region_track::parse(size_t &offset, region &result, size_t &line) const
+{
+    const char *data = d_file->data();
+    const size_t size = d_file->size();
+    while (offset < size) {
+        const char *p = data + offset;
+        const char *eol = static_cast<const char *>(memchr(p, '\n', size - offset));
+        if (eol == NULL) {
+            eol = data + size;
+        }
+        offset = (eol - data) + ((eol < data + size) ? 1 : 0);
+        line++;
+
+        // Split the line into its columns.
+        const char *begins[NUM_COLUMNS];
+        const char *ends[NUM_COLUMNS];
+        int columns = 0;
+        while (true) {
+            while ( (p < eol) && ((*p == ' ') || (*p == '\t') || (*p == '\r')) ) { p++; }
+            if (p == eol) { break; }
+            if (columns == NUM_COLUMNS) {
+                return -NOT_A_REGION;
+            }
+            begins[columns] = p;
+            while ( (p < eol) && (*p != ' ') && (*p != '\t') && (*p != '\r') ) { p++; }
+            ends[columns] = p;
+            columns++;
+        }
+        if ( (columns == 0) || (*begins[0] == '#')
+             || ((ends[0] - begins[0] == 5) && (memcmp(begins[0], "track", 5) == 0))
+             || ((ends[0] - begins[0] == 7) && (memcmp(begins[0], "browser", 7) == 0)) ) {
+            continue;
+        }
+        if (columns <= END) {
+            return -NOT_A_REGION;
+        }
+
+        result = region();
+        double linker = 0;
+        if ( !parse_integer(begins[START], ends[START], result.start)
+             || !parse_integer(begins[END], ends[END], result.end)
+             || ((columns > LINKER) && !parse_value(begins[LINKER], ends[LINKER], linker))
+             || ((columns > OCCUPANCY) && !parse_value(begins[OCCUPANCY], ends[OCCUPANCY], result.occupancy))
+             || ((columns > VARIANCE) && !parse_value(begins[VARIANCE], ends[VARIANCE], result.variance))
+             || ((columns > ACCESSIBILITY)
+                 && !parse_value(begins[ACCESSIBILITY], ends[ACCESSIBILITY], result.accessibility)) ) {
+            return -NOT_A_REGION;
+        }
+        if ( (result.start < 0) || (result.end <= result.start)
+             || (linker < 0) || (linker > nucleosome_array::MAX_LINKER / 2) || (linker != floor(linker))
+             || (result.occupancy > 1) || (result.accessibility < 0)
+             || (result.accessibility > MAX_ACCESSIBILITY) ) {
+            return -VALUE_OUT_OF_RANGE;
+        }
+        result.bpPerLinker = static_cast<int>(linker);
+        if ((columns > LINKER) && (result.bpPerLinker == 0) && (*begins[LINKER] != '.')) {
+            return -VALUE_OUT_OF_RANGE;  // A linker must be at least 1 base pair
+        }
+        if ( ((columns > OCCUPANCY) && (*begins[OCCUPANCY] != '.') && (result.occupancy < 0))
+             || ((columns > VARIANCE) && (*begins[VARIANCE] != '.') && (result.variance < 0)) ) {
+            return -VALUE_OUT_OF_RANGE;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+bool region_track::open(const char *filename, size_t *bad_line, problem *why)
+{
+    d_file.reset();
+    d_count = 0;
+    d_indexStarts.clear();
+    d_indexOffsets.clear();
+    if (bad_line != NULL) {
+        *bad_line = 0;
+    }
+    if (why != NULL) {
+        *why = NO_PROBLEM;
+    }
+
+    std::shared_ptr<mapped_file> file(new mapped_file);
+    if (!file->open(filename)) {
+        if (why != NULL) {
+            *why = UNREADABLE;
+        }
+        return false;
+    }
+    d_file = file;
+    d_filename = filename;
+    d_fingerprint = result_cache::hash(file->data(), file->size());
+
+    // Check every region, keeping every INDEX_STRIDE'th for the index.
+    size_t offset = 0, line = 0;
+    int64_t last_end = 0;
+    region r;
+    int found;
+    while (true) {
+        size_t line_offset = offset;
+        found = parse(offset, r, line);
+        if (found <= 0) {
+            break;
+        }
+        if (r.start < last_end) {
+            found = -OUT_OF_ORDER;
+            break;
+        }
+        if (d_count % INDEX_STRIDE == 0) {
+            d_indexStarts.push_back(r.start);
+            d_indexOffsets.push_back(line_offset);
+        }
+        last_end = r.end;
+        d_count++;
+    }
+    if (found < 0) {
+        if (bad_line != NULL) {
+            *bad_line = line;
+        }
+        if (why != NULL) {
+            *why = static_cast<problem>(-found);
+        }
+        d_file.reset();
+        d_count = 0;
+        return false;
+    }
+    return true;
+}
+
+const char *region_track::describe(problem why)
+{
+    switch (why) {
+    case NO_PROBLEM: return "is a valid region";
+    case UNREADABLE: return "cannot be read";
+    case NOT_A_REGION: return "is not a region";
+    case VALUE_OUT_OF_RANGE: return "has a value out of range";
+    case OUT_OF_ORDER: return "overlaps or comes before the region above it";
+    }
+    return "is not a region";
+}
+
+//----------------------------------------------------------------------
+
+region_track::cursor::cursor(const region_track *track)
+    : d_track(track)
+    , d_placed(false)
+    , d_next(0)
+    , d_valid(false)
+    , d_number(0)
+    , d_lastEnd(0)
+{
+}
+
+void region_track::cursor::advance(void)
+{
+    size_t line = 0;
+    d_lastEnd = d_region.end;
+    d_valid = d_track->parse(d_next, d_region, line) > 0;
+    d_number++;
+}
+
+void region_track::cursor::seek(int64_t location)
+{
+    d_placed = true;
+    d_valid = false;
+    const std::vector<int64_t> &starts = d_track->d_indexStarts;
+    if (starts.empty()) {
+        return;
+    }
+    size_t entry = std::upper_bound(starts.begin(), starts.end(), location) - starts.begin();
+    if (entry > 0) {
+        entry--;
+    }
+
+    // Every region before the entry ends at or before its start.
+    size_t line = 0;
+    d_next = d_track->d_indexOffsets[entry];
+    d_number = entry * INDEX_STRIDE;
+    d_valid = d_track->parse(d_next, d_region, line) > 0;
+    d_lastEnd = (entry > 0) ? starts[entry] : INT64_MIN;
+    while (d_valid && (d_region.end <= location)) {
+        advance();
+    }
+}
+
+const region *region_track::cursor::find(int64_t location)
+{
+    if (d_track == NULL) {
+        return NULL;
+    }
+
+    // Go back, or jump ahead past a whole index entry, with the index, and
+    // otherwise walk forward a region at a time.
+    if (!d_placed || (location < d_lastEnd)) {
+        seek(location);
+    }
+    while (d_valid && (d_region.end <= location)) {
+        size_t next_entry = d_number / INDEX_STRIDE + 1;
+        if ( (next_entry < d_track->d_indexStarts.size())
+             && (d_track->d_indexStarts[next_entry] <= location) ) {
+            seek(location);
+        } else {
+            advance();
+        }
+    }
+    return (d_valid && (d_region.start <= location)) ? &d_region : NULL;
+}
+
+int64_t region_track::cursor::changeAfter(int64_t location)
+{
+    if (find(location) != NULL) {
+        return d_region.end;
+    }
+    return d_valid ? d_region.start : NO_REGION_END;
+}
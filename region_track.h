@@ -0,0 +1,138 @@
+// Model parameters that vary along the strand, for chromatin with open and
+// closed domains, read from a BED-like text file with one region per line:
+//
+//   chrom  start  end  linker  occupancy  variance  accessibility
+//
+// The model is a single strand, so chrom is only a label.  start and end
+// are base-pair locations along the model, counting from 0 with end
+// excluded, as in BED.  Regions must be in order and must not overlap.
+// The values apply to the nucleosomes whose linker starts in the region
+// and to the cuttable DNA within it:
+//
+//   linker         Mean base pairs per linker (at most MAX_LINKER / 2)
+//   occupancy      Fraction of histones that stay attached, 0 to 1
+//   variance       Variance of the linker length
+//   accessibility  Cut rate relative to DNA outside every region, 0 to
+//                  MAX_ACCESSIBILITY
+//
+// A value of "." keeps the model's own value, as do columns left off the
+// end of a line; accessibility is then 1.  Blank lines, '#' comments and
+// BED "track" and "browser" lines are skipped.  Outside every region the
+// model's own parameters apply.
+//
+// The file is mapped rather than read, and the regions are parsed as they
+// are needed by cursors that walk along it, so a genome-wide annotation is
+// never held in memory.  Opening it checks every line once and keeps the
+// start and file offset of every INDEX_STRIDE'th region, a sparse sorted
+// index that lets a cursor jump to any location after a binary search and
+// a short scan.  A cursor looking up locations in increasing order, as the
+// model does, takes constant amortized time per lookup.
+
+#ifndef _REGION_TRACK_H_
+#define _REGION_TRACK_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+class mapped_file;
+
+class region {
+public:
+    region();
+
+    int64_t start;          // First base pair in the region
+    int64_t end;            // Just past the last one
+    int     bpPerLinker;    // Or 0 for the model's
+    double  occupancy;      // Or less than 0 for the model's
+    double  variance;       // Or less than 0 for the model's
+    double  accessibility;
+};
+
+class region_track {
+public:
+    enum { INDEX_STRIDE = 256 };    // Regions between sparse index entries
+    enum { MAX_ACCESSIBILITY = 1000 };
+
+    // What open() found wrong with a file.
+    enum problem {
+        NO_PROBLEM = 0,
+        UNREADABLE,         // The file could not be mapped
+        NOT_A_REGION,       // A line's columns are missing, extra or not numbers
+        VALUE_OUT_OF_RANGE, // A region's bounds or one of its values are out of range
+        OUT_OF_ORDER        // A region starts before the one above it ends
+    };
+
+    region_track();
+
+    // Maps the specified file and checks every region in it.  Returns
+    // false if it cannot be read or a line is not a valid region in order;
+    // bad_line, if not NULL, is then set to that line's number, counting
+    // from 1, or to 0 if the file could not be read at all, and why, if not
+    // NULL, to what was wrong.
+    bool open(const char *filename, size_t *bad_line = NULL, problem *why = NULL);
+
+    // Describes a problem as the end of a sentence about the line, such
+    // as "Line 2 of r.bed has a value out of range".
+    static const char *describe(problem why);
+
+    const std::string &filename(void) const { return d_filename; }
+    size_t regionCount(void) const { return d_count; }
+
+    // Hash of the file's contents, which tells tracks apart in stored
+    // results.
+    uint64_t fingerprint(void) const { return d_fingerprint; }
+
+    // Looks up the regions holding base-pair locations.
+    class cursor {
+    public:
+        // A NULL track has no regions.
+        explicit cursor(const region_track *track);
+
+        // Returns the region holding the specified location, or NULL if
+        // there is none.  The region stays valid until the next call.
+        const region *find(int64_t location);
+
+        // Returns where the region holding the specified location, or the
+        // gap between regions holding it, ends, so that a walk along the
+        // strand can tell where the values next change.
+        int64_t changeAfter(int64_t location);
+
+    private:
+        // Parses regions from the sparse index entry at or before location
+        // up to the first one that ends past it.
+        void seek(int64_t location);
+
+        // Parses the region after d_region into it.
+        void advance(void);
+
+        const region_track  *d_track;
+        bool                d_placed;   // Has the cursor been placed by seek()?
+        size_t              d_next;     // File offset of the line after d_region
+        bool                d_valid;    // Is d_region a region of the file?
+        region              d_region;   // First region ending past the last location
+        size_t              d_number;   // Its number in the file, counting from 0
+        int64_t             d_lastEnd;  // End of the region before it
+    };
+
+private:
+    region_track(const region_track &);             // Not copyable
+    region_track &operator=(const region_track &);
+
+    // Reads the next region starting at offset, moving offset past it.
+    // Returns 1 for a region, 0 at the end of the file and -NOT_A_REGION
+    // or -VALUE_OUT_OF_RANGE for a line that is not a valid region.  line
+    // counts the lines passed.
+    int parse(size_t &offset, region &result, size_t &line) const;
+
+    std::shared_ptr<const mapped_file>  d_file;
+    std::string                         d_filename;
+    size_t                              d_count;
+    uint64_t                            d_fingerprint;
+    std::vector<int64_t>                d_indexStarts;  // Start of every INDEX_STRIDE'th region
+    std::vector<size_t>                 d_indexOffsets; // And where its line is in the file
+};
+
+#endif
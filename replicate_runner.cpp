@@ -0,0 +1,96 @@
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "replicate_runner.h"
+#include "random_stream.h"
+
+model_pool::~model_pool()
+{
+    size_t i;
+    for (i = 0; i < d_idle.size(); i++) {
+        delete d_idle[i];
+    }
+}
+
+chromatin_model *model_pool::borrow(void)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    if (d_idle.empty()) {
+        return new chromatin_model;
+    }
+    chromatin_model *model = d_idle.back();
+    d_idle.pop_back();
+    return model;
+}
+
+void model_pool::giveBack(chromatin_model *model)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_idle.push_back(model);
+}
+
+// Each worker pulls the next replicate number to run until they have all
+// been taken, accumulating into its own counts so that no locking is needed.
+static void replicate_worker(const chromatin_parameters *params, uint64_t seed,
+                             int last, std::atomic<int> *next,
+                             std::atomic<bool> *uncuttable,
+                             fragment_accumulator *lengths, model_pool *models)
+{
+    chromatin_model *model = models->borrow();
+    model->setParameters(*params);
+    random_stream rng;
+    int which;
+    while ( (which = (*next)++) < last ) {
+        rng.reset(seed, static_cast<uint64_t>(which));
+        if (!model->streamFragmentLengths(rng, *lengths)) {
+            *uncuttable = true;
+        }
+    }
+    models->giveBack(model);
+}
+
+bool run_replicates(const chromatin_parameters &params, uint64_t seed,
+                    int num_replicates, int num_threads,
+                    fragment_accumulator &lengths, model_pool *models)
+{
+    return run_replicate_range(params, seed, 0, num_replicates, num_threads, lengths, models);
+}
+
+bool run_replicate_range(const chromatin_parameters &params, uint64_t seed,
+                         int first, int last, int num_threads,
+                         fragment_accumulator &lengths, model_pool *models)
+{
+    model_pool own_models;
+    if (models == NULL) {
+        models = &own_models;
+    }
+    if (num_threads <= 0) {
+        num_threads = default_thread_count();
+    }
+    if (num_threads > last - first) {
+        num_threads = last - first;
+    }
+    std::atomic<int> next(first);
+    std::atomic<bool> uncuttable(false);
+    if (num_threads <= 1) {
+        replicate_worker(&params, seed, last, &next, &uncuttable, &lengths, models);
+        return !uncuttable;
+    }
+
+    std::vector<fragment_accumulator *> partial(num_threads);
+    std::vector<std::thread> threads;
+    int i;
+    for (i = 0; i < num_threads; i++) {
+        partial[i] = lengths.emptyCopy();
+        threads.push_back(std::thread(replicate_worker, &params, seed,
+                                      last, &next, &uncuttable,
+                                      partial[i], models));
+    }
+    for (i = 0; i < num_threads; i++) {
+        threads[i].join();
+        lengths.merge(*partial[i]);
+        delete partial[i];
+    }
+    return !uncuttable;
+}
@@ -0,0 +1,56 @@
+// Runs many independent replicates of the chromatin model across threads
+// and merges their fragment lengths into one distribution.
+
+#ifndef _REPLICATE_RUNNER_H_
+#define _REPLICATE_RUNNER_H_
+
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+#include "chromatin_model.h"
+#include "thread_pool.h"
+
+// Models kept for the threads of a run to borrow, so that each replicate,
+// point or unit builds with a model whose memory and workspace an earlier
+// one already sized.  A thread holds a model only while it works, so there
+// are never more of them than threads.  Which model it gets makes no
+// difference to what it builds, since a model is laid out afresh from its
+// own random streams.
+class model_pool {
+public:
+    ~model_pool();
+
+    // Takes an idle model, or a new one if there is none.  This may be
+    // called from any thread.
+    chromatin_model *borrow(void);
+
+    // Puts a borrowed model back for the next borrower.
+    void giveBack(chromatin_model *model);
+
+private:
+    std::mutex                      d_mutex;
+    std::vector<chromatin_model *>  d_idle;
+};
+
+// Builds num_replicates realizations of the model with the specified
+// parameters and adds the fragment lengths from all of them into lengths.
+// The cuts are streamed rather than stored (see streamFragmentLengths).
+// Replicate r draws its random numbers from stream r of the seed, and
+// each thread fills its own empty copy of the accumulator, which are then
+// merged by adding counts, so the result is identical for any number of
+// threads.  A num_threads of 0 or less uses all cores.
+// Returns false if the models had cuts to place but no cuttable DNA.
+// The models are borrowed from the specified pool, if there is one, so
+// that calls made one after another can share them.
+bool run_replicates(const chromatin_parameters &params, uint64_t seed,
+                    int num_replicates, int num_threads,
+                    fragment_accumulator &lengths, model_pool *models = NULL);
+
+// The same, for just replicates [first, last) of them, so that the
+// replicates of a run can be shared out and their counts added up later
+// to give exactly what run_replicates would.
+bool run_replicate_range(const chromatin_parameters &params, uint64_t seed,
+                         int first, int last, int num_threads,
+                         fragment_accumulator &lengths, model_pool *models = NULL);
+
+#endif
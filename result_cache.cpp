@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "result_cache.h"
+
+// First line of every stored result, so other files are never mistaken
+// for one.
+static const char *CACHE_MAGIC = "chromatinCutter result 1";
+
+result_cache::result_cache(const std::string &directory)
+    : d_directory(directory)
+{
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0777);
+#endif
+}
+
+uint64_t result_cache::hash(const void *data, size_t length, uint64_t start)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t h = start;
+    size_t i;
+    for (i = 0; i < length; i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::string result_cache::key(const chromatin_parameters &params, uint64_t seed,
+                              int num_replicates, const histogram_layout &layout)
+{
+    // The doubles are written with enough digits to tell any two apart.
+    // The bins are summarized by their kind, count and a hash of the edges.
+    const std::vector<double> &edges = layout.edges();
+    char buffer[512];
+    sprintf(buffer, "engine %d nucleosome %d linker %d nucleosomes %d missing %.17g"
+            " variance %.17g cuts %.17g seed %llu replicates %d bins %d/%d/%016llx",
+            CHROMATIN_ENGINE_VERSION, params.bpPerNucleosome, params.bpPerLinker,
+            params.totalNucleosomes, params.missingHistonePercent,
+            params.nucleosomeSpacingVariance, params.cutsPer3kBasePairs,
+            static_cast<unsigned long long>(seed), num_replicates,
+            static_cast<int>(layout.kind()), layout.binCount(),
+            static_cast<unsigned long long>(hash(&edges[0], edges.size() * sizeof(double))));
+
+    // Regions are told apart by the contents of their file, and biases by
+    // their weights.
+    std::string result = buffer;
+    if (params.regions) {
+        sprintf(buffer, " regions %016llx", static_cast<unsigned long long>(params.regions->fingerprint()));
+        result += buffer;
+    }
+    if (params.bias) {
+        sprintf(buffer, " bias %016llx", static_cast<unsigned long long>(params.bias->fingerprint()));
+        result += buffer;
+    }
+    return result;
+}
+
+std::string result_cache::fileFor(const std::string &key) const
+{
+    char name[32];
+    sprintf(name, "%016llx.hist", static_cast<unsigned long long>(hash(key.data(), key.size())));
+    return d_directory + "/" + name;
+}
+
+bool result_cache::lookup(const std::string &key, fragment_histogram &histogram, bool &cuttable) const
+{
+    FILE *f = fopen(fileFor(key).c_str(), "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    // Check that this is a stored result for this very key.
+    std::vector<char> line(key.size() + 64);
+    bool ok = (fgets(&line[0], static_cast<int>(line.size()), f) != NULL)
+              && (strncmp(&line[0], CACHE_MAGIC, strlen(CACHE_MAGIC)) == 0)
+              && (fgets(&line[0], static_cast<int>(line.size()), f) != NULL)
+              && (strcmp(&line[0], (key + "\n").c_str()) == 0);
+
+    int stored_cuttable = 0, bins = 0;
+    unsigned long long underflow = 0, overflow = 0;
+    ok = ok && (fscanf(f, "cuttable %d underflow %llu overflow %llu bins %d",
+                       &stored_cuttable, &underflow, &overflow, &bins) == 4)
+            && (bins == histogram.binCount());
+    std::vector<uint64_t> counts(ok ? bins : 0);
+    int i;
+    for (i = 0; ok && (i < bins); i++) {
+        unsigned long long count;
+        ok = (fscanf(f, "%llu", &count) == 1);
+        counts[i] = count;
+    }
+    fclose(f);
+    if (!ok) {
+        return false;
+    }
+
+    histogram.setCounts(counts, underflow, overflow);
+    cuttable = (stored_cuttable != 0);
+    return true;
+}
+
+bool result_cache::store(const std::string &key, const fragment_histogram &histogram, bool cuttable) const
+{
+    // Write under a name that no other thread or process is using, then
+    // move it into place in one step.
+    static std::atomic<unsigned> serial(0);
+    std::string name = fileFor(key);
+    char suffix[64];
+    unsigned long long thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    unsigned long long now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    sprintf(suffix, ".%llx.%llx.%u.tmp", thread, now, serial++);
+    std::string temporary = name + suffix;
+
+    FILE *f = fopen(temporary.c_str(), "w");
+    if (f == NULL) {
+        return false;
+    }
+    fprintf(f, "%s\n%s\n", CACHE_MAGIC, key.c_str());
+    fprintf(f, "cuttable %d\nunderflow %llu\noverflow %llu\nbins %d\n", cuttable ? 1 : 0,
+            static_cast<unsigned long long>(histogram.underflow()),
+            static_cast<unsigned long long>(histogram.overflow()), histogram.binCount());
+    int i;
+    for (i = 0; i < histogram.binCount(); i++) {
+        fprintf(f, "%llu\n", static_cast<unsigned long long>(histogram.counts()[i]));
+    }
+    bool ok = (ferror(f) == 0);
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok && (rename(temporary.c_str(), name.c_str()) == 0)) {
+        return true;
+    }
+
+    // Renaming over an existing file fails on some systems.  The one that
+    // is there was stored under the same key, so it is just as good.
+    remove(temporary.c_str());
+    return ok;
+}
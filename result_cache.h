@@ -0,0 +1,49 @@
+// On-disk store of fragment-length histograms that have already been
+// computed, so that a sweep that overlaps an earlier one does not run the
+// same model again.
+//
+// Each result is filed under a key that spells out everything the
+// histogram depends on: the parameters, the seed, the number of
+// replicates, the bins and CHROMATIN_ENGINE_VERSION.  The file name is a
+// 64-bit hash of the key, and the key is stored in the file and checked
+// on lookup, so a hash collision is a miss rather than a wrong answer.
+// Files are written under a temporary name and renamed into place, so
+// threads and processes sharing a directory never see a partial one.
+
+#ifndef _RESULT_CACHE_H_
+#define _RESULT_CACHE_H_
+
+#include <string>
+#include <stdint.h>
+#include "chromatin_model.h"
+
+class result_cache {
+public:
+    // Uses the specified directory, creating it if needed.
+    result_cache(const std::string &directory);
+
+    // Returns the key for a run with the specified settings.
+    static std::string key(const chromatin_parameters &params, uint64_t seed,
+                           int num_replicates, const histogram_layout &layout);
+
+    // 64-bit FNV-1a hash of the specified bytes.
+    static uint64_t hash(const void *data, size_t length, uint64_t start = 14695981039346656037ULL);
+
+    // Looks up the result stored under key.  The histogram must already
+    // have the layout the key was made for; its counts are filled in.
+    // cuttable is set to what run_replicates returned.  Returns false if
+    // there is no such result.
+    bool lookup(const std::string &key, fragment_histogram &histogram, bool &cuttable) const;
+
+    // Stores a result under key, replacing any that was there.  Returns
+    // false if it could not be written.
+    bool store(const std::string &key, const fragment_histogram &histogram, bool cuttable) const;
+
+private:
+    // Name of the file a key is stored in.
+    std::string fileFor(const std::string &key) const;
+
+    std::string d_directory;
+};
+
+#endif
@@ -0,0 +1,491 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+
+#include "run_file.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+// Ways a column can be stored.
+enum codec {
+    CODEC_RAW = 0,              // Words as they are in memory
+    CODEC_VARINT = 1,           // Chunks of varint words
+    CODEC_DELTA_VARINT = 2      // Chunks of varint differences between words
+};
+
+static const char MAGIC[8] = { 'c', 'h', 'r', 'o', 'm', 'r', 'u', 'n' };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// The header and directory entries as they are stored.  Every field falls
+// on a multiple of its size, so neither has any padding.
+class file_header {
+public:
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    byteOrder;          // BYTE_ORDER_MARK as the writer stored it
+    uint32_t    engineVersion;      // CHROMATIN_ENGINE_VERSION of the writer
+    uint32_t    columnCount;
+    int32_t     bpPerNucleosome;
+    int32_t     bpPerLinker;
+    int32_t     totalNucleosomes;
+    int32_t     reserved;
+    double      missingHistonePercent;
+    double      nucleosomeSpacingVariance;
+    double      cutsPer3kBasePairs;
+    uint64_t    seed;
+    int64_t     strandLength;
+    uint64_t    underflow;
+    uint64_t    overflow;
+};
+
+class file_entry {
+public:
+    char        name[24];           // Padded with zeros
+    uint32_t    wordSize;
+    uint32_t    codec;
+    uint64_t    words;
+    uint64_t    offset;
+    uint64_t    bytes;
+};
+
+static_assert(sizeof(density_pyramid::bucket) == 3 * sizeof(uint32_t),
+              "Summary buckets must be stored as three words");
+
+static uint64_t align_up(uint64_t offset)
+{
+    return (offset + run_file::COLUMN_ALIGNMENT - 1) / run_file::COLUMN_ALIGNMENT
+           * run_file::COLUMN_ALIGNMENT;
+}
+
+// Reads or writes one word of the specified size, zero-extended.
+static uint64_t load_word(const char *p, uint32_t size)
+{
+    switch (size) {
+    case 2: { uint16_t v; memcpy(&v, p, 2); return v; }
+    case 4: { uint32_t v; memcpy(&v, p, 4); return v; }
+    default: { uint64_t v; memcpy(&v, p, 8); return v; }
+    }
+}
+
+static void store_word(char *p, uint32_t size, uint64_t value)
+{
+    switch (size) {
+    case 2: { uint16_t v = static_cast<uint16_t>(value); memcpy(p, &v, 2); break; }
+    case 4: { uint32_t v = static_cast<uint32_t>(value); memcpy(p, &v, 4); break; }
+    default: memcpy(p, &value, 8); break;
+    }
+}
+
+//----------------------------------------------------------------------
+// Writing
+
+// A column waiting to be written, and its compressed form if it has one.
+class pending_column {
+public:
+    pending_column(const char *n, uint32_t size, uint32_t c, const void *d, uint64_t w)
+        : name(n), wordSize(size), codec(c), data(static_cast<const char *>(d)), words(w) {}
+
+    std::string         name;
+    uint32_t            wordSize;
+    uint32_t            codec;
+    const char          *data;
+    uint64_t            words;
+    std::vector<char>   encoded;    // Chunk table and chunks, when compressed
+};
+
+// Compresses the column into its chunk table (the number of chunks and
+// the end of each, relative to the first) followed by the chunks, which
+// are encoded in parallel.
+static void encode_column(pending_column &c)
+{
+    const uint64_t num_chunks = (c.words + run_file::CHUNK_WORDS - 1) / run_file::CHUNK_WORDS;
+    std::vector< std::vector<char> > chunks(static_cast<size_t>(num_chunks));
+    std::function<void(int)> encode = [&](int k) {
+        uint64_t first = static_cast<uint64_t>(k) * run_file::CHUNK_WORDS;
+        uint64_t last = std::min(first + run_file::CHUNK_WORDS, c.words);
+        std::vector<char> &out = chunks[k];
+        uint64_t previous = 0;
+        uint64_t i;
+        for (i = first; i < last; i++) {
+            uint64_t word = load_word(c.data + i * c.wordSize, c.wordSize);
+            uint64_t value = (c.codec == CODEC_DELTA_VARINT) ? word - previous : word;
+            previous = word;
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+    };
+    run_work_stealing(static_cast<int>(num_chunks), 0, encode);
+
+    c.encoded.resize(static_cast<size_t>((num_chunks + 1) * sizeof(uint64_t)));
+    memcpy(&c.encoded[0], &num_chunks, sizeof(uint64_t));
+    uint64_t end = 0;
+    size_t k;
+    for (k = 0; k < chunks.size(); k++) {
+        end += chunks[k].size();
+        memcpy(&c.encoded[(k + 1) * sizeof(uint64_t)], &end, sizeof(uint64_t));
+    }
+    for (k = 0; k < chunks.size(); k++) {
+        c.encoded.insert(c.encoded.end(), chunks[k].begin(), chunks[k].end());
+        std::vector<char>().swap(chunks[k]);
+    }
+}
+
+static bool write_zeros(FILE *f, uint64_t count)
+{
+    static const char zeros[run_file::COLUMN_ALIGNMENT] = { 0 };
+    return fwrite(zeros, 1, static_cast<size_t>(count), f) == count;
+}
+
+bool run_file::write(const char *filename, const chromatin_model &model, uint64_t seed,
+                     const density_pyramid *summary, const fragment_histogram *histogram,
+                     bool compress)
+{
+    density_pyramid built;
+    if (summary == NULL) {
+        built.build(model);
+        summary = &built;
+    }
+
+    // List the columns, choosing how each is stored.  Bits and
+    // floating-point values do not shrink as varints, so they stay raw.
+    const uint32_t varint = compress ? CODEC_VARINT : CODEC_RAW;
+    const uint32_t delta = compress ? CODEC_DELTA_VARINT : CODEC_RAW;
+    const nucleosome_array &nucleosomes = model.nucleosomes();
+    const cut_array &cuts = model.cutLocations();
+    std::vector<pending_column> columns;
+    columns.push_back(pending_column("linkers", 2, varint, nucleosomes.linkerColumn().begin(),
+                                     nucleosomes.linkerColumn().size()));
+    columns.push_back(pending_column("attached", 8, CODEC_RAW, nucleosomes.attachedColumn().begin(),
+                                     nucleosomes.attachedColumn().size()));
+    columns.push_back(pending_column("block_starts", 8, delta, nucleosomes.blockStartColumn().begin(),
+                                     nucleosomes.blockStartColumn().size()));
+    if (cuts.wide()) {
+        columns.push_back(pending_column("cuts", 8, delta, cuts.wideColumn().begin(), cuts.size()));
+    } else {
+        columns.push_back(pending_column("cuts", 4, delta, cuts.narrowColumn().begin(), cuts.size()));
+    }
+    const std::vector<uint32_t> &max_cuts = summary->maxCutsByLevel();
+    columns.push_back(pending_column("pyramid_max", 4, varint,
+                                     max_cuts.empty() ? NULL : &max_cuts[0], max_cuts.size()));
+    int level;
+    for (level = 0; level < summary->levelCount(); level++) {
+        char name[32];
+        sprintf(name, "pyramid.%d", level);
+        const column<density_pyramid::bucket> &buckets = summary->levelColumn(level);
+        columns.push_back(pending_column(name, 4, varint, buckets.begin(), 3 * buckets.size()));
+    }
+    if (histogram) {
+        const std::vector<double> &edges = histogram->layout().edges();
+        const std::vector<uint64_t> &counts = histogram->counts();
+        columns.push_back(pending_column("histogram_edges", 8, CODEC_RAW, &edges[0], edges.size()));
+        columns.push_back(pending_column("histogram_counts", 8, varint, &counts[0], counts.size()));
+    }
+
+    // Compress what is to be compressed, then lay the columns out.
+    std::vector<file_entry> directory(columns.size());
+    uint64_t offset = align_up(sizeof(file_header) + columns.size() * sizeof(file_entry));
+    size_t i;
+    for (i = 0; i < columns.size(); i++) {
+        pending_column &c = columns[i];
+        if (c.codec != CODEC_RAW) {
+            encode_column(c);
+        }
+        file_entry &e = directory[i];
+        memset(&e, 0, sizeof(e));
+        strncpy(e.name, c.name.c_str(), sizeof(e.name) - 1);
+        e.wordSize = c.wordSize;
+        e.codec = c.codec;
+        e.words = c.words;
+        e.offset = offset;
+        e.bytes = (c.codec == CODEC_RAW) ? c.words * c.wordSize : c.encoded.size();
+        offset = align_up(offset + e.bytes);
+    }
+
+    file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.engineVersion = CHROMATIN_ENGINE_VERSION;
+    header.columnCount = static_cast<uint32_t>(columns.size());
+    const chromatin_parameters &params = model.parameters();
+    header.bpPerNucleosome = params.bpPerNucleosome;
+    header.bpPerLinker = params.bpPerLinker;
+    header.totalNucleosomes = params.totalNucleosomes;
+    header.missingHistonePercent = params.missingHistonePercent;
+    header.nucleosomeSpacingVariance = params.nucleosomeSpacingVariance;
+    header.cutsPer3kBasePairs = params.cutsPer3kBasePairs;
+    header.seed = seed;
+    header.strandLength = summary->strandLength();
+    header.underflow = histogram ? histogram->underflow() : 0;
+    header.overflow = histogram ? histogram->overflow() : 0;
+
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL) {
+        return false;
+    }
+    bool ok = (fwrite(&header, sizeof(header), 1, f) == 1)
+           && (fwrite(&directory[0], sizeof(file_entry), directory.size(), f) == directory.size());
+    uint64_t written = sizeof(header) + directory.size() * sizeof(file_entry);
+    for (i = 0; ok && (i < columns.size()); i++) {
+        const file_entry &e = directory[i];
+        const char *bytes = (e.codec == CODEC_RAW) ? columns[i].data
+                          : (columns[i].encoded.empty() ? NULL : &columns[i].encoded[0]);
+        ok = write_zeros(f, e.offset - written)
+          && ( (e.bytes == 0) || (fwrite(bytes, 1, static_cast<size_t>(e.bytes), f) == e.bytes) );
+        written = e.offset + e.bytes;
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        remove(filename);
+    }
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// Reading
+
+run_file::run_file()
+    : d_seed(0)
+    , d_strandLength(0)
+    , d_underflow(0)
+    , d_overflow(0)
+{
+}
+
+bool run_file::open(const char *filename)
+{
+    d_file.reset();
+    d_columns.clear();
+    std::shared_ptr<mapped_file> file(new mapped_file);
+    if (!file->open(filename) || (file->size() < sizeof(file_header))) {
+        return false;
+    }
+
+    file_header header;
+    memcpy(&header, file->data(), sizeof(header));
+    if ( (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) || (header.version != VERSION)
+         || (header.byteOrder != BYTE_ORDER_MARK)
+         || (header.columnCount > (file->size() - sizeof(header)) / sizeof(file_entry)) ) {
+        return false;
+    }
+
+    // Every column must lie within the file, and raw ones must be aligned
+    // and exactly as long as their words.
+    uint32_t i;
+    for (i = 0; i < header.columnCount; i++) {
+        file_entry e;
+        memcpy(&e, file->data() + sizeof(header) + i * sizeof(file_entry), sizeof(e));
+        e.name[sizeof(e.name) - 1] = '\0';
+        bool ok = ( (e.wordSize == 2) || (e.wordSize == 4) || (e.wordSize == 8) )
+               && (e.codec <= CODEC_DELTA_VARINT)
+               && (e.offset <= file->size()) && (e.bytes <= file->size() - e.offset)
+               && (e.words <= file->size());
+        if (ok && (e.codec == CODEC_RAW)) {
+            ok = (e.offset % COLUMN_ALIGNMENT == 0) && (e.bytes == e.words * e.wordSize);
+        }
+        if (!ok) {
+            return false;
+        }
+        entry column;
+        column.name = e.name;
+        column.wordSize = e.wordSize;
+        column.codec = e.codec;
+        column.words = e.words;
+        column.offset = e.offset;
+        column.bytes = e.bytes;
+        d_columns.push_back(column);
+    }
+
+    d_params.bpPerNucleosome = header.bpPerNucleosome;
+    d_params.bpPerLinker = header.bpPerLinker;
+    d_params.totalNucleosomes = header.totalNucleosomes;
+    d_params.missingHistonePercent = header.missingHistonePercent;
+    d_params.nucleosomeSpacingVariance = header.nucleosomeSpacingVariance;
+    d_params.cutsPer3kBasePairs = header.cutsPer3kBasePairs;
+    d_seed = header.seed;
+    d_strandLength = header.strandLength;
+    d_underflow = header.underflow;
+    d_overflow = header.overflow;
+    d_file = file;
+    return true;
+}
+
+bool run_file::raw(void) const
+{
+    size_t i;
+    for (i = 0; i < d_columns.size(); i++) {
+        if (d_columns[i].codec != CODEC_RAW) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const run_file::entry *run_file::find(const char *name) const
+{
+    size_t i;
+    for (i = 0; i < d_columns.size(); i++) {
+        if (d_columns[i].name == name) {
+            return &d_columns[i];
+        }
+    }
+    return NULL;
+}
+
+// Decodes a compressed column into out, which has room for all of its
+// words.  Returns false if the chunks are damaged.
+static bool decode_column(const char *data, uint64_t bytes, uint32_t word_size,
+                          uint32_t codec, uint64_t words, char *out)
+{
+    const uint64_t num_chunks = (words + run_file::CHUNK_WORDS - 1) / run_file::CHUNK_WORDS;
+    uint64_t stored_chunks;
+    if (bytes < sizeof(uint64_t)) {
+        return false;
+    }
+    memcpy(&stored_chunks, data, sizeof(uint64_t));
+    if ( (stored_chunks != num_chunks) || ((bytes / sizeof(uint64_t)) - 1 < num_chunks) ) {
+        return false;
+    }
+    const uint64_t table = (num_chunks + 1) * sizeof(uint64_t);
+    std::vector<char> failed(static_cast<size_t>(num_chunks), 0);
+    std::function<void(int)> decode = [&](int k) {
+        uint64_t begin = 0, end;
+        if (k > 0) {
+            memcpy(&begin, data + k * sizeof(uint64_t), sizeof(uint64_t));
+        }
+        memcpy(&end, data + (k + 1) * sizeof(uint64_t), sizeof(uint64_t));
+        if ( (begin > end) || (end > bytes - table) ) {
+            failed[k] = 1;
+            return;
+        }
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data + table + begin);
+        const unsigned char *stop = reinterpret_cast<const unsigned char *>(data + table + end);
+        uint64_t first = static_cast<uint64_t>(k) * run_file::CHUNK_WORDS;
+        uint64_t last = std::min(first + run_file::CHUNK_WORDS, words);
+        uint64_t previous = 0;
+        uint64_t i;
+        for (i = first; i < last; i++) {
+            uint64_t value = 0;
+            int shift = 0;
+            do {
+                if ( (p == stop) || (shift > 63) ) {
+                    failed[k] = 1;
+                    return;
+                }
+                value |= static_cast<uint64_t>(*p & 0x7F) << shift;
+                shift += 7;
+            } while (*p++ & 0x80);
+            uint64_t word = (codec == CODEC_DELTA_VARINT) ? previous + value : value;
+            store_word(out + i * word_size, word_size, word);
+            previous = word;
+        }
+        if (p != stop) {
+            failed[k] = 1;
+        }
+    };
+    run_work_stealing(static_cast<int>(num_chunks), 0, decode);
+    size_t k;
+    for (k = 0; k < failed.size(); k++) {
+        if (failed[k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class T>
+bool run_file::readColumn(const char *name, column<T> &values) const
+{
+    const entry *e = find(name);
+    if ( (e == NULL) || (sizeof(T) % e->wordSize != 0)
+         || ((e->words * e->wordSize) % sizeof(T) != 0) ) {
+        return false;
+    }
+    const size_t count = static_cast<size_t>(e->words * e->wordSize / sizeof(T));
+    const char *data = d_file->data() + e->offset;
+    if (e->codec == CODEC_RAW) {
+        values.view(reinterpret_cast<const T *>(data), count, d_file);
+        return true;
+    }
+    std::vector<T> decoded(count);
+    if ( (count > 0) && !decode_column(data, e->bytes, e->wordSize, e->codec, e->words,
+                                       reinterpret_cast<char *>(&decoded[0])) ) {
+        return false;
+    }
+    values.adopt(decoded);
+    return true;
+}
+
+bool run_file::load(chromatin_model *model, density_pyramid *summary,
+                    fragment_histogram *histogram) const
+{
+    if (!d_file) {
+        return false;
+    }
+
+    if (model) {
+        column<uint16_t> linkers;
+        column<uint64_t> attached;
+        column<int64_t> block_starts;
+        nucleosome_array nucleosomes;
+        if ( !readColumn("linkers", linkers) || !readColumn("attached", attached)
+             || !readColumn("block_starts", block_starts)
+             || !nucleosomes.assign(d_params.bpPerNucleosome, linkers, attached, block_starts) ) {
+            return false;
+        }
+        const entry *e = find("cuts");
+        cut_array cuts;
+        if (e && (e->wordSize == 8)) {
+            column<uint64_t> locations;
+            if (!readColumn("cuts", locations)) {
+                return false;
+            }
+            cuts.assign(locations);
+        } else {
+            column<uint32_t> locations;
+            if (!readColumn("cuts", locations)) {
+                return false;
+            }
+            cuts.assign(locations);
+        }
+        model->assign(d_params, nucleosomes, cuts);
+    }
+
+    if (summary) {
+        column<uint32_t> max_cuts;
+        if (!readColumn("pyramid_max", max_cuts)) {
+            return false;
+        }
+        std::vector< column<density_pyramid::bucket> > levels(max_cuts.size());
+        size_t level;
+        for (level = 0; level < levels.size(); level++) {
+            char name[32];
+            sprintf(name, "pyramid.%d", static_cast<int>(level));
+            if (!readColumn(name, levels[level])) {
+                return false;
+            }
+        }
+        std::vector<uint32_t> most(max_cuts.begin(), max_cuts.end());
+        if (!summary->assign(d_strandLength, levels, most)) {
+            return false;
+        }
+    }
+
+    if (histogram) {
+        column<double> edges;
+        column<uint64_t> counts;
+        if ( !readColumn("histogram_edges", edges) || !readColumn("histogram_counts", counts)
+             || (edges.size() < 2) || (counts.size() + 1 != edges.size()) ) {
+            return false;
+        }
+        histogram->reset(histogram_layout::custom(std::vector<double>(edges.begin(), edges.end())));
+        histogram->setCounts(std::vector<uint64_t>(counts.begin(), counts.end()),
+                             d_underflow, d_overflow);
+    }
+    return true;
+}
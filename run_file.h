@@ -0,0 +1,105 @@
+// Binary file holding one model run: its parameters and seed, the
+// nucleosomes, the cuts, the density summary used to draw it zoomed out
+// and its fragment-length histogram, so that it can be analysed later or
+// opened in the GUI without being generated again.
+//
+// The file is a fixed header, a directory with one entry per column, and
+// the columns themselves, each starting on a COLUMN_ALIGNMENT boundary:
+//
+//   linkers            uint16 linker length before each nucleosome
+//   attached           uint64 words of attached bits, 64 nucleosomes each
+//   block_starts       int64 location before each block of nucleosomes
+//   cuts               uint32 or uint64 cut locations, sorted
+//   pyramid_max        uint32 most cuts in a bucket, one per summary level
+//   pyramid.N          uint32 attached, detached and cut counts for each
+//                      bucket of summary level N
+//   histogram_edges    double bin edges, if a histogram was saved
+//   histogram_counts   uint64 count in each bin
+//
+// A column is stored either raw, exactly as the engine lays it out in
+// memory, or compressed in chunks of CHUNK_WORDS words, each of which is
+// LEB128 varints of the words or of the differences between successive
+// words.  Opening a file maps it into memory and raw columns are then read
+// in place, so a genome-scale run opens at once and only the pages that
+// are looked at are ever read from disk.  Compressed columns are smaller
+// but are decoded, all their chunks in parallel, when the file is loaded.
+// Values are in the byte order of the machine that wrote them, which is
+// recorded in the header; a file of the other order is refused.
+
+#ifndef _RUN_FILE_H_
+#define _RUN_FILE_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "chromatin_model.h"
+#include "density_pyramid.h"
+#include "column.h"
+
+class mapped_file;
+
+class run_file {
+public:
+    enum { VERSION = 1 };
+    enum { COLUMN_ALIGNMENT = 64 };     // Bytes; keeps raw columns aligned when mapped
+    enum { CHUNK_WORDS = 65536 };       // Words per compressed chunk
+
+    run_file();
+
+    // Writes the model made from the specified seed, its summary and,
+    // unless it is NULL, its histogram.  A NULL summary is built here.
+    // With compress, the integer columns are compressed.  Returns false if
+    // the file could not be written.
+    static bool write(const char *filename, const chromatin_model &model, uint64_t seed,
+                      const density_pyramid *summary, const fragment_histogram *histogram,
+                      bool compress);
+
+    // Maps the specified file and checks its header and directory, which
+    // is all that is read.  Returns false if it cannot be read or is not a
+    // run file this version understands.
+    bool open(const char *filename);
+
+    const chromatin_parameters &parameters(void) const { return d_params; }
+    uint64_t seed(void) const { return d_seed; }
+    bool hasHistogram(void) const { return find("histogram_counts") != NULL; }
+
+    // Is every column raw, so that loading copies nothing?
+    bool raw(void) const;
+
+    // Fills in whichever of the model, summary and histogram are not NULL
+    // from the open file.  Raw columns are viewed in place, and the file
+    // stays mapped for as long as anything is viewing it, even after this
+    // run_file is gone.  Returns false if the file is missing a column
+    // that was asked for or its columns do not fit together.
+    bool load(chromatin_model *model, density_pyramid *summary, fragment_histogram *histogram) const;
+
+private:
+    // One column as described by the directory.
+    class entry {
+    public:
+        std::string name;
+        uint32_t    wordSize;   // Bytes per stored word
+        uint32_t    codec;      // How the words are stored
+        uint64_t    words;
+        uint64_t    offset;     // Where the column starts in the file
+        uint64_t    bytes;      // Its length in the file
+    };
+
+    const entry *find(const char *name) const;
+
+    // Reads the named column into values, viewing it in place when it is
+    // raw.  The words must make up a whole number of values.
+    template <class T>
+    bool readColumn(const char *name, column<T> &values) const;
+
+    std::shared_ptr<const mapped_file>  d_file;
+    chromatin_parameters                d_params;
+    uint64_t                            d_seed;
+    int64_t                             d_strandLength;     // Of the summary
+    uint64_t                            d_underflow;        // Of the histogram
+    uint64_t                            d_overflow;
+    std::vector<entry>                  d_columns;
+};
+
+#endif
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "sequence_bias.h"
+#include "mapped_file.h"
+#include "result_cache.h"
+
+static const char MAGIC[8] = { 'c', 'h', 'r', 'o', 'm', 'b', 'i', 'a' };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+static const size_t WRITE_CHUNK = 1 << 16;      // Weights written at a time
+
+// The header as it is stored.  Every field falls on a multiple of its
+// size, so it has no padding.
+class bias_header {
+public:
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    byteOrder;          // BYTE_ORDER_MARK as the writer stored it
+    uint32_t    k;                  // Of the table the index was built with
+    uint32_t    blockBp;
+    uint32_t    neutral;            // Mean weight, used past the end
+    uint32_t    reserved;
+    int64_t     length;             // Base pairs of sequence
+    uint64_t    weightsOffset;      // One byte per base pair
+    uint64_t    totalsOffset;       // Block totals, aligned to 8 bytes
+    uint64_t    fingerprint;
+};
+
+// Two-bit code of a base, or -1 for anything else.
+static int base_code(int c)
+{
+    switch (c) {
+    case 'A': case 'a': return 0;
+    case 'C': case 'c': return 1;
+    case 'G': case 'g': return 2;
+    case 'T': case 't': return 3;
+    default: return -1;
+    }
+}
+
+//----------------------------------------------------------------------
+
+kmer_table::kmer_table()
+    : d_k(0)
+    , d_max(0)
+{
+}
+
+bool kmer_table::read(const char *filename)
+{
+    d_k = 0;
+    d_weights.clear();
+    d_max = 0;
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    // Read the lines first, since the k-mer length is not known until the
+    // first of them.
+    std::vector< std::pair<uint32_t, double> > listed;
+    char line[256];
+    bool ok = true;
+    while (ok && (fgets(line, sizeof(line), f) != NULL)) {
+        char kmer[64];
+        double weight;
+        char *p = line;
+        while ( (*p == ' ') || (*p == '\t') ) { p++; }
+        if ( (*p == '#') || (*p == '\n') || (*p == '\r') || (*p == '\0') ) {
+            continue;
+        }
+        if (sscanf(p, "%63s %lf", kmer, &weight) != 2) {
+            ok = false;
+            break;
+        }
+        int k = static_cast<int>(strlen(kmer));
+        if ( (k > MAX_K) || ((d_k != 0) && (k != d_k)) || (weight < 0) ) {
+            ok = false;
+            break;
+        }
+        d_k = k;
+        uint32_t code = 0;
+        int i;
+        for (i = 0; i < k; i++) {
+            int base = base_code(kmer[i]);
+            if (base < 0) {
+                ok = false;
+                break;
+            }
+            code = (code << 2) | base;
+        }
+        listed.push_back(std::make_pair(code, weight));
+    }
+    fclose(f);
+    if (!ok || listed.empty()) {
+        d_k = 0;
+        return false;
+    }
+
+    d_weights.assign(static_cast<size_t>(1) << (2 * d_k), 1.0);
+    size_t i;
+    for (i = 0; i < listed.size(); i++) {
+        d_weights[listed[i].first] = listed[i].second;
+    }
+    d_max = *std::max_element(d_weights.begin(), d_weights.end());
+    return d_max > 0;
+}
+
+//----------------------------------------------------------------------
+
+sequence_bias::sequence_bias()
+    : d_length(0)
+    , d_neutral(0)
+    , d_fingerprint(0)
+    , d_weights(NULL)
+    , d_blockTotals(NULL)
+    , d_blocks(0)
+{
+}
+
+// Writes the weights of one strand as they are worked out, keeping the
+// block totals and the fingerprint.
+class weight_writer {
+public:
+    weight_writer(FILE *file) : f(file), written(0), total(0),
+                                fingerprint(result_cache::hash(NULL, 0)), ok(true) {
+        buffer.reserve(WRITE_CHUNK);
+    }
+
+    void add(uint8_t weight) {
+        if (written % sequence_bias::BLOCK_BP == 0) {
+            blockTotals.push_back(total);
+        }
+        buffer.push_back(weight);
+        total += weight;
+        written++;
+        if (buffer.size() == WRITE_CHUNK) {
+            flush();
+        }
+    }
+
+    void flush(void) {
+        if (!buffer.empty()) {
+            fingerprint = result_cache::hash(&buffer[0], buffer.size(), fingerprint);
+            ok = ok && (fwrite(&buffer[0], 1, buffer.size(), f) == buffer.size());
+            buffer.clear();
+        }
+    }
+
+    FILE                    *f;
+    std::vector<uint8_t>    buffer;
+    std::vector<uint64_t>   blockTotals;
+    int64_t                 written;
+    uint64_t                total;
+    uint64_t                fingerprint;
+    bool                    ok;
+};
+
+bool sequence_bias::build(const char *fasta, const kmer_table &table, const char *filename)
+{
+    if (table.k() == 0) {
+        return false;
+    }
+    FILE *in = fopen(fasta, "rb");
+    if (in == NULL) {
+        return false;
+    }
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL) {
+        fclose(in);
+        return false;
+    }
+
+    // Scale the weights so the largest is stored as MAX_WEIGHT, keeping
+    // any that are not zero from rounding to it.
+    const int k = table.k();
+    std::vector<uint8_t> stored(static_cast<size_t>(1) << (2 * k));
+    size_t c;
+    for (c = 0; c < stored.size(); c++) {
+        double w = table.weight(static_cast<uint32_t>(c));
+        int scaled = static_cast<int>(floor(w * MAX_WEIGHT / table.maxWeight() + 0.5));
+        stored[c] = static_cast<uint8_t>( (w > 0) ? std::max(scaled, 1) : 0 );
+    }
+
+    // The header is written again once the totals are known.
+    bias_header header;
+    memset(&header, 0, sizeof(header));
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    // Base pair p is weighted by the k-mer starting k/2 before it, so its
+    // weight is known once the base delay past it has been read.  The
+    // rolling code holds the last k bases and valid counts how many of the
+    // last bases were A, C, G or T.
+    weight_writer out(f);
+    const int delay = k - 1 - k / 2;
+    const uint32_t mask = static_cast<uint32_t>((static_cast<uint64_t>(1) << (2 * k)) - 1);
+    uint32_t code = 0;
+    int valid = 0;
+    int64_t in_record = 0;      // Bases read in the current record
+    bool line_start = true, header_line = false;
+    char chunk[WRITE_CHUNK];
+    size_t got;
+    while ( ok && ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) ) {
+        size_t i;
+        for (i = 0; i < got; i++) {
+            char ch = chunk[i];
+            if (ch == '\n') {
+                line_start = true;
+                header_line = false;
+                continue;
+            }
+            if (line_start && (ch == '>')) {
+                // The bases at the end of the last record have k-mers that
+                // run off it.
+                int64_t j;
+                for (j = 0; j < std::min<int64_t>(delay, in_record); j++) {
+                    out.add(0);
+                }
+                in_record = 0;
+                valid = 0;
+                header_line = true;
+            }
+            line_start = false;
+            if ( header_line || (ch == '\r') || (ch == ' ') || (ch == '\t') ) {
+                continue;
+            }
+            int base = base_code(ch);
+            if (base < 0) {
+                valid = 0;
+                base = 0;
+            } else if (valid < k) {
+                valid++;
+            }
+            code = ((code << 2) | base) & mask;
+            if (in_record >= delay) {
+                out.add( (valid == k) ? stored[code] : 0 );
+            }
+            in_record++;
+        }
+    }
+    int64_t j;
+    for (j = 0; j < std::min<int64_t>(delay, in_record); j++) {
+        out.add(0);
+    }
+    out.flush();
+    ok = ok && out.ok && !ferror(in) && (out.written > 0) && (out.total > 0);
+    fclose(in);
+
+    // The block totals follow, aligned, with the total at the end.
+    if (ok) {
+        out.blockTotals.push_back(out.total);
+        uint64_t totals_offset = (sizeof(header) + out.written + 7) / 8 * 8;
+        static const char zeros[8] = { 0 };
+        size_t padding = static_cast<size_t>(totals_offset - sizeof(header) - out.written);
+        ok = (fwrite(zeros, 1, padding, f) == padding)
+          && (fwrite(&out.blockTotals[0], sizeof(uint64_t), out.blockTotals.size(), f)
+              == out.blockTotals.size());
+
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.k = k;
+        header.blockBp = BLOCK_BP;
+        header.neutral = static_cast<uint32_t>(std::max<uint64_t>(
+            (out.total + out.written / 2) / out.written, 1));
+        header.length = out.written;
+        header.weightsOffset = sizeof(header);
+        header.totalsOffset = totals_offset;
+        header.fingerprint = out.fingerprint;
+        ok = ok && (fseek(f, 0, SEEK_SET) == 0) && (fwrite(&header, sizeof(header), 1, f) == 1);
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        remove(filename);
+    }
+    return ok;
+}
+
+bool sequence_bias::open(const char *filename)
+{
+    d_file.reset();
+    d_length = 0;
+    d_weights = NULL;
+    d_blockTotals = NULL;
+    d_blocks = 0;
+    std::shared_ptr<mapped_file> file(new mapped_file);
+    if (!file->open(filename) || (file->size() < sizeof(bias_header))) {
+        return false;
+    }
+
+    bias_header header;
+    memcpy(&header, file->data(), sizeof(header));
+    if ( (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) || (header.version != VERSION)
+         || (header.byteOrder != BYTE_ORDER_MARK) || (header.blockBp != BLOCK_BP)
+         || (header.length <= 0) || (header.neutral == 0) || (header.neutral > MAX_WEIGHT) ) {
+        return false;
+    }
+    uint64_t blocks = (header.length + BLOCK_BP - 1) / BLOCK_BP;
+    if ( (header.weightsOffset > file->size())
+         || (static_cast<uint64_t>(header.length) > file->size() - header.weightsOffset)
+         || (header.totalsOffset % sizeof(uint64_t) != 0) || (header.totalsOffset > file->size())
+         || ((blocks + 1) > (file->size() - header.totalsOffset) / sizeof(uint64_t)) ) {
+        return false;
+    }
+
+    d_file = file;
+    d_filename = filename;
+    d_length = header.length;
+    d_neutral = header.neutral;
+    d_fingerprint = header.fingerprint;
+    d_weights = reinterpret_cast<const uint8_t *>(file->data() + header.weightsOffset);
+    d_blockTotals = reinterpret_cast<const uint64_t *>(file->data() + header.totalsOffset);
+    d_blocks = static_cast<size_t>(blocks);
+    return true;
+}
+
+uint64_t sequence_bias::cumulative(int64_t bp) const
+{
+    if (bp <= 0) {
+        return 0;
+    }
+    if (bp >= d_length) {
+        return d_blockTotals[d_blocks] + static_cast<uint64_t>(bp - d_length) * d_neutral;
+    }
+    int64_t block_start = bp / BLOCK_BP * BLOCK_BP;
+    uint64_t total = d_blockTotals[block_start / BLOCK_BP];
+    int64_t i;
+    for (i = block_start; i < bp; i++) {
+        total += d_weights[i];
+    }
+    return total;
+}
+
+int64_t sequence_bias::locate(uint64_t total) const
+{
+    const uint64_t sequence_total = d_blockTotals[d_blocks];
+    if (total >= sequence_total) {
+        return d_length + static_cast<int64_t>((total - sequence_total) / d_neutral);
+    }
+
+    // Find the last block starting at or before the total, then walk it.
+    const uint64_t *block = std::upper_bound(d_blockTotals, d_blockTotals + d_blocks + 1, total) - 1;
+    uint64_t before = *block;
+    int64_t bp = (block - d_blockTotals) * static_cast<int64_t>(BLOCK_BP);
+    while (before + d_weights[bp] <= total) {
+        before += d_weights[bp];
+        bp++;
+    }
+    return bp;
+}
@@ -0,0 +1,107 @@
+// Sequence preferences of the cutting enzyme.  Enzymes such as MNase cut
+// some sequences more readily than others, so cuts are not uniform over
+// the DNA that nucleosomes leave exposed.
+//
+// A k-mer table gives the relative preference for cutting at a base pair
+// from the k bases around it: the k-mer starting k/2 bases before it.  Its
+// text file has one "KMER weight" line per k-mer, all of the same length
+// (at most MAX_K), with '#' comments allowed.  K-mers that are not listed
+// weigh 1.
+//
+// A reference sequence is streamed through the table once to build an
+// index file, which is then mapped by every run that uses it.  The index
+// holds one byte per base pair, the weight scaled so the largest in the
+// table is 255, and a prefix sum of the weights at the start of every
+// BLOCK_BP base pairs.  The total weight before any base pair then takes
+// a lookup and a short sum, and finding where a running total is reached
+// (which is what a weighted draw needs) takes a binary search over the
+// blocks and a scan of one block.  Bases other than A, C, G and T, and
+// k-mers that would run off a FASTA record, are never cut.  The records
+// are laid end to end to make one strand, whose base pair i is base pair
+// i of the model; past the end of the sequence, every base pair has the
+// sequence's mean weight.
+
+#ifndef _SEQUENCE_BIAS_H_
+#define _SEQUENCE_BIAS_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+class mapped_file;
+
+class kmer_table {
+public:
+    enum { MAX_K = 10 };
+
+    kmer_table();
+
+    // Reads the table from the specified file.  Returns false if it
+    // cannot be read, has k-mers of different lengths or of letters other
+    // than A, C, G and T, or has a negative weight.
+    bool read(const char *filename);
+
+    int k(void) const { return d_k; }
+
+    // Weight of the k-mer whose bases, two bits each with A=0, C=1, G=2
+    // and T=3, make up code, with the first base highest.
+    double weight(uint32_t code) const { return d_weights[code]; }
+    double maxWeight(void) const { return d_max; }
+
+private:
+    int                 d_k;
+    std::vector<double> d_weights;  // One per k-mer code
+    double              d_max;
+};
+
+class sequence_bias {
+public:
+    enum { VERSION = 1 };
+    enum { BLOCK_BP = 256 };        // Base pairs per stored prefix sum
+    enum { MAX_WEIGHT = 255 };      // Stored weight of the most preferred k-mer
+
+    sequence_bias();
+
+    // Streams the sequence in the specified FASTA file through the table
+    // and writes the index to filename.  Returns false if either file
+    // cannot be used.
+    static bool build(const char *fasta, const kmer_table &table, const char *filename);
+
+    // Maps the specified index file.  Returns false if it cannot be read
+    // or is not an index this version understands.
+    bool open(const char *filename);
+
+    const std::string &filename(void) const { return d_filename; }
+
+    // Base pairs of sequence.
+    int64_t length(void) const { return d_length; }
+
+    // Hash of the weights, which tells indexes apart in stored results.
+    uint64_t fingerprint(void) const { return d_fingerprint; }
+
+    // Weight of cutting at base pair bp, from 0 to MAX_WEIGHT.
+    int weight(int64_t bp) const {
+        return (bp < d_length) ? d_weights[bp] : d_neutral;
+    }
+
+    // Total weight of base pairs [0, bp).
+    uint64_t cumulative(int64_t bp) const;
+
+    // Returns the base pair whose weight takes the total from [0, bp)
+    // past total: the smallest bp with cumulative(bp + 1) > total.
+    int64_t locate(uint64_t total) const;
+
+private:
+    std::shared_ptr<const mapped_file>  d_file;
+    std::string                         d_filename;
+    int64_t                             d_length;
+    int                                 d_neutral;      // Weight past the end of the sequence
+    uint64_t                            d_fingerprint;
+    const uint8_t                       *d_weights;     // One per base pair, in the file
+    const uint64_t                      *d_blockTotals; // Weight before each block, plus the total
+    size_t                              d_blocks;
+};
+
+#endif
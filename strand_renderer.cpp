@@ -0,0 +1,270 @@
+#include <QtOpenGL>
+#include <QGLBuffer>
+#include <vector>
+#include <stddef.h>
+#include <math.h>
+
+#include "strand_renderer.h"
+
+// Layout of one vertex in the buffers.
+struct strand_vertex {
+    GLfloat x, y, z;
+    GLubyte color[4];
+};
+
+static void add_vertex(std::vector<strand_vertex> &vertices, double x, double y, double z,
+                       GLubyte red, GLubyte green, GLubyte blue)
+{
+    strand_vertex v;
+    v.x = static_cast<GLfloat>(x);
+    v.y = static_cast<GLfloat>(y);
+    v.z = static_cast<GLfloat>(z);
+    v.color[0] = red;
+    v.color[1] = green;
+    v.color[2] = blue;
+    v.color[3] = 255;
+    vertices.push_back(v);
+}
+
+StrandRenderer::StrandRenderer()
+{
+}
+
+StrandRenderer::~StrandRenderer()
+{
+    clear();
+}
+
+void StrandRenderer::setModel(model_result_pointer result)
+{
+    clear();
+    d_result = result;
+}
+
+void StrandRenderer::clear(void)
+{
+    QHash<size_t, chunk *>::iterator i;
+    for (i = d_chunks.begin(); i != d_chunks.end(); ++i) {
+        delete i.value()->buffer;
+        delete i.value();
+    }
+    d_chunks.clear();
+}
+
+size_t StrandRenderer::chunkCount(void) const
+{
+    return (d_result->model.nucleosomes().size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
+qint64 StrandRenderer::chunkStart(size_t k) const
+{
+    return (k == 0) ? 0 : d_result->model.strandLocation(k * CHUNK_SIZE - 1);
+}
+
+qint64 StrandRenderer::chunkEnd(size_t k) const
+{
+    size_t last = qMin((k + 1) * CHUNK_SIZE, d_result->model.nucleosomes().size()) - 1;
+    return d_result->model.strandLocation(last);
+}
+
+StrandRenderer::chunk *StrandRenderer::buildChunk(size_t k) const
+{
+    const chromatin_model &model = d_result->model;
+    const nucleosome_array &nucleosomes = model.nucleosomes();
+    const cut_array &cutLocations = model.cutLocations();
+    const size_t num_cuts = cutLocations.size();
+    const int bpPerNucleosome = model.parameters().bpPerNucleosome;
+    const double halfcut = model.parameters().bpPerLinker/2.0;  // Half length of cut line
+    const size_t first = k * CHUNK_SIZE;
+    const size_t end = qMin(first + CHUNK_SIZE, nucleosomes.size());
+
+    // Start from the nucleosome before the chunk, as the immediate-mode
+    // drawing did from the one before each nucleosome.  The cuts drawn with
+    // a nucleosome are those after the previous one, up to and including it.
+    qint64 last_bp = 0;
+    qint64 last_sl = 0;        // Relative to the start of the chunk
+    size_t next_cut_index = 0; // Index of the next cut location to draw.
+    if (first > 0) {
+        last_bp = nucleosomes.location(first - 1);
+        size_t hi = num_cuts;
+        while (next_cut_index < hi) {
+            size_t mid = next_cut_index + (hi - next_cut_index) / 2;
+            if (cutLocations[mid] <= last_bp) { next_cut_index = mid + 1; }
+            else { hi = mid; }
+        }
+    }
+
+    std::vector<strand_vertex> lines, points;
+    nucleosome_array::cursor n(nucleosomes, first);
+    for (; !n.done() && (n.index() < end); n.next()) {
+
+        // The line from the previous nucleosome to this one.
+        qint64 inc_bp = n.location() - last_bp;
+        qint64 new_sl = last_sl + inc_bp - bpPerNucleosome;
+        add_vertex(lines, last_sl, 0, 0, 255, 255, 255);
+        add_vertex(lines, new_sl, 0, 0, 255, 255, 255);
+
+        // This nucleosome, either in wrapped form or unwrapped.
+        if (n.attached()) {
+            add_vertex(points, new_sl, 0, 0, 77, 255, 77);
+        } else {
+            add_vertex(lines, new_sl, bpPerNucleosome/2.0, 0, 77, 255, 77);
+            add_vertex(lines, new_sl, -bpPerNucleosome/2.0, 0, 77, 255, 77);
+        }
+
+        // Cuts before the start of the nucleosome go vertically across the
+        // DNA.  Those within it go horizontally, the fraction of the way
+        // from the bottom of the screen to the top that they are along the
+        // nucleosomal DNA (this is an abstract representation).
+        while ( (next_cut_index < num_cuts)
+                && (cutLocations[next_cut_index] <= last_bp + inc_bp) ) {
+            qint64 cut = cutLocations[next_cut_index];
+            if (last_bp + inc_bp - bpPerNucleosome > cut) {
+                qint64 xloc = last_sl + (cut - last_bp);
+                add_vertex(lines, xloc, halfcut, 1.0, 255, 77, 77);
+                add_vertex(lines, xloc, -halfcut, 1.0, 255, 77, 77);
+            } else {
+                qint64 yloc = -bpPerNucleosome/2 + (last_bp + inc_bp - cut);
+                add_vertex(lines, new_sl - halfcut, yloc, 1.0, 255, 77, 77);
+                add_vertex(lines, new_sl + halfcut, yloc, 1.0, 255, 77, 77);
+            }
+            next_cut_index++;
+        }
+
+        last_bp += inc_bp;
+        last_sl = new_sl;
+    }
+
+    chunk *c = new chunk;
+    c->lineVertices = static_cast<int>(lines.size());
+    c->pointVertices = static_cast<int>(points.size());
+    lines.insert(lines.end(), points.begin(), points.end());
+    c->buffer = new QGLBuffer(QGLBuffer::VertexBuffer);
+    c->buffer->setUsagePattern(QGLBuffer::StaticDraw);
+    c->buffer->create();
+    c->buffer->bind();
+    c->buffer->allocate(lines.empty() ? NULL : &lines[0],
+                        static_cast<int>(lines.size() * sizeof(strand_vertex)));
+    c->buffer->release();
+    return c;
+}
+
+void StrandRenderer::draw(double left, double right, double bp_per_pixel)
+{
+    if (d_result.isNull() || (chunkCount() == 0)) {
+        return;
+    }
+    if (bp_per_pixel > density_pyramid::BASE_BUCKET_BP) {
+        drawSummary(left, right, bp_per_pixel);
+    } else {
+        drawChunks(left, right);
+    }
+}
+
+void StrandRenderer::drawSummary(double left, double right, double bp_per_pixel)
+{
+    const density_pyramid &summary = d_result->summary;
+    const int level = summary.levelFor(bp_per_pixel);
+    const double width = static_cast<double>(summary.bucketWidth(level));
+    const double half_height = d_result->model.parameters().bpPerNucleosome/2.0;
+    const double max_cuts = qMax(1u, summary.maxCuts(level));
+
+    // The strand itself, across the whole view.
+    std::vector<strand_vertex> lines, quads;
+    double strand_end = qMin(right, static_cast<double>(summary.strandLength())) - left;
+    add_vertex(lines, qMax(0.0, -left), 0, 0, 255, 255, 255);
+    add_vertex(lines, strand_end, 0, 0, 255, 255, 255);
+
+    // One pair of bars per bucket in view.  Positions are computed in
+    // doubles relative to the left edge before they are made floats.
+    size_t first = static_cast<size_t>(qMax(0.0, floor(left / width)));
+    size_t end = qMin(summary.bucketCount(level), static_cast<size_t>(qMax(0.0, ceil(right / width))));
+    size_t i;
+    for (i = first; i < end; i++) {
+        const density_pyramid::bucket &b = summary.at(level, i);
+        double x0 = i*width - left;
+        double x1 = x0 + width;
+        if (b.attached + b.detached > 0) {
+            double up = half_height * b.attached / (b.attached + b.detached);
+            add_vertex(quads, x0, 0, 0, 77, 255, 77);
+            add_vertex(quads, x1, 0, 0, 77, 255, 77);
+            add_vertex(quads, x1, up, 0, 77, 255, 77);
+            add_vertex(quads, x0, up, 0, 77, 255, 77);
+        }
+        if (b.cuts > 0) {
+            double down = -half_height * b.cuts / max_cuts;
+            add_vertex(quads, x0, down, 1.0, 255, 77, 77);
+            add_vertex(quads, x1, down, 1.0, 255, 77, 77);
+            add_vertex(quads, x1, 0, 1.0, 255, 77, 77);
+            add_vertex(quads, x0, 0, 1.0, 255, 77, 77);
+        }
+    }
+
+    // These are few enough (about one per pixel) to draw from client memory.
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(strand_vertex), &lines[0].x);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(strand_vertex), lines[0].color);
+    glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(lines.size()));
+    if (!quads.empty()) {
+        glVertexPointer(3, GL_FLOAT, sizeof(strand_vertex), &quads[0].x);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(strand_vertex), quads[0].color);
+        glDrawArrays(GL_QUADS, 0, static_cast<GLsizei>(quads.size()));
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void StrandRenderer::drawChunks(double left, double right)
+{
+    // Find the first chunk that reaches the left edge; the chunks are in
+    // order along the strand.
+    size_t lo = 0, hi = chunkCount();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (chunkEnd(mid) < left) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    QList<size_t> visible;
+    size_t k;
+    for (k = lo; (k < chunkCount()) && (chunkStart(k) <= right); k++) {
+        chunk *c = d_chunks.value(k, NULL);
+        if (c == NULL) {
+            c = buildChunk(k);
+            d_chunks.insert(k, c);
+        }
+        visible.append(k);
+
+        glPushMatrix();
+        glTranslated(static_cast<double>(chunkStart(k)) - left, 0, 0);
+        c->buffer->bind();
+        glVertexPointer(3, GL_FLOAT, sizeof(strand_vertex),
+                        reinterpret_cast<const GLvoid *>(offsetof(strand_vertex, x)));
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(strand_vertex),
+                       reinterpret_cast<const GLvoid *>(offsetof(strand_vertex, color)));
+        glDrawArrays(GL_LINES, 0, c->lineVertices);
+        glDrawArrays(GL_POINTS, c->lineVertices, c->pointVertices);
+        c->buffer->release();
+        glPopMatrix();
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    // Keep the buffers from growing without bound as the view moves, by
+    // dropping those that are off screen once there are too many.
+    if (d_chunks.size() > MAX_CACHED_CHUNKS) {
+        QHash<size_t, chunk *>::iterator i = d_chunks.begin();
+        while (i != d_chunks.end()) {
+            if (visible.contains(i.key())) {
+                ++i;
+            } else {
+                delete i.value()->buffer;
+                delete i.value();
+                i = d_chunks.erase(i);
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+// Draws the chromatin strand of a model from vertex buffers.
+//
+// The strand is drawn as it was in immediate mode: linkers as white lines
+// laid end to end, attached nucleosomes as green points, detached ones as
+// green lines across the strand and cuts as red ticks, with the wrapped
+// DNA of each nucleosome taking up no room.  The nucleosomes are split
+// into chunks of CHUNK_SIZE, and the geometry for a chunk is built into a
+// vertex buffer (with per-vertex colors) the first time it is on screen
+// and then kept until the model changes.  Each repaint draws only the
+// chunks that overlap the visible range, with two calls per chunk, so its
+// cost does not depend on how large the model is.
+//
+// When zoomed out so far that a pixel spans more than a bucket of the
+// model's density_pyramid, individual primitives would only pile up, so
+// the strand is instead drawn as bars from the pyramid level whose buckets
+// are about a pixel wide: green above it for the fraction of histones
+// attached and red below it for the density of cuts.
+
+#ifndef _STRAND_RENDERER_H_
+#define _STRAND_RENDERER_H_
+
+#include <QHash>
+#include "model_worker.h"
+
+class QGLBuffer;
+
+class StrandRenderer
+{
+public:
+    enum { CHUNK_SIZE = 1024 };         // Nucleosomes per vertex buffer
+    enum { MAX_CACHED_CHUNKS = 64 };    // Buffers kept when off screen
+
+    StrandRenderer();
+    ~StrandRenderer();
+
+    // Draws the specified model from now on, discarding the buffers built
+    // for the previous one.  The GL context must be current.
+    void setModel(model_result_pointer result);
+
+    // Draws the part of the strand in [left, right], which is measured
+    // along the drawn strand in base pairs, with left at the origin.  The
+    // detail depends on how many base pairs each pixel spans.  The GL
+    // context must be current.
+    void draw(double left, double right, double bp_per_pixel);
+
+    // Discards all of the buffers.  The GL context must be current.
+    void clear(void);
+
+private:
+    // Geometry for one chunk of nucleosomes.  Positions are relative to
+    // the start of the chunk, so that they keep their precision in floats
+    // however far along the strand it is.
+    class chunk {
+    public:
+        chunk() : buffer(NULL), lineVertices(0), pointVertices(0) {}
+
+        QGLBuffer   *buffer;        // Lines first, then points
+        int         lineVertices;
+        int         pointVertices;
+    };
+
+    size_t chunkCount(void) const;
+
+    // Position along the drawn strand where chunk k starts and ends.
+    qint64 chunkStart(size_t k) const;
+    qint64 chunkEnd(size_t k) const;
+
+    // Builds the buffer for chunk k.
+    chunk *buildChunk(size_t k) const;
+
+    // Draws each primitive of the chunks in view.
+    void drawChunks(double left, double right);
+
+    // Draws the densities from the pyramid level for the zoom.
+    void drawSummary(double left, double right, double bp_per_pixel);
+
+    model_result_pointer    d_result;   // Model being drawn
+    QHash<size_t, chunk *>  d_chunks;   // Chunks built so far
+};
+
+#endif
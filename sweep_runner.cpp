@@ -0,0 +1,65 @@
+#include "sweep_runner.h"
+#include "replicate_runner.h"
+#include "thread_pool.h"
+#include "result_cache.h"
+
+void sweep_grid::expand(const chromatin_parameters &base, std::vector<chromatin_parameters> &points) const
+{
+    // A parameter with no values to sweep takes just its base value.
+    std::vector<double> missing = missingHistonePercent;
+    std::vector<double> variance = nucleosomeSpacingVariance;
+    std::vector<double> cuts = cutsPer3kBasePairs;
+    std::vector<int> linker = bpPerLinker;
+    if (missing.empty()) { missing.push_back(base.missingHistonePercent); }
+    if (variance.empty()) { variance.push_back(base.nucleosomeSpacingVariance); }
+    if (cuts.empty()) { cuts.push_back(base.cutsPer3kBasePairs); }
+    if (linker.empty()) { linker.push_back(base.bpPerLinker); }
+
+    points.clear();
+    size_t m, v, c, l;
+    for (m = 0; m < missing.size(); m++) {
+        for (v = 0; v < variance.size(); v++) {
+            for (c = 0; c < cuts.size(); c++) {
+                for (l = 0; l < linker.size(); l++) {
+                    chromatin_parameters params = base;
+                    params.missingHistonePercent = missing[m];
+                    params.nucleosomeSpacingVariance = variance[v];
+                    params.cutsPer3kBasePairs = cuts[c];
+                    params.bpPerLinker = linker[l];
+                    points.push_back(params);
+                }
+            }
+        }
+    }
+}
+
+void run_sweep(const std::vector<chromatin_parameters> &points, uint64_t seed,
+               int num_replicates, const histogram_layout &layout, int num_threads,
+               const result_cache *cache, std::vector<sweep_result> &results)
+{
+    results.assign(points.size(), sweep_result());
+
+    // Each point runs its replicates on one thread, since the pool keeps
+    // the cores busy with other points.  The merged histogram does not
+    // depend on the number of threads, so this matches a run of its own.
+    // The points share their models, so each thread sizes one only once.
+    model_pool models;
+    std::function<void(int)> run_point = [&](int i) {
+        sweep_result &result = results[i];
+        result.params = points[i];
+        result.histogram.reset(layout);
+        std::string key;
+        if (cache) {
+            key = result_cache::key(points[i], seed, num_replicates, layout);
+            if (cache->lookup(key, result.histogram, result.cuttable)) {
+                result.cached = true;
+                return;
+            }
+        }
+        result.cuttable = run_replicates(points[i], seed, num_replicates, 1, result.histogram, &models);
+        if (cache) {
+            cache->store(key, result.histogram, result.cuttable);
+        }
+    };
+    run_work_stealing(static_cast<int>(points.size()), num_threads, run_point);
+}
@@ -0,0 +1,52 @@
+// Runs the chromatin model over a grid of parameter values.
+//
+// The points of the grid are spread across a work-stealing pool of
+// threads (see thread_pool.h); runs at different points can take very
+// different times, so this keeps every thread busy until the sweep is
+// done.  Results can be kept in a
+// result_cache so that overlapping sweeps only run the new points.
+
+#ifndef _SWEEP_RUNNER_H_
+#define _SWEEP_RUNNER_H_
+
+#include <vector>
+#include <stdint.h>
+#include "chromatin_model.h"
+
+class result_cache;
+
+// The values to sweep for each parameter.  An empty list keeps the value
+// from the base parameters.
+class sweep_grid {
+public:
+    std::vector<double> missingHistonePercent;
+    std::vector<double> nucleosomeSpacingVariance;
+    std::vector<double> cutsPer3kBasePairs;
+    std::vector<int>    bpPerLinker;
+
+    // Fills points with every combination of the values, starting from the
+    // base parameters, with the last parameter above varying fastest.
+    void expand(const chromatin_parameters &base, std::vector<chromatin_parameters> &points) const;
+};
+
+// The outcome of one point of a sweep.
+class sweep_result {
+public:
+    sweep_result() : cuttable(true), cached(false) {}
+
+    chromatin_parameters    params;
+    fragment_histogram      histogram;
+    bool                    cuttable;   // What run_replicates returned
+    bool                    cached;     // Was it found in the cache?
+};
+
+// Runs num_replicates replicates at each point, binned with the specified
+// layout, and fills in one result per point in the same order.  Each
+// point gives the same histogram it would in a run of its own with the
+// same seed.  If cache is not NULL, results found in it are used rather
+// than run and new ones are stored in it.
+void run_sweep(const std::vector<chromatin_parameters> &points, uint64_t seed,
+               int num_replicates, const histogram_layout &layout, int num_threads,
+               const result_cache *cache, std::vector<sweep_result> &results);
+
+#endif
@@ -0,0 +1,87 @@
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+#include "thread_pool.h"
+
+int default_thread_count(void)
+{
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 0 ? static_cast<int>(cores) : 1;
+}
+
+// The indices waiting to be run by one thread.  The owner takes from the
+// front and thieves from the back.
+class task_queue {
+public:
+    std::mutex      mutex;
+    std::deque<int> tasks;
+};
+
+static void work_stealing_worker(int self, std::vector<task_queue> *queues,
+                                 const std::function<void(int)> *task)
+{
+    const int num_queues = static_cast<int>(queues->size());
+    while (true) {
+        int which = -1;
+        {
+            task_queue &own = (*queues)[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                which = own.tasks.front();
+                own.tasks.pop_front();
+            }
+        }
+
+        // Nothing of our own is left, so look for another thread's work.
+        // No new tasks are ever added, so once every queue is empty we are
+        // done.
+        int i;
+        for (i = 1; (which < 0) && (i < num_queues); i++) {
+            task_queue &victim = (*queues)[(self + i) % num_queues];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                which = victim.tasks.back();
+                victim.tasks.pop_back();
+            }
+        }
+        if (which < 0) {
+            return;
+        }
+        (*task)(which);
+    }
+}
+
+void run_work_stealing(int count, int num_threads, const std::function<void(int)> &task)
+{
+    if (num_threads <= 0) {
+        num_threads = default_thread_count();
+    }
+    if (num_threads > count) {
+        num_threads = count;
+    }
+    if (num_threads <= 1) {
+        int i;
+        for (i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    // Give each thread a contiguous share, so neighboring points tend to
+    // run one after another on the same thread.
+    std::vector<task_queue> queues(num_threads);
+    int i;
+    for (i = 0; i < count; i++) {
+        queues[static_cast<int>(static_cast<int64_t>(i) * num_threads / count)].tasks.push_back(i);
+    }
+    std::vector<std::thread> threads;
+    for (i = 0; i < num_threads; i++) {
+        threads.push_back(std::thread(work_stealing_worker, i, &queues, &task));
+    }
+    for (i = 0; i < num_threads; i++) {
+        threads[i].join();
+    }
+}
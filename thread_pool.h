@@ -0,0 +1,23 @@
+// Spreads independent tasks across a pool of threads.
+//
+// Each thread starts with its own contiguous share of the tasks and, when
+// it runs out, steals from the far end of another thread's share; tasks
+// can take very different times, so this keeps every thread busy until
+// they are all done.  Nothing here knows about the model, so low-level
+// code such as the sorts can use it as readily as the sweeps.
+
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <functional>
+
+// Returns how many threads to use when the caller asks for "all cores".
+int default_thread_count(void);
+
+// Calls task(i) for each i in [0, count) on num_threads threads, with each
+// thread taking its own share of the indices in order and stealing from
+// the end of others' once its own are done.  A num_threads of 0 or less
+// uses all cores.
+void run_work_stealing(int count, int num_threads, const std::function<void(int)> &task);
+
+#endif